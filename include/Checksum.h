@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum ChecksumBackend {
+    CHECKSUM_BACKEND_PORTABLE,  // slice-by-8 tables
+    CHECKSUM_BACKEND_SSE42,     // crc32 instruction, PCLMUL stream combining
+    CHECKSUM_BACKEND_ARMV8,     // ARMv8 crc32c instructions
+} ChecksumBackend;
+
+/* Returns CRC32C (Castagnoli) of the buffer continuing from crc. Pass 0
+ * for the first call, feed the result to the next call for streaming:
+ * ChecksumCRC32C(ChecksumCRC32C(0, a, n), b, m) is the CRC of a and b.
+ * Meant for integrity checks, not for security. */
+uint32_t ChecksumCRC32C(uint32_t crc, const char* buffer, size_t bufferSize);
+
+// The fastest supported backend is selected on first use.
+// Forces a backend instead. Returns false if it is not supported by
+// the CPU or wasn't compiled in. Not thread safe, call it at startup.
+bool ChecksumSetBackend(ChecksumBackend backend);
+
+ChecksumBackend ChecksumGetBackend(void);
+
+#ifdef __cplusplus
+}
+#endif
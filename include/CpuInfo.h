@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct CpuInfo {
+    // x86
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool sse42;
+    bool pclmul;
+    bool avx2;
+    bool avx512f;
+    bool sha;
+    // ARMv8
+    bool neon;
+    bool armSha2;
+    bool armCrc32;
+    bool armPmull;
+} CpuInfo;
+
+/* Returns the features of the running CPU. Features which need operating
+ * system support (AVX registers) are only reported if the OS enabled them.
+ * Detection runs once, the result is cached. */
+const CpuInfo* CpuInfoGet(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,6 +9,9 @@
 extern "C" {
 #endif
 
+// Returns false if the file doesn't exist.
+bool FileUtilsGetSize(const char* path, size_t* outSize);
+
 bool FileUtilsReadString(const char* path, String* outString);
 
 bool FileUtilsWriteString(const char* path, String string);
@@ -19,6 +22,17 @@ bool FileUtilsReadBinary(const char* path, void** outBuffer, size_t* outBufferSi
 
 bool FileUtilsWriteBinary(const char* path, void* buffer, size_t bufferSize);
 
+// Size of the CRC32C trailer of checksummed files.
+#define FILE_UTILS_CHECKSUM_SIZE 4
+
+// Writes the buffer followed by its little-endian CRC32C.
+bool FileUtilsWriteBinaryChecksummed(const char* path, void* buffer, size_t bufferSize);
+
+// Reads a file written by FileUtilsWriteBinaryChecksummed. Returns false
+// and outputs nothing if the trailer doesn't match the content. The
+// trailer is not included in outBufferSize.
+bool FileUtilsReadBinaryChecksummed(const char* path, void** outBuffer, size_t* outBufferSize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -9,13 +11,119 @@ extern "C" {
 // Returns 64 bit hash.
 uint64_t Hash_64(const char* buffer, size_t bufferSize);
 
-// Returns 128 bit (16 byte) MD5 hash.
+// Returns a random seed which is generated once per process.
+// Seeded hashes use it to make hash flooding attacks impractical.
+uint64_t HashGetProcessSeed(void);
+
+// Returns 64 bit wyhash style hash. Consumes 48 bytes per step with
+// 64x64->128 bit multiply mixing. Not cryptographic.
+uint64_t Hash_WY_64(const char* buffer, size_t bufferSize, uint64_t seed);
+
+// Writes 128 bit wyhash style hash into outHash. Two independently
+// seeded 64 bit lanes, useful when 64 bits collide too often.
+void Hash_WY_128(const char* buffer, size_t bufferSize, uint64_t seed, uint64_t outHash[2]);
+
+// Streaming hash contexts. Init, feed any number of Update calls and
+// write the digest with Final. Nothing is allocated.
+typedef struct HashMD5Context {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+} HashMD5Context;
+
+typedef struct HashSHA256Context {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+} HashSHA256Context;
+
+typedef struct HashSHA512Context {
+    uint64_t state[8];
+    uint64_t length;
+    uint8_t block[128];
+} HashSHA512Context;
+
+// SHA384 is SHA512 with different initial values and truncated output.
+typedef HashSHA512Context HashSHA384Context;
+
+void HashMD5Init(HashMD5Context* context);
+void HashMD5Update(HashMD5Context* context, const char* buffer, size_t bufferSize);
+void HashMD5Final(HashMD5Context* context, uint8_t outHash[16]);
+
+void HashSHA256Init(HashSHA256Context* context);
+void HashSHA256Update(HashSHA256Context* context, const char* buffer, size_t bufferSize);
+void HashSHA256Final(HashSHA256Context* context, uint8_t outHash[32]);
+
+void HashSHA512Init(HashSHA512Context* context);
+void HashSHA512Update(HashSHA512Context* context, const char* buffer, size_t bufferSize);
+void HashSHA512Final(HashSHA512Context* context, uint8_t outHash[64]);
+
+void HashSHA384Init(HashSHA384Context* context);
+void HashSHA384Update(HashSHA384Context* context, const char* buffer, size_t bufferSize);
+void HashSHA384Final(HashSHA384Context* context, uint8_t outHash[48]);
+
+typedef enum HashSHA256Backend {
+    HASH_SHA256_BACKEND_PORTABLE,
+    HASH_SHA256_BACKEND_SHANI,  // x86 SHA extensions
+    HASH_SHA256_BACKEND_ARMV8,  // ARMv8 crypto extensions
+} HashSHA256Backend;
+
+// The fastest supported SHA256 backend is selected on first use.
+// Forces a backend instead. Returns false if it is not supported by
+// the CPU or wasn't compiled in. Not thread safe, call it at startup.
+bool HashSHA256SetBackend(HashSHA256Backend backend);
+
+HashSHA256Backend HashSHA256GetBackend(void);
+
+typedef struct HashBatchItem {
+    const char* buffer;
+    size_t bufferSize;
+} HashBatchItem;
+
+typedef enum HashBatchBackend {
+    HASH_BATCH_BACKEND_AUTO,
+    HASH_BATCH_BACKEND_SCALAR,  // one message after another
+    HASH_BATCH_BACKEND_AVX2,    // 8 messages in parallel lanes
+} HashBatchBackend;
+
+// Hashes many independent messages at once. Digests are written
+// contiguously: outHashes must hold count * 32 bytes for SHA256 and
+// count * 16 bytes for MD5. Nothing is allocated. With AVX2 the messages
+// are hashed eight at a time, one per SIMD lane; unless forced, SHA256
+// prefers a hardware SHA backend over AVX2 lanes.
+void HashSHA256Batch(const HashBatchItem* items, size_t count, uint8_t* outHashes);
+void HashMD5Batch(const HashBatchItem* items, size_t count, uint8_t* outHashes);
+
+// Forces the batch backend. Returns false if the CPU doesn't support it.
+bool HashBatchSetBackend(HashBatchBackend backend);
+
+// Tree hash chunk size. Part of the output format, changing it
+// changes every tree hash.
+#define HASH_TREE_CHUNK_SIZE (1024 * 1024)
+
+// Merkle tree hash over SHA256. The input is split into chunks of
+// HASH_TREE_CHUNK_SIZE bytes; leaves are SHA256(0x00 || chunk) and parents
+// are SHA256(0x01 || left || right). A node without a sibling moves up
+// unchanged. Empty input is a single empty leaf. Leaves are hashed on
+// threadCount threads (0 means one per online CPU); the result doesn't
+// depend on the thread count. Not compatible with plain SHA256.
+void HashTreeSHA256(const char* buffer, size_t bufferSize, uint32_t threadCount, uint8_t outHash[32]);
+
+// Same as HashTreeSHA256, reads the file in chunks on every thread
+// instead of loading it to memory. Returns false if reading fails.
+bool HashTreeSHA256File(const char* path, uint32_t threadCount, uint8_t outHash[32]);
+
+// Returns 128 bit (16 byte) MD5 hash. Free the result.
 uint8_t* Hash_MD5_128(const char* buffer, size_t bufferSize);
 
-// Returns 256 bit (32 byte) SHA2 hash.
+// Returns 256 bit (32 byte) SHA2 hash. Free the result.
 uint8_t* Hash_SHA2_256(const char* buffer, size_t bufferSize);
 
-// Returns 512 bit (64 byte) SHA2 hash.
+// Returns 384 bit (48 byte) SHA2 hash. Free the result.
+uint8_t* Hash_SHA2_384(const char* buffer, size_t bufferSize);
+
+// Returns 512 bit (64 byte) SHA2 hash. Free the result.
+// Faster than SHA256 for large inputs on 64 bit hosts.
 uint8_t* Hash_SHA2_512(const char* buffer, size_t bufferSize);
 
 #ifdef __cplusplus
@@ -13,6 +13,10 @@ String JsonCreate(Dictionary* dict);
 /* Creates a dictionary from given json text. */
 Dictionary* JsonParse(String jsonString);
 
+/* Creates a dictionary from given json text. All nested lists, objects
+ * and values are allocated with the allocator. */
+Dictionary* JsonParseWithAllocator(String jsonString, CUtilsAllocator* allocator);
+
 #ifdef __cplusplus
 }
 #endif
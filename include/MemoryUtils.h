@@ -1,10 +1,9 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#include "containers/UniqueArray.h"
-
 // COMMONS
 #ifdef __cplusplus
 extern "C" {
@@ -23,19 +22,199 @@ typedef enum CUtilsDataType {
 bool MemoryEquals(const void* buf1, const void* buf2, size_t size);
 // Returns true if the given memory block is 0.
 bool MemoryIsNull(const void* buf, size_t size);
-/* Swaps two given memory blocks. */
+/* Swaps two given memory blocks. The blocks must not overlap unless they
+ * are the same block. */
 void MemorySwap(void* buf1, void* buf2, size_t size);
+/* Returns the first occurrence of the byte in the block, NULL if there
+ * is none. */
+void* MemoryFindByte(const void* buf, size_t size, uint8_t byte);
+/* Returns how many times the byte occurs in the block. */
+size_t MemoryCountByte(const void* buf, size_t size, uint8_t byte);
+/* Reverses the order of the bytes in the block. */
+void MemoryReverse(void* buf, size_t size);
 
-#ifdef CUTILS_TESTS_ENABLED
-extern uint64_t c_utils_total_malloc;
-extern uint64_t c_utils_total_free;
-extern uint64_t c_utils_total_realloc;
-#endif
+typedef enum MemoryBackend {
+    MEMORY_BACKEND_PORTABLE,  // 64 bit words
+    MEMORY_BACKEND_SSE2,      // 16 byte vectors
+    MEMORY_BACKEND_AVX2,      // 32 byte vectors
+} MemoryBackend;
+
+// The fastest supported backend is selected on first use.
+// Forces a backend instead. Returns false if it is not supported by
+// the CPU or wasn't compiled in. Not thread safe, call it at startup.
+bool MemorySetBackend(MemoryBackend backend);
+
+MemoryBackend MemoryGetBackend(void);
+
+// ALLOCATOR
+/* Allocator interface used by every container. Alloc and realloc behave
+ * like their libc counterparts, user data is passed to every call. Free
+ * can be NULL for allocators which release all memory at once (arenas),
+ * containers using them don't walk their elements on free. AllocZeroed is
+ * optional, it returns zeroed memory like calloc. When it is NULL zeroed
+ * allocations are cleared after alloc. Alloc, realloc and allocZeroed must
+ * return blocks aligned to at least 16 bytes like malloc does on 64 bit
+ * systems, arrays keep their default 16 byte alignment without padding. */
+typedef struct CUtilsAllocator {
+    void* (*alloc)(void* userData, size_t size);
+    void* (*realloc)(void* userData, void* buf, size_t newSize);
+    void (*free)(void* userData, void* buf);
+    void* userData;
+    void* (*allocZeroed)(void* userData, size_t size);
+} CUtilsAllocator;
+
+/* Returns the libc allocator. */
+CUtilsAllocator* CUtilsGetHeapAllocator(void);
+
+/* Default allocator is used by CUtilsMalloc, CUtilsRealloc, CUtilsFree and
+ * every container created without an allocator. Containers keep the
+ * allocator they are created with, so set it before creating them. NULL
+ * restores the libc allocator. The allocator must outlive its users. */
+void CUtilsSetDefaultAllocator(CUtilsAllocator* allocator);
+CUtilsAllocator* CUtilsGetDefaultAllocator(void);
+
+/* Heap blocks of at least the threshold are mapped from the OS at 2 MB
+ * boundaries and marked for transparent huge pages, which cuts TLB
+ * misses on big arrays and file buffers. Resizing them moves pages with
+ * mremap instead of copying. 0 disables it, smaller values are raised to
+ * 2 MB. Mapped blocks can be resized and freed after the threshold
+ * changes. Linux only, returns false if it is not supported. */
+#define CUTILS_LARGE_BLOCK_DEFAULT_THRESHOLD (64 * 1024 * 1024)
+bool CUtilsSetLargeBlockThreshold(size_t threshold);
+size_t CUtilsGetLargeBlockThreshold(void);
 
-void* CUtilsMalloc(size_t size);
-void* CUtilsRealloc(void* buf, size_t newSize);
+/* Allocations with the given allocator, NULL means default allocator.
+ * Malloc returns zeroed memory, the heap allocator gets it from calloc so
+ * big blocks come as fresh zero pages. MallocUninit skips clearing, use
+ * it for buffers which are written before read. File and line are the
+ * call site for the profiler, use the macros below. */
+void* CUtilsMallocWithAt(CUtilsAllocator* allocator, size_t size,
+                         const char* file, int line);
+void* CUtilsMallocUninitWithAt(CUtilsAllocator* allocator, size_t size,
+                               const char* file, int line);
+void* CUtilsReallocWithAt(CUtilsAllocator* allocator, void* buf, size_t newSize,
+                          const char* file, int line);
+void* CUtilsFreeWith(CUtilsAllocator* allocator, void* buf);
+
+#define CUtilsMallocWith(allocator, size) \
+    CUtilsMallocWithAt(allocator, size, __FILE__, __LINE__)
+#define CUtilsMallocUninitWith(allocator, size) \
+    CUtilsMallocUninitWithAt(allocator, size, __FILE__, __LINE__)
+#define CUtilsReallocWith(allocator, buf, newSize) \
+    CUtilsReallocWithAt(allocator, buf, newSize, __FILE__, __LINE__)
+
+/* Returns true if the allocator frees memory one by one. */
+static inline bool CUtilsAllocatorCanFree(const CUtilsAllocator* allocator) {
+    return allocator == NULL || allocator->free != NULL;
+}
+
+#define CUtilsMalloc(size) \
+    CUtilsMallocWithAt(NULL, size, __FILE__, __LINE__)
+#define CUtilsMallocUninit(size) \
+    CUtilsMallocUninitWithAt(NULL, size, __FILE__, __LINE__)
+#define CUtilsRealloc(buf, newSize) \
+    CUtilsReallocWithAt(NULL, buf, newSize, __FILE__, __LINE__)
 void* CUtilsFree(void* buf);
 
+// PROFILER
+#define CUTILS_PROFILER_HISTOGRAM_SIZE 32
+
+typedef struct CUtilsProfilerStats {
+    uint64_t mallocCount;
+    uint64_t reallocCount;
+    uint64_t freeCount;
+    /* Live bytes only balance for blocks allocated while the profiler is
+     * enabled. Sizes are the usable sizes reported by libc. */
+    int64_t liveBytes;
+    int64_t peakBytes;
+    /* Sum of the requested sizes. */
+    uint64_t totalBytes;
+    /* Bucket i counts requests of 2^(i-1) + 1 to 2^i bytes, the last
+     * bucket counts all bigger requests. */
+    uint64_t histogram[CUTILS_PROFILER_HISTOGRAM_SIZE];
+} CUtilsProfilerStats;
+
+/* The profiler tracks the memory taken from the heap allocator: counts,
+ * live and peak bytes, a size histogram and the number of allocations
+ * made by each call site. It is disabled by default, a disabled profiler
+ * costs one branch per allocation. Thread safe. */
+void CUtilsProfilerEnable(bool enable);
+bool CUtilsProfilerIsEnabled(void);
+
+/* Clears all counters and call sites. */
+void CUtilsProfilerReset(void);
+
+void CUtilsProfilerGetStats(CUtilsProfilerStats* outStats);
+
+/* Returns the stats and call sites (most allocations first) in a
+ * dictionary, use JsonCreate to dump it. Free it with DictionaryFree. */
+struct Dictionary* CUtilsProfilerCreateReport(void);
+
+// NODE POOL
+#define CUTILS_NODE_POOL_MAX_SIZE 256
+
+/* Allocations for small container nodes. If the allocator is the heap
+ * allocator and size is not bigger than CUTILS_NODE_POOL_MAX_SIZE, memory
+ * comes from a slab pool with a free list for each 16 byte size class.
+ * Each thread has its own lists and slabs, blocks freed by another thread
+ * are returned to the owner in batches. Other allocations go to the
+ * allocator. The same size must be given to CUtilsNodeFree. Malloc returns
+ * zeroed memory. Slabs are kept for the lifetime of the process. Thread
+ * safe. */
+void* CUtilsNodeMalloc(CUtilsAllocator* allocator, size_t size);
+void* CUtilsNodeFree(CUtilsAllocator* allocator, void* buf, size_t size);
+
+// ARENA
+typedef struct CUtilsArenaChunk {
+    struct CUtilsArenaChunk* prev;
+    size_t capacity;
+    size_t used;
+} CUtilsArenaChunk;
+
+/* Arena is a region allocator. Allocations bump a pointer in big chunks
+ * and are never freed one by one, everything is released at once with
+ * CUtilsArenaClear, CUtilsArenaReset or CUtilsArenaFree. Containers created
+ * with the arena allocator allocate everything (nodes, values, nested
+ * copies) from it, their free functions do nothing. Not thread safe. */
+typedef struct CUtilsArena {
+    CUtilsAllocator allocator;
+    // Chunks come from the default allocator at creation time.
+    CUtilsAllocator* backing;
+    CUtilsArenaChunk* current;
+    size_t chunkSize;
+} CUtilsArena;
+
+typedef struct CUtilsArenaMark {
+    CUtilsArenaChunk* chunk;
+    size_t used;
+} CUtilsArenaMark;
+
+/* Creates an arena. Chunk size is the size of each memory block the
+ * arena gets from the heap, 0 means default. Bigger allocations get
+ * their own chunk. */
+CUtilsArena* CUtilsArenaCreate(size_t chunkSize);
+
+/* Frees the arena and everything allocated from it. */
+void CUtilsArenaFree(CUtilsArena* arena);
+
+/* Releases everything allocated from the arena but keeps it usable. */
+void CUtilsArenaClear(CUtilsArena* arena);
+
+/* Returns the current position of the arena. */
+CUtilsArenaMark CUtilsArenaGetMark(CUtilsArena* arena);
+
+/* Releases everything allocated after the mark. */
+void CUtilsArenaReset(CUtilsArena* arena, CUtilsArenaMark mark);
+
+/* Returns zeroed memory aligned to 16 bytes. */
+void* CUtilsArenaMalloc(CUtilsArena* arena, size_t size);
+
+/* Grows in place if buf is the last allocation, copies otherwise. */
+void* CUtilsArenaRealloc(CUtilsArena* arena, void* buf, size_t newSize);
+
+/* Returns the allocator which allocates from the arena. */
+CUtilsAllocator* CUtilsArenaGetAllocator(CUtilsArena* arena);
+
 #ifdef __cplusplus
 }
 #endif
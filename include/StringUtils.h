@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "MemoryUtils.h"
 #include "containers/List.h"
 
 typedef struct String {
@@ -16,6 +17,10 @@ extern "C" {
 
 String StringCreate(uint64_t len);
 
+/* Creates the string with the allocator, NULL means the default allocator.
+ * Copies and substrings of this string use the same allocator. */
+String StringCreateWithAllocator(uint64_t len, CUtilsAllocator* allocator);
+
 String StringCreateCStr(const char* str);
 
 String StringCreateFormat(const char* Format, ...);
@@ -1,25 +1,94 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "MemoryUtils.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Every array keeps its growth policy in its header. Full arrays grow by
+ * the growth factor. Removals shrink the capacity to twice the size once
+ * the size drops below capacity / shrink divisor, 0 never shrinks. The
+ * gap between the two keeps push/pop churn away from realloc. Capacity
+ * never goes below the minimum capacity. */
+typedef struct ArrayGrowthPolicy {
+    float growthFactor;
+    uint32_t shrinkDivisor;
+    uint64_t minCapacity;
+} ArrayGrowthPolicy;
+
+#define ARRAY_DEFAULT_GROWTH_POLICY {2.0f, 4, 1}
+
+/* Elements past the size are not initialized, capacity reserved by
+ * create or resize must be written before it is read. */
 void* _ArrayCreate(size_t stride, uint64_t capacity);
 #define ArrayCreate(type) \
     _ArrayCreate(sizeof(type), 1)
 
+/* Array and all of its resizes are allocated with the allocator.
+ * NULL means the default allocator. */
+void* _ArrayCreateWithAllocator(size_t stride, uint64_t capacity, CUtilsAllocator* allocator);
+#define ArrayCreateWithAllocator(type, allocator) \
+    _ArrayCreateWithAllocator(sizeof(type), 1, allocator)
+
+/* Data starts at a multiple of the alignment, which must be a power of
+ * two, and stays aligned across resizes. Arrays are 16 byte aligned by
+ * default, 32 fits AVX loads and 64 keeps records of up to a cache line
+ * from straddling two lines. Returns NULL if the alignment is invalid. */
+void* _ArrayCreateAligned(size_t stride, uint64_t capacity, size_t alignment,
+                          CUtilsAllocator* allocator);
+#define ArrayCreateAligned(type, alignment) \
+    _ArrayCreateAligned(sizeof(type), 1, alignment, NULL)
+#define ArrayCreateAlignedWithAllocator(type, alignment, allocator) \
+    _ArrayCreateAligned(sizeof(type), 1, alignment, allocator)
+
+/* Bytes of header in front of the elements. */
+#define ARRAY_HEADER_SIZE 64
+
+/* Storage for an inline array of up to capacity elements. Declare it on
+ * the stack or embed it in a struct. */
+#define ArrayInlineStorage(type, capacity)                             \
+    union {                                                            \
+        max_align_t align;                                             \
+        uint8_t bytes[ARRAY_HEADER_SIZE + sizeof(type) * (capacity)]; \
+    }
+
+/* Creates the array inside the storage, nothing is allocated until it
+ * grows past the storage. Then it moves to the allocator and stays there.
+ * The storage must be 16 byte aligned, outlive the array and not move
+ * while the array is inside it. Free it with ArrayFree as usual. Returns
+ * NULL if the storage can't hold one element. */
+void* _ArrayCreateInline(void* storage, size_t storageSize, size_t stride,
+                         CUtilsAllocator* allocator);
+#define ArrayCreateInline(type, storage) \
+    _ArrayCreateInline(storage, sizeof(*(storage)), sizeof(type), NULL)
+
 void* _ArrayFree(void* array);
 #define ArrayFree(array) \
     array = _ArrayFree(array)
 
 void* _ArrayResize(void* array, uint64_t new_capacity);
-#define ArrayPack(array) \
-    array = _ArrayResize(array, ArrayGetSize(array))
 #define ArrayReserve(array, newCapacity) \
     array = _ArrayResize(array, newCapacity)
 
+/* Grows the capacity with the growth policy until it is at least
+ * minCapacity. Never shrinks. */
+void* _ArrayGrow(void* array, uint64_t minCapacity);
+#define ArrayGrow(array, minCapacity) \
+    array = _ArrayGrow(array, minCapacity)
+
+/* Releases the unused capacity down to the minimum capacity. */
+void* _ArrayShrinkToFit(void* array);
+#define ArrayShrinkToFit(array) \
+    array = _ArrayShrinkToFit(array)
+#define ArrayPack(array) \
+    ArrayShrinkToFit(array)
+
+/* Removes all elements, capacity follows the growth policy. */
 void* _ArrayClear(void* array);
 #define ArrayClear(array) \
     array = _ArrayClear(array)
@@ -40,10 +109,23 @@ void* _ArrayPushAt(void* array, const void* value, uint64_t index);
         array = _ArrayPushAt(array, &temp, ArrayGetSize(array)); \
     }
 
+/* Returns a heap copy of the element which must be freed with
+ * CUtilsFree. ArrayPopInto and ArrayDiscardAt don't allocate. */
 void* ArrayPopAt(void* array, uint64_t index);
 #define ArrayPop(array) \
     ArrayPopAt(array, ArrayGetSize(array) - 1)
 
+/* Copies the element to outValue and removes it. Index past the end
+ * pops the last element. Returns false if the array is empty. */
+bool ArrayPopInto(void* array, uint64_t index, void* outValue);
+#define ArrayPopLastInto(array, outValue) \
+    ArrayPopInto(array, ArrayGetSize(array) - 1, outValue)
+
+/* Removes the element without copying it out. */
+bool ArrayDiscardAt(void* array, uint64_t index);
+#define ArrayDiscard(array) \
+    ArrayDiscardAt(array, ArrayGetSize(array) - 1)
+
 void* _ArrayInsertAt(void* array, const void* buffer,
                      uint64_t bufferLength, uint64_t index);
 #define ArrayInsertAt(array, buffer, bufferLength, index) \
@@ -56,6 +138,80 @@ void* _ArrayRemove(void* array, uint64_t startIndex, uint64_t length);
 #define ArrayRemove(array, startIndex, length) \
     array = _ArrayRemove(array, startIndex, length)
 
+/* Bulk removals compact the array in one pass and resize at most once. */
+typedef bool (*ArrayPredicate)(const void* element, void* userData);
+
+/* Removes every element the predicate returns true for. The predicate is
+ * called once per element, in order. */
+void* _ArrayRemoveIf(void* array, ArrayPredicate predicate, void* userData);
+#define ArrayRemoveIf(array, predicate, userData) \
+    array = _ArrayRemoveIf(array, predicate, userData)
+
+/* Removes the elements at the given indices, which must be sorted in
+ * ascending order. Duplicates are removed once. */
+void* _ArrayRemoveIndices(void* array, const uint64_t* indices, uint64_t count);
+#define ArrayRemoveIndices(array, indices, count) \
+    array = _ArrayRemoveIndices(array, indices, count)
+
+/* Removes every element which is bytewise equal to the value. */
+void* _ArrayRemoveValue(void* array, const void* value);
+#define ArrayRemoveValue(array, value) \
+    array = _ArrayRemoveValue(array, &value)
+
+/* Comparator must return 0 if values are same, positive if v1 is bigger
+ * than v2 and negative if v1 is smaller than v2, same as qsort. */
+typedef int (*ArrayComparator)(const void* v1, const void* v2);
+
+/* Sorts in place with introsort, O(n log n) worst case and no
+ * allocation. Equal elements may be reordered. */
+void ArraySort(void* array, ArrayComparator comparator);
+
+/* Merge sort, equal elements keep their order. Allocates a scratch buffer
+ * of the array's size from the array's allocator. */
+void ArrayStableSort(void* array, ArrayComparator comparator);
+
+/* Element types of arrays which hold plain numbers. */
+typedef enum ArrayElementType {
+    ARRAY_ELEMENT_INT32,
+    ARRAY_ELEMENT_UINT32,
+    ARRAY_ELEMENT_FLOAT,
+    ARRAY_ELEMENT_INT64,
+    ARRAY_ELEMENT_UINT64,
+    ARRAY_ELEMENT_DOUBLE,
+} ArrayElementType;
+
+/* Sorts ascending with LSD radix sort, stable and without comparisons.
+ * Negative NaNs go first and positive NaNs last. Allocates a scratch buffer
+ * like ArrayStableSort. Returns false if the stride doesn't match the
+ * type. */
+bool ArrayRadixSort(void* array, ArrayElementType type);
+
+/* Searches and reductions read the leading field of the given type from
+ * every element, so arrays of structs work by their first member. The
+ * stride must be at least the size of the type. Arrays of plain numbers
+ * run on the SSE2/AVX2 kernels of the memory backend. Values compare with
+ * ==, 0.0 matches -0.0 and NaN matches nothing. */
+
+/* Returns false if no element equals the value. */
+bool ArrayFind(const void* array, ArrayElementType type, const void* value, uint64_t* outIndex);
+
+/* Returns a new array of the uint64_t indices of every match, created with
+ * the array's allocator. Free it with ArrayFree. */
+uint64_t* ArrayFindAll(const void* array, ArrayElementType type, const void* value);
+
+uint64_t ArrayCount(const void* array, ArrayElementType type, const void* value);
+
+/* outSum is int64_t for signed, uint64_t for unsigned and double for float
+ * types. Integer sums wrap around, float sums are summed in double in no
+ * particular order. */
+bool ArraySum(const void* array, ArrayElementType type, void* outSum);
+
+/* outMin and outMax are of the element type, either can be NULL. NaNs are
+ * skipped. Returns false if there is no element to compare. */
+bool ArrayMin(const void* array, ArrayElementType type, void* outMin);
+bool ArrayMax(const void* array, ArrayElementType type, void* outMax);
+bool ArrayMinMax(const void* array, ArrayElementType type, void* outMin, void* outMax);
+
 // This is useful if array is void pointer.
 void ArraySetValue(void* array, void* value, uint64_t index);
 
@@ -68,6 +224,19 @@ uint64_t ArrayGetSize(const void* array);
 
 uint64_t ArrayGetStride(const void* array);
 
+/* Returns the allocator the array was created with. */
+CUtilsAllocator* ArrayGetAllocator(const void* array);
+
+/* Returns the alignment the data is kept at, at least 16. */
+size_t ArrayGetAlignment(const void* array);
+
+/* Returns true while the array lives in the storage it was created in. */
+bool ArrayIsInline(const void* array);
+
+/* Growth factor must be bigger than 1. */
+void ArraySetGrowthPolicy(void* array, ArrayGrowthPolicy policy);
+ArrayGrowthPolicy ArrayGetGrowthPolicy(const void* array);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,9 +26,16 @@ typedef struct Dictionary {
 /* Creates an empty dictionary. */
 Dictionary* DictionaryCreate();
 
+/* Creates an empty dictionary. Pairs, keys, values and nested copies are
+ * allocated with the allocator, NULL means the default allocator. */
+Dictionary* DictionaryCreateWithAllocator(CUtilsAllocator* allocator);
+
 /* Returns a copy of the given dictionary. */
 Dictionary* DictionaryCopy(Dictionary* dict);
 
+/* Returns a copy of the given dictionary allocated with the allocator. */
+Dictionary* DictionaryCopyWithAllocator(Dictionary* dict, CUtilsAllocator* allocator);
+
 /* Frees all copied values and pointed objects. */
 void DictionaryFree(Dictionary* dict);
 
@@ -37,6 +44,7 @@ void DictionaryFreePair(Dictionary* dict, DictPair* pair);
 /* Adds pair to dictionary. You can create values with DictionaryCreateValue. */
 void DictionarySet(Dictionary* dict, char* key, CUtilsDataType valueType, void* value);
 
+/* Pair must be created by the dictionary, dictionary owns it after this call. */
 void DictionarySetPair(Dictionary* dict, DictPair* pair);
 
 /* A shortcut for setting string value */
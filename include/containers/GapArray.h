@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MemoryUtils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Elements before the cursor are at the start of data and the ones after
+ * it at the end, the unused capacity between them is the gap. */
+typedef struct GapArray {
+    uint8_t* data;
+    uint64_t capacity;
+    uint64_t gapStart;
+    uint64_t gapEnd;
+    size_t stride;
+    CUtilsAllocator* allocator;
+} GapArray;
+
+// Stride is the size of the each element.
+// Inserts and deletes at the cursor only touch the gap, O(1) amortized.
+// Moving the cursor moves the elements it passes over, so edits which
+// stay around the cursor are cheap where ArrayPushAt would move the
+// whole tail every time.
+GapArray* GapArrayCreate(size_t stride);
+
+// Same as GapArrayCreate but the array and its data are allocated with
+// the allocator. NULL means the default allocator.
+GapArray* GapArrayCreateWithAllocator(size_t stride, CUtilsAllocator* allocator);
+
+void GapArrayFree(GapArray* garr);
+
+/* Removes all elements and moves the cursor to 0, keeps the capacity. */
+void GapArrayClear(GapArray* garr);
+
+uint64_t GapArrayGetSize(const GapArray* garr);
+
+/* Cursor is the index the next insert goes to, 0 to size. */
+uint64_t GapArrayGetCursor(const GapArray* garr);
+
+/* Index past the end moves the cursor to the end. */
+void GapArraySetCursor(GapArray* garr, uint64_t index);
+
+/* Inserts length elements at the cursor and moves the cursor past them. */
+void GapArrayInsert(GapArray* garr, const void* buffer, uint64_t length);
+#define GapArrayPush(garr, value) \
+    GapArrayInsert(garr, &value, 1)
+#define GapArrayPushRV(garr, type, value) \
+    {                                     \
+        type temp = value;                \
+        GapArrayInsert(garr, &temp, 1);   \
+    }
+
+/* Removes up to length elements after the cursor. Returns the number of
+ * removed elements. */
+uint64_t GapArrayDelete(GapArray* garr, uint64_t length);
+
+/* Removes up to length elements before the cursor, the cursor moves back
+ * with them. Returns the number of removed elements. */
+uint64_t GapArrayBackspace(GapArray* garr, uint64_t length);
+
+/* Returns a pointer to the value at index, which skips the gap. The
+ * pointer is valid until the next edit or cursor move. */
+void* GapArrayGetValue(const GapArray* garr, uint64_t index);
+
+void GapArraySetValue(GapArray* garr, const void* value, uint64_t index);
+
+/* Returns a new Array of the elements in order, created with the gap
+ * array's allocator. Free it with ArrayFree. */
+void* GapArrayLinearize(const GapArray* garr);
+
+#ifdef __cplusplus
+}
+#endif
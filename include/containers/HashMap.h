@@ -1,27 +1,39 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "MemoryUtils.h"
 #include "containers/HashMap.h"
-#include "containers/UniqueArray.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct HashMap {
-    UniqueArray* data;
+    void* slots;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t seed;
     size_t stride;
+    CUtilsAllocator* allocator;
 } HashMap;
 
 // Stride is the size of the each value.
-// This hashmap implementation is not actually hashmap, but similar.
-// Hash function generates an integer hash value from keys.
-// This integer values stored to UniqueArray (sorted set),
-// and every value is stored to an array at same index.
-// The value is not found directly, the binary search result is obtained.
+// This is an open addressing hash table with robin hood probing. Every slot
+// holds the full hash of its key and a pointer to a node which stores the
+// key bytes and the value together. Lookups compare hashes first and then
+// the keys, so colliding hashes never share a value. The table doubles its
+// capacity when the load factor is exceeded. Keys are hashed with
+// Hash_WY_64 seeded by the process seed. Pointers returned from
+// HashMapGet stay valid until the key is removed or the map is freed.
 HashMap* HashMapCreate(size_t stride);
 
+// Same as HashMapCreate but the map, its slots and nodes are allocated
+// with the allocator. NULL means the default allocator.
+HashMap* HashMapCreateWithAllocator(size_t stride, CUtilsAllocator* allocator);
+
 void HashMapFree(HashMap* hmap);
 
 void HashMapSet(HashMap* hmap, const char* key, void* value);
@@ -38,6 +50,8 @@ bool HashMapRemove(HashMap* hmap, const char* key);
 
 bool HashMapContains(HashMap* hmap, const char* key);
 
+uint64_t HashMapGetSize(HashMap* hmap);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,11 +19,16 @@ typedef struct LinkedList {
     uint64_t size;
     LinkedListNode* first;
     LinkedListNode* last;
+    CUtilsAllocator* allocator;
 } LinkedList;
 
 /* Creates an empty LinkedList. Stride is the size of the each element. */
 LinkedList* LinkedListCreate(size_t stride);
 
+/* Nodes and values are allocated with the allocator,
+ * NULL means the default allocator. */
+LinkedList* LinkedListCreateWithAllocator(size_t stride, CUtilsAllocator* allocator);
+
 /* Deletes all nodes. */
 void LinkedListClear(LinkedList* list);
 
@@ -55,11 +60,11 @@ void LinkedListPushAt(LinkedList* list, const void* value, uint64_t index);
     }
 
 /* Pops last element from linkedlist and returns its value.
- * Don't forget to free the value. */
+ * Don't forget to free the value with the allocator of the list. */
 void* LinkedListPop(LinkedList* list);
 
 /* Pops element at index and returns its value.
- * Don't forget to free the value. */
+ * Don't forget to free the value with the allocator of the list. */
 void* LinkedListPopAt(LinkedList* list, uint64_t index);
 
 #ifdef __cplusplus
@@ -22,8 +22,14 @@ typedef struct List {
 /* Creates and empty list. */
 List* ListCreate();
 
+/* Creates an empty list. Nodes, values and nested copies are allocated
+ * with the allocator, NULL means the default allocator. */
+List* ListCreateWithAllocator(CUtilsAllocator* allocator);
+
 List* ListCopy(List* list);
 
+List* ListCopyWithAllocator(List* list, CUtilsAllocator* allocator);
+
 /* Deletes list */
 void ListFree(List* list);
 
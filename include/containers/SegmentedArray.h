@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "MemoryUtils.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SegmentedArray {
+    void** blocks;
+    uint64_t blockCount;
+    uint64_t directoryCapacity;
+    uint64_t size;
+    size_t stride;
+    uint32_t blockShift;
+    CUtilsAllocator* allocator;
+} SegmentedArray;
+
+/* Walks the elements one block at a time. Data points to count
+ * contiguous elements of the current block. */
+typedef struct SegmentedArrayIterator {
+    const SegmentedArray* sarr;
+    uint64_t block;
+    void* data;
+    uint64_t count;
+} SegmentedArrayIterator;
+
+// Stride is the size of the each element.
+// Elements live in fixed size blocks of up to 64 KB, found through a
+// directory of block pointers. Growing adds a block and never moves an
+// element, so their addresses stay valid until they are popped or the
+// array is freed. Indexing is a shift and a mask. Returns NULL if the
+// stride is 0.
+SegmentedArray* SegmentedArrayCreate(size_t stride);
+
+// Same as SegmentedArrayCreate but the array, its directory and blocks
+// are allocated with the allocator. NULL means the default allocator.
+SegmentedArray* SegmentedArrayCreateWithAllocator(size_t stride, CUtilsAllocator* allocator);
+
+void SegmentedArrayFree(SegmentedArray* sarr);
+
+/* Removes all elements and keeps the first block. */
+void SegmentedArrayClear(SegmentedArray* sarr);
+
+/* Copies the value to the end and returns the address of the new
+ * element. NULL value leaves the element uninitialized. */
+void* SegmentedArrayPush(SegmentedArray* sarr, const void* value);
+#define SegmentedArrayPushRV(sarr, type, value) \
+    {                                           \
+        type temp = value;                      \
+        SegmentedArrayPush(sarr, &temp);        \
+    }
+
+/* Copies the last element to outValue if it is not NULL and removes it.
+ * One empty block is kept for the next push. Returns false if the array
+ * is empty. */
+bool SegmentedArrayPop(SegmentedArray* sarr, void* outValue);
+
+/* Returns a pointer to the value at index. */
+void* SegmentedArrayGetValue(const SegmentedArray* sarr, uint64_t index);
+
+void SegmentedArraySetValue(SegmentedArray* sarr, const void* value, uint64_t index);
+
+uint64_t SegmentedArrayGetSize(const SegmentedArray* sarr);
+
+/* Returns the number of elements a block holds. */
+uint64_t SegmentedArrayGetBlockCapacity(const SegmentedArray* sarr);
+
+SegmentedArrayIterator SegmentedArrayIterate(const SegmentedArray* sarr);
+
+/* Moves the iterator to the next block. Returns false after the last. */
+bool SegmentedArrayNextBlock(SegmentedArrayIterator* it);
+
+#ifdef __cplusplus
+}
+#endif
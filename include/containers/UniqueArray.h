@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "MemoryUtils.h"
 #include "containers/UniqueArray.h"
 
 #ifdef __cplusplus
@@ -36,6 +37,12 @@ typedef struct UniqueArray {
 UniqueArray* UniqueArrayCreate(size_t stride, size_t capacity,
                                int (*comparator)(const void* v1, const void* v2));
 
+/* Same as UniqueArrayCreate, memory is allocated with the allocator.
+ * NULL means the default allocator. */
+UniqueArray* UniqueArrayCreateWithAllocator(size_t stride, size_t capacity,
+                                            int (*comparator)(const void* v1, const void* v2),
+                                            CUtilsAllocator* allocator);
+
 void UniqueArrayFree(UniqueArray* uniqueArray);
 
 // Adds the given value to the UniqueArray if not contains it.
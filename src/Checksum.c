@@ -0,0 +1,231 @@
+#include "Checksum.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CpuInfo.h"
+#include "Debug.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CHECKSUM_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CHECKSUM_ARMV8
+#endif
+
+// Reflected Castagnoli polynomial.
+#define CRC32C_POLY 0x82f63b78
+// Bytes per stream when three streams run in parallel.
+#define CRC32C_STREAM_SIZE 4096
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PRIVATE BEGIN
+static uint32_t _Table[8][256];
+static pthread_once_t _TableOnce = PTHREAD_ONCE_INIT;
+
+static void _InitTable(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        _Table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            _Table[k][i] = (_Table[k - 1][i] >> 8) ^ _Table[0][_Table[k - 1][i] & 0xff];
+        }
+    }
+}
+
+// Works on the raw (not inverted) state.
+static uint32_t _CRC32CPortable(uint32_t crc, const uint8_t* p, size_t size) {
+    pthread_once(&_TableOnce, _InitTable);
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = (crc >> 8) ^ _Table[0][(crc ^ *p++) & 0xff];
+        size--;
+    }
+    while (size >= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = _Table[7][lo & 0xff] ^ _Table[6][(lo >> 8) & 0xff] ^
+              _Table[5][(lo >> 16) & 0xff] ^ _Table[4][lo >> 24] ^
+              _Table[3][hi & 0xff] ^ _Table[2][(hi >> 8) & 0xff] ^
+              _Table[1][(hi >> 16) & 0xff] ^ _Table[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = (crc >> 8) ^ _Table[0][(crc ^ *p++) & 0xff];
+        size--;
+    }
+    return crc;
+}
+
+#ifdef CHECKSUM_SSE42
+// Constants which shift a CRC over one and two streams, x^(8n - 33) mod P
+// and x^(16n - 33) mod P in the reflected domain for n stream bytes.
+_Static_assert(CRC32C_STREAM_SIZE == 4096, "Recompute the shift constants for the stream size.");
+static const uint64_t _ShiftOne = 0x82f89c77;
+static const uint64_t _ShiftTwo = 0x54a86326;
+
+__attribute__((target("sse4.2"))) static uint32_t _CRC32CSSE42(uint32_t crc, const uint8_t* p, size_t size) {
+    uint64_t crc64 = crc;
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        crc64 = _mm_crc32_u8((uint32_t)crc64, *p++);
+        size--;
+    }
+    while (size >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        size -= 8;
+    }
+    crc = (uint32_t)crc64;
+    while (size > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        size--;
+    }
+    return crc;
+}
+
+// The crc32 instruction has a latency of three cycles but a throughput
+// of one, so three independent streams are computed at once and merged:
+// shifting a CRC over n bytes is a carry-less multiply by x^(8n-33) mod P
+// followed by a 64 bit crc32 reduction.
+__attribute__((target("sse4.2,pclmul"))) static uint32_t _CRC32CPCLMUL(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size >= 3 * CRC32C_STREAM_SIZE) {
+        uint64_t crc0 = crc;
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        const uint8_t* p0 = p;
+        const uint8_t* p1 = p + CRC32C_STREAM_SIZE;
+        const uint8_t* p2 = p + 2 * CRC32C_STREAM_SIZE;
+        for (size_t i = 0; i < CRC32C_STREAM_SIZE; i += 8) {
+            uint64_t v0;
+            uint64_t v1;
+            uint64_t v2;
+            memcpy(&v0, p0 + i, 8);
+            memcpy(&v1, p1 + i, 8);
+            memcpy(&v2, p2 + i, 8);
+            crc0 = _mm_crc32_u64(crc0, v0);
+            crc1 = _mm_crc32_u64(crc1, v1);
+            crc2 = _mm_crc32_u64(crc2, v2);
+        }
+        __m128i shifted0 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc0), _mm_cvtsi64_si128(_ShiftTwo), 0x00);
+        __m128i shifted1 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc1), _mm_cvtsi64_si128(_ShiftOne), 0x00);
+        uint64_t merged = _mm_cvtsi128_si64(_mm_xor_si128(shifted0, shifted1));
+        crc = (uint32_t)(_mm_crc32_u64(0, merged) ^ crc2);
+        p += 3 * CRC32C_STREAM_SIZE;
+        size -= 3 * CRC32C_STREAM_SIZE;
+    }
+    return _CRC32CSSE42(crc, p, size);
+}
+#endif
+
+#ifdef CHECKSUM_ARMV8
+static uint32_t _CRC32CARMv8(uint32_t crc, const uint8_t* p, size_t size) {
+    while (size >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = __crc32cb(crc, *p++);
+        size--;
+    }
+    return crc;
+}
+#endif
+
+typedef uint32_t (*_CRC32CFunc)(uint32_t crc, const uint8_t* p, size_t size);
+
+static _Atomic(_CRC32CFunc) _CRC32C = NULL;
+static _Atomic(ChecksumBackend) _Backend = CHECKSUM_BACKEND_PORTABLE;
+static pthread_once_t _BackendOnce = PTHREAD_ONCE_INIT;
+
+static _CRC32CFunc _BackendFunc(ChecksumBackend backend) {
+    const CpuInfo* cpu = CpuInfoGet();
+    switch (backend) {
+        case CHECKSUM_BACKEND_PORTABLE:
+            return _CRC32CPortable;
+        case CHECKSUM_BACKEND_SSE42:
+#ifdef CHECKSUM_SSE42
+            if (cpu->sse42 && cpu->pclmul) {
+                return _CRC32CPCLMUL;
+            } else if (cpu->sse42) {
+                return _CRC32CSSE42;
+            }
+#endif
+            return NULL;
+        case CHECKSUM_BACKEND_ARMV8:
+#ifdef CHECKSUM_ARMV8
+            if (cpu->armCrc32) {
+                return _CRC32CARMv8;
+            }
+#endif
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+static bool _StoreBackend(ChecksumBackend backend) {
+    _CRC32CFunc func = _BackendFunc(backend);
+    if (func == NULL) {
+        return false;
+    }
+    atomic_store(&_Backend, backend);
+    atomic_store(&_CRC32C, func);
+    return true;
+}
+
+// Picks the fastest supported backend.
+static void _InitBackend(void) {
+    if (!_StoreBackend(CHECKSUM_BACKEND_SSE42) &&
+        !_StoreBackend(CHECKSUM_BACKEND_ARMV8)) {
+        _StoreBackend(CHECKSUM_BACKEND_PORTABLE);
+    }
+}
+
+static inline _CRC32CFunc _Dispatch(void) {
+    pthread_once(&_BackendOnce, _InitBackend);
+    return atomic_load(&_CRC32C);
+}
+// PRIVATE END
+
+uint32_t ChecksumCRC32C(uint32_t crc, const char* buffer, size_t bufferSize) {
+    return ~_Dispatch()(~crc, (const uint8_t*)buffer, bufferSize);
+}
+
+bool ChecksumSetBackend(ChecksumBackend backend) {
+    // Resolve the default first, so it never overwrites this choice.
+    pthread_once(&_BackendOnce, _InitBackend);
+    return _StoreBackend(backend);
+}
+
+ChecksumBackend ChecksumGetBackend(void) {
+    _Dispatch();
+    return atomic_load(&_Backend);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+#include "CpuInfo.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPUINFO_X86
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPUINFO_X86
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PRIVATE BEGIN
+#ifdef CPUINFO_X86
+static void _Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t _Xgetbv(uint32_t index) {
+#if defined(_MSC_VER)
+    return _xgetbv(index);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv"
+                     : "=a"(eax), "=d"(edx)
+                     : "c"(index));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+static void _Detect(CpuInfo* info) {
+    uint32_t regs[4];
+    _Cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1) {
+        return;
+    }
+    _Cpuid(1, 0, regs);
+    info->sse2 = (regs[3] >> 26) & 1;
+    info->ssse3 = (regs[2] >> 9) & 1;
+    info->sse41 = (regs[2] >> 19) & 1;
+    info->sse42 = (regs[2] >> 20) & 1;
+    info->pclmul = (regs[2] >> 1) & 1;
+    bool osxsave = (regs[2] >> 27) & 1;
+    // XMM and YMM state must be enabled by the OS, plus opmask/ZMM for AVX-512.
+    uint64_t xcr0 = osxsave ? _Xgetbv(0) : 0;
+    bool osAvx = (xcr0 & 0x6) == 0x6;
+    bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+    if (maxLeaf >= 7) {
+        _Cpuid(7, 0, regs);
+        info->avx2 = osAvx && ((regs[1] >> 5) & 1);
+        info->avx512f = osAvx512 && ((regs[1] >> 16) & 1);
+        info->sha = (regs[1] >> 29) & 1;
+    }
+}
+#elif defined(__aarch64__)
+static void _Detect(CpuInfo* info) {
+    info->neon = true;
+#if defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    info->armSha2 = (hwcap >> 6) & 1;   // HWCAP_SHA2
+    info->armCrc32 = (hwcap >> 7) & 1;  // HWCAP_CRC32
+    info->armPmull = (hwcap >> 4) & 1;  // HWCAP_PMULL
+#elif defined(__APPLE__)
+    info->armSha2 = true;
+    info->armCrc32 = true;
+    info->armPmull = true;
+#endif
+}
+#else
+static void _Detect(CpuInfo* info) {
+}
+#endif
+
+static CpuInfo _Info;
+static pthread_once_t _InfoOnce = PTHREAD_ONCE_INIT;
+
+static void _InitInfo(void) {
+    memset(&_Info, 0, sizeof(_Info));
+    _Detect(&_Info);
+}
+// PRIVATE END
+
+const CpuInfo* CpuInfoGet(void) {
+    pthread_once(&_InfoOnce, _InitInfo);
+    return &_Info;
+}
+
+#ifdef __cplusplus
+}
+#endif
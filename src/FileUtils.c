@@ -6,6 +6,7 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include "Checksum.h"
 #include "Debug.h"
 #include "MemoryUtils.h"
 #include "StringUtils.h"
@@ -23,6 +24,16 @@ static size_t _GetFileSize(const char* path) {
     return 0;
 }
 
+bool FileUtilsGetSize(const char* path, size_t* outSize) {
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        *outSize = info.st_size;
+        return true;
+    }
+    *outSize = 0;
+    return false;
+}
+
 static inline void _CheckError(FILE* file) {
     if (ferror(file) != 0) {
         perror("[FILE UTILS ERROR]");
@@ -35,11 +46,12 @@ bool FileUtilsReadString(const char* path, String* outString) {
         return false;
     }
     bool success = false;
-    char* buffer = CUtilsMalloc(fileSize + 1);
+    char* buffer = CUtilsMallocUninit(fileSize + 1);
     uint64_t readed;
     FILE* file = fopen(path, "r");
     if (file != NULL) {
         if ((readed = fread(buffer, 1, fileSize, file)) > 0) {
+            buffer[readed] = '\0';
             *outString = StringCreateCStr(buffer);
             // printf("Readed: %I64u, size: %I64u, strlen: %I64u\n", readed, fileSize, outString->length);
             // StringErase(outString, readed, 0);
@@ -95,9 +107,11 @@ bool FileUtilsReadBinary(const char* path, void** outBuffer,
     bool success = false;
     FILE* file = fopen(path, "rb");
     if (file != NULL) {
-        *outBuffer = CUtilsMalloc(fileSize);
-        if (fread(*outBuffer, 1, fileSize, file) > 0) {
-            *outBufferSize = fileSize;
+        // Fread fills the buffer, don't clear it first.
+        *outBuffer = CUtilsMallocUninit(fileSize);
+        size_t readed = fread(*outBuffer, 1, fileSize, file);
+        if (readed > 0) {
+            *outBufferSize = readed;
             success = true;
         } else {
             CUtilsFree(*outBuffer);
@@ -126,6 +140,56 @@ bool FileUtilsWriteBinary(const char* path, void* buffer, size_t bufferSize) {
     return success;
 }
 
+bool FileUtilsWriteBinaryChecksummed(const char* path, void* buffer, size_t bufferSize) {
+    bool success = false;
+    uint8_t trailer[FILE_UTILS_CHECKSUM_SIZE];
+    uint32_t crc = ChecksumCRC32C(0, buffer, bufferSize);
+    for (int i = 0; i < FILE_UTILS_CHECKSUM_SIZE; i++) {
+        trailer[i] = crc >> (i * 8);
+    }
+    FILE* file = fopen(path, "wb");
+    if (file != NULL) {
+        if (fwrite(buffer, 1, bufferSize, file) == bufferSize &&
+            fwrite(trailer, 1, FILE_UTILS_CHECKSUM_SIZE, file) == FILE_UTILS_CHECKSUM_SIZE) {
+            success = true;
+        }
+        fclose(file);
+    }
+    if (!success) {
+        _CheckError(file);
+    }
+    return success;
+}
+
+bool FileUtilsReadBinaryChecksummed(const char* path, void** outBuffer,
+                                    size_t* outBufferSize) {
+    size_t fileSize;
+    if (!FileUtilsReadBinary(path, outBuffer, &fileSize)) {
+        *outBufferSize = 0;
+        return false;
+    }
+    if (fileSize < FILE_UTILS_CHECKSUM_SIZE) {
+        DEBUG_LOG_ERROR("FileUtilsReadBinaryChecksummed: File is too small: %s", path);
+        *outBuffer = CUtilsFree(*outBuffer);
+        *outBufferSize = 0;
+        return false;
+    }
+    size_t dataSize = fileSize - FILE_UTILS_CHECKSUM_SIZE;
+    const uint8_t* trailer = (const uint8_t*)*outBuffer + dataSize;
+    uint32_t expected = 0;
+    for (int i = 0; i < FILE_UTILS_CHECKSUM_SIZE; i++) {
+        expected |= (uint32_t)trailer[i] << (i * 8);
+    }
+    if (ChecksumCRC32C(0, *outBuffer, dataSize) != expected) {
+        DEBUG_LOG_ERROR("FileUtilsReadBinaryChecksummed: Checksum mismatch: %s", path);
+        *outBuffer = CUtilsFree(*outBuffer);
+        *outBufferSize = 0;
+        return false;
+    }
+    *outBufferSize = dataSize;
+    return true;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,15 +1,28 @@
 #include "Hash.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "CpuInfo.h"
 #include "Debug.h"
+#include "FileUtils.h"
 #include "MemoryUtils.h"
 #include "containers/Array.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,44 +35,38 @@ static inline uint32_t _RRot32(uint32_t x, uint32_t c) {
     return (x >> c) | (x << (32 - c));
 }
 
-static inline void _SwitchEndian32(uint32_t* v) {
-    char* b = (char*)v;
-    MemorySwap(b + 0, b + 3, 1);
-    MemorySwap(b + 1, b + 2, 1);
+static inline uint32_t _Load32LE(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-static inline void _SwitchEndian64(uint64_t* v) {
-    char* b = (char*)v;
-    MemorySwap(b + 0, b + 7, 1);
-    MemorySwap(b + 1, b + 6, 1);
-    MemorySwap(b + 2, b + 5, 1);
-    MemorySwap(b + 3, b + 4, 1);
+static inline uint32_t _Load32BE(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
 }
 
-static uint8_t* _PreProcessMessage(const char* buffer, size_t bufferSize,
-                                   uint64_t* outMessageSize, size_t chunkSize, bool switchEndian) {
-    uint64_t messageSize;
-    messageSize = (bufferSize + (chunkSize - (bufferSize % chunkSize)));
-    if (bufferSize % chunkSize >= chunkSize - 8) {
-        messageSize += chunkSize;
-    }
-    uint8_t* message = CUtilsMalloc(messageSize);
-    memcpy(message, buffer, bufferSize);
-    uint64_t index = bufferSize;
-    // append "1" bit to message
-    message[index++] = 0x80;
-    // append "0" bit until message length in bits ≡ 448 (mod 512)
-    while (index % chunkSize != chunkSize - 8) {
-        message[index++] = 0;
-    }
-    // append original length in bits mod (2 pow 64) to message
-    uint64_t lenInBits = bufferSize * 8;
-    if (switchEndian) {
-        _SwitchEndian64(&lenInBits);
-    }
-    memcpy(message + index, &lenInBits, 8);
-    *outMessageSize = messageSize;
-    return message;
+static inline void _Store32LE(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static inline void _Store32BE(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static inline void _Store64LE(uint8_t* p, uint64_t v) {
+    _Store32LE(p, (uint32_t)v);
+    _Store32LE(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline void _Store64BE(uint8_t* p, uint64_t v) {
+    _Store32BE(p, (uint32_t)(v >> 32));
+    _Store32BE(p + 4, (uint32_t)v);
 }
 
 uint64_t Hash_64(const char* buffer, size_t bufferSize) {
@@ -77,183 +84,1126 @@ uint64_t Hash_64(const char* buffer, size_t bufferSize) {
     return hash;
 }
 
+// wyhash constants.
+static const uint64_t _WySecret[4] = {
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+// 64x64 -> 128 bit multiply. A is low, B is high part of the result.
+static inline void _WyMum(uint64_t* A, uint64_t* B) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = *A;
+    r *= *B;
+    *A = (uint64_t)r;
+    *B = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *A >> 32, hb = *B >> 32;
+    uint64_t la = (uint32_t)*A, lb = (uint32_t)*B;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *A = lo;
+    *B = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t _WyMix(uint64_t A, uint64_t B) {
+    _WyMum(&A, &B);
+    return A ^ B;
+}
+
+static inline uint64_t _WyRead8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t _WyRead4(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t _WyRead3(const uint8_t* p, size_t k) {
+    return (((uint64_t)p[0]) << 16) | (((uint64_t)p[k >> 1]) << 8) | p[k - 1];
+}
+
+static uint64_t _WyHash(const uint8_t* p, size_t len, uint64_t seed) {
+    seed ^= _WyMix(seed ^ _WySecret[0], _WySecret[1]);
+    uint64_t a;
+    uint64_t b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (_WyRead4(p) << 32) | _WyRead4(p + ((len >> 3) << 2));
+            b = (_WyRead4(p + len - 4) << 32) | _WyRead4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = _WyRead3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+        if (i >= 48) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = _WyMix(_WyRead8(p) ^ _WySecret[1], _WyRead8(p + 8) ^ seed);
+                see1 = _WyMix(_WyRead8(p + 16) ^ _WySecret[2], _WyRead8(p + 24) ^ see1);
+                see2 = _WyMix(_WyRead8(p + 32) ^ _WySecret[3], _WyRead8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = _WyMix(_WyRead8(p) ^ _WySecret[1], _WyRead8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = _WyRead8(p + i - 16);
+        b = _WyRead8(p + i - 8);
+    }
+    a ^= _WySecret[1];
+    b ^= seed;
+    _WyMum(&a, &b);
+    return _WyMix(a ^ _WySecret[0] ^ len, b ^ _WySecret[1]);
+}
+
+static uint64_t _ProcessSeed = 0;
+static pthread_once_t _ProcessSeedOnce = PTHREAD_ONCE_INIT;
+
+static void _InitProcessSeed(void) {
+    // Stack and static addresses are randomized by ASLR on most systems.
+    uint64_t local = (uint64_t)(uintptr_t)&local;
+    uint64_t entropy = _WyMix((uint64_t)time(NULL) ^ _WySecret[0],
+                              (uint64_t)clock() ^ _WySecret[1]);
+    entropy = _WyMix(entropy ^ local, (uint64_t)(uintptr_t)&_ProcessSeed ^ _WySecret[2]);
+    _ProcessSeed = entropy ? entropy : _WySecret[3];
+}
+
+uint64_t HashGetProcessSeed(void) {
+    // Threads creating their first maps at once must agree on the seed.
+    pthread_once(&_ProcessSeedOnce, _InitProcessSeed);
+    return _ProcessSeed;
+}
+
+uint64_t Hash_WY_64(const char* buffer, size_t bufferSize, uint64_t seed) {
+    return _WyHash((const uint8_t*)buffer, bufferSize, seed);
+}
+
+void Hash_WY_128(const char* buffer, size_t bufferSize, uint64_t seed, uint64_t outHash[2]) {
+    outHash[0] = _WyHash((const uint8_t*)buffer, bufferSize, seed);
+    outHash[1] = _WyHash((const uint8_t*)buffer, bufferSize, seed ^ _WySecret[3]);
+}
+
+// clang-format off
+static const uint32_t _MD5Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static const uint32_t _MD5K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const uint32_t _SHA256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+// clang-format on
+
+// Processes one 64 byte block.
+static void _MD5Block(uint32_t state[4], const uint8_t* block) {
+    uint32_t M[16];
+    for (int i = 0; i < 16; i++) {
+        M[i] = _Load32LE(block + i * 4);
+    }
+    uint32_t A = state[0];
+    uint32_t B = state[1];
+    uint32_t C = state[2];
+    uint32_t D = state[3];
+    for (uint32_t i = 0; i < 64; i++) {
+        uint32_t F;
+        uint32_t g;
+        if (i < 16) {
+            F = (B & C) | (~B & D);
+            g = i;
+        } else if (i < 32) {
+            F = (D & B) | (~D & C);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            F = B ^ C ^ D;
+            g = (3 * i + 5) % 16;
+        } else {
+            F = C ^ (B | ~D);
+            g = (7 * i) % 16;
+        }
+        uint32_t tempD = D;
+        D = C;
+        C = B;
+        B = B + _LRot32(A + F + _MD5K[i] + M[g], _MD5Shifts[i]);
+        A = tempD;
+    }
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+}
+
+// Processes one 64 byte block.
+static void _SHA256Block(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    // Words are big-endian.
+    for (int i = 0; i < 16; i++) {
+        w[i] = _Load32BE(block + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = _RRot32(w[i - 15], 7) ^
+                      _RRot32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = _RRot32(w[i - 2], 17) ^
+                      _RRot32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t S1 = _RRot32(e, 6) ^ _RRot32(e, 11) ^ _RRot32(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + S1 + ch + _SHA256K[i] + w[i];
+        uint32_t S0 = _RRot32(a, 2) ^ _RRot32(a, 13) ^ _RRot32(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = S0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HASH_SHA256_SHANI
+// SHA-NI kernel. State is kept as ABEF/CDGH register pairs between blocks.
+__attribute__((target("sha,sse4.1,ssse3"))) static void _SHA256BlocksSHANI(void* statePtr, const uint8_t* data, size_t blockCount) {
+    uint32_t* state = statePtr;
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);             // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);       // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);    // CDGH
+
+    for (size_t n = 0; n < blockCount; n++, data += 64) {
+        __m128i abefSave = state0;
+        __m128i cdghSave = state1;
+        __m128i msg[4];
+        for (int g = 0; g < 16; g++) {
+            if (g < 4) {
+                msg[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + g * 16)), mask);
+            } else {
+                // W[g] = msg2(msg1(W[g-4], W[g-3]) + W[g-1]:W[g-2] >> 4 bytes, W[g-1])
+                __m128i w = _mm_sha256msg1_epu32(msg[(g - 4) & 3], msg[(g - 3) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(msg[(g - 1) & 3], msg[(g - 2) & 3], 4));
+                msg[g & 3] = _mm_sha256msg2_epu32(w, msg[(g - 1) & 3]);
+            }
+            __m128i wk = _mm_add_epi32(msg[g & 3], _mm_loadu_si128((const __m128i*)(_SHA256K + g * 4)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            wk = _mm_shuffle_epi32(wk, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);          // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);       // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);    // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);       // ABEF
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define HASH_SHA256_ARMV8
+// ARMv8 crypto extension kernel.
+static void _SHA256BlocksARMv8(void* statePtr, const uint8_t* data, size_t blockCount) {
+    uint32_t* state = statePtr;
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+    for (size_t n = 0; n < blockCount; n++, data += 64) {
+        uint32x4_t abcdSave = state0;
+        uint32x4_t efghSave = state1;
+        uint32x4_t msg[4];
+        for (int g = 0; g < 4; g++) {
+            msg[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + g * 16)));
+        }
+        for (int g = 0; g < 16; g++) {
+            uint32x4_t wk = vaddq_u32(msg[g & 3], vld1q_u32(_SHA256K + g * 4));
+            if (g < 12) {
+                msg[g & 3] = vsha256su1q_u32(vsha256su0q_u32(msg[g & 3], msg[(g + 1) & 3]),
+                                             msg[(g + 2) & 3], msg[(g + 3) & 3]);
+            }
+            uint32x4_t tmp = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, tmp, wk);
+        }
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+    }
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+static void _SHA256BlocksPortable(void* state, const uint8_t* data, size_t blockCount) {
+    for (size_t n = 0; n < blockCount; n++, data += 64) {
+        _SHA256Block(state, data);
+    }
+}
+
+static void _MD5Blocks(void* state, const uint8_t* data, size_t blockCount) {
+    for (size_t n = 0; n < blockCount; n++, data += 64) {
+        _MD5Block(state, data);
+    }
+}
+
+typedef void (*_BlocksFunc)(void* state, const uint8_t* data, size_t blockCount);
+
+static _Atomic(_BlocksFunc) _SHA256Blocks = NULL;
+static _Atomic(HashSHA256Backend) _SHA256Backend = HASH_SHA256_BACKEND_PORTABLE;
+static pthread_once_t _SHA256BackendOnce = PTHREAD_ONCE_INIT;
+
+static _BlocksFunc _SHA256BackendFunc(HashSHA256Backend backend) {
+    const CpuInfo* cpu = CpuInfoGet();
+    switch (backend) {
+        case HASH_SHA256_BACKEND_PORTABLE:
+            return _SHA256BlocksPortable;
+        case HASH_SHA256_BACKEND_SHANI:
+#ifdef HASH_SHA256_SHANI
+            if (cpu->sha && cpu->sse41 && cpu->ssse3) {
+                return _SHA256BlocksSHANI;
+            }
+#endif
+            return NULL;
+        case HASH_SHA256_BACKEND_ARMV8:
+#ifdef HASH_SHA256_ARMV8
+            if (cpu->armSha2) {
+                return _SHA256BlocksARMv8;
+            }
+#endif
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+static bool _SHA256StoreBackend(HashSHA256Backend backend) {
+    _BlocksFunc func = _SHA256BackendFunc(backend);
+    if (func == NULL) {
+        return false;
+    }
+    atomic_store(&_SHA256Backend, backend);
+    atomic_store(&_SHA256Blocks, func);
+    return true;
+}
+
+// Picks the fastest supported backend.
+static void _SHA256InitBackend(void) {
+    if (!_SHA256StoreBackend(HASH_SHA256_BACKEND_SHANI) &&
+        !_SHA256StoreBackend(HASH_SHA256_BACKEND_ARMV8)) {
+        _SHA256StoreBackend(HASH_SHA256_BACKEND_PORTABLE);
+    }
+}
+
+static inline _BlocksFunc _SHA256Dispatch(void) {
+    pthread_once(&_SHA256BackendOnce, _SHA256InitBackend);
+    return atomic_load(&_SHA256Blocks);
+}
+
+bool HashSHA256SetBackend(HashSHA256Backend backend) {
+    // Resolve the default first, so it never overwrites this choice.
+    pthread_once(&_SHA256BackendOnce, _SHA256InitBackend);
+    return _SHA256StoreBackend(backend);
+}
+
+HashSHA256Backend HashSHA256GetBackend(void) {
+    _SHA256Dispatch();
+    return atomic_load(&_SHA256Backend);
+}
+
+// Feeds data to a block function. Full blocks are processed directly
+// from the given buffer, only the remaining tail is copied.
+// Block size must be a power of two.
+static void _UpdateBlocks(void* state, uint8_t* block, uint64_t blockSize, uint64_t* length,
+                          const uint8_t* data, size_t dataSize, _BlocksFunc blocksFunc) {
+    uint64_t used = *length & (blockSize - 1);
+    *length += dataSize;
+    if (used > 0) {
+        uint64_t fill = blockSize - used;
+        if (dataSize < fill) {
+            memcpy(block + used, data, dataSize);
+            return;
+        }
+        memcpy(block + used, data, fill);
+        blocksFunc(state, block, 1);
+        data += fill;
+        dataSize -= fill;
+    }
+    if (dataSize >= blockSize) {
+        blocksFunc(state, data, dataSize / blockSize);
+        data += dataSize & ~(size_t)(blockSize - 1);
+        dataSize &= blockSize - 1;
+    }
+    memcpy(block, data, dataSize);
+}
+
+// Appends "1" bit, "0" bits and the message length in bits.
+static void _Pad64(void* state, uint8_t block[64], uint64_t length, bool bigEndian, _BlocksFunc blocksFunc) {
+    uint64_t used = length % 64;
+    block[used++] = 0x80;
+    if (used > 56) {
+        memset(block + used, 0, 64 - used);
+        blocksFunc(state, block, 1);
+        used = 0;
+    }
+    memset(block + used, 0, 56 - used);
+    if (bigEndian) {
+        _Store64BE(block + 56, length * 8);
+    } else {
+        _Store64LE(block + 56, length * 8);
+    }
+    blocksFunc(state, block, 1);
+}
+
+void HashMD5Init(HashMD5Context* context) {
+    context->state[0] = 0x67452301;
+    context->state[1] = 0xefcdab89;
+    context->state[2] = 0x98badcfe;
+    context->state[3] = 0x10325476;
+    context->length = 0;
+}
+
+void HashMD5Update(HashMD5Context* context, const char* buffer, size_t bufferSize) {
+    _UpdateBlocks(context->state, context->block, 64, &context->length,
+              (const uint8_t*)buffer, bufferSize, _MD5Blocks);
+}
+
+void HashMD5Final(HashMD5Context* context, uint8_t outHash[16]) {
+    _Pad64(context->state, context->block, context->length, false, _MD5Blocks);
+    for (int i = 0; i < 4; i++) {
+        _Store32LE(outHash + i * 4, context->state[i]);
+    }
+}
+
 uint8_t* Hash_MD5_128(const char* buffer, size_t bufferSize) {
-    // clang-format off
-    uint32_t s[64] = {
-        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
-        5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
-        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
-        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
-    };
-    uint32_t K[64] = {
-        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-        0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-        0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-        0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-        0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-        0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-        0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
-    };
-    // clang-format on
-    uint32_t a = 0x67452301;
-    uint32_t b = 0xefcdab89;
-    uint32_t c = 0x98badcfe;
-    uint32_t d = 0x10325476;
-    uint64_t messageLen;
-    uint8_t* message = _PreProcessMessage(buffer, bufferSize, &messageLen, 64, false);
-    for (uint64_t j = 0; j < messageLen / 64; j++) {
-        uint32_t* M = (uint32_t*)(message + j * (messageLen / 64));
-        uint32_t A = a;
-        uint32_t B = b;
-        uint32_t C = c;
-        uint32_t D = d;
-        for (uint64_t i = 0; i < 64; i++) {
-            uint32_t F;
+    HashMD5Context context;
+    HashMD5Init(&context);
+    HashMD5Update(&context, buffer, bufferSize);
+    uint8_t* hash = CUtilsMalloc(16);
+    HashMD5Final(&context, hash);
+    return hash;
+}
+
+void HashSHA256Init(HashSHA256Context* context) {
+    context->state[0] = 0x6a09e667;
+    context->state[1] = 0xbb67ae85;
+    context->state[2] = 0x3c6ef372;
+    context->state[3] = 0xa54ff53a;
+    context->state[4] = 0x510e527f;
+    context->state[5] = 0x9b05688c;
+    context->state[6] = 0x1f83d9ab;
+    context->state[7] = 0x5be0cd19;
+    context->length = 0;
+}
+
+void HashSHA256Update(HashSHA256Context* context, const char* buffer, size_t bufferSize) {
+    _UpdateBlocks(context->state, context->block, 64, &context->length,
+              (const uint8_t*)buffer, bufferSize, _SHA256Dispatch());
+}
+
+void HashSHA256Final(HashSHA256Context* context, uint8_t outHash[32]) {
+    _Pad64(context->state, context->block, context->length, true, _SHA256Dispatch());
+    for (int i = 0; i < 8; i++) {
+        _Store32BE(outHash + i * 4, context->state[i]);
+    }
+}
+
+uint8_t* Hash_SHA2_256(const char* buffer, size_t bufferSize) {
+    HashSHA256Context context;
+    HashSHA256Init(&context);
+    HashSHA256Update(&context, buffer, bufferSize);
+    uint8_t* hash = CUtilsMalloc(32);
+    HashSHA256Final(&context, hash);
+    return hash;
+}
+
+// BATCH BEGIN
+// Every message of a batch is a lane. Full blocks are read from the
+// message, the padded tail (one or two blocks) is built per lane.
+typedef struct {
+    const uint8_t* data;
+    uint64_t fullBlocks;
+    uint64_t totalBlocks;
+    uint8_t tail[128];
+} _BatchLane;
+
+static void _BatchLaneInit(_BatchLane* lane, const HashBatchItem* item, bool bigEndian) {
+    uint64_t size = item->bufferSize;
+    uint64_t rem = size % 64;
+    lane->data = (const uint8_t*)item->buffer;
+    lane->fullBlocks = size / 64;
+    uint64_t tailBlocks = rem + 9 > 64 ? 2 : 1;
+    lane->totalBlocks = lane->fullBlocks + tailBlocks;
+    if (rem > 0) {
+        memcpy(lane->tail, lane->data + size - rem, rem);
+    }
+    lane->tail[rem] = 0x80;
+    memset(lane->tail + rem + 1, 0, tailBlocks * 64 - rem - 1 - 8);
+    if (bigEndian) {
+        _Store64BE(lane->tail + tailBlocks * 64 - 8, size * 8);
+    } else {
+        _Store64LE(lane->tail + tailBlocks * 64 - 8, size * 8);
+    }
+}
+
+// Finished lanes keep returning a valid block, their results are masked.
+static inline const uint8_t* _BatchLaneBlock(const _BatchLane* lane, uint64_t index) {
+    if (index < lane->fullBlocks) {
+        return lane->data + index * 64;
+    } else if (index < lane->totalBlocks) {
+        return lane->tail + (index - lane->fullBlocks) * 64;
+    }
+    return lane->tail;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HASH_BATCH_AVX2
+
+#define AVX2_TRANSPOSE8(r)                                   \
+    {                                                        \
+        __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);      \
+        __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);      \
+        __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);      \
+        __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);      \
+        __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);      \
+        __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);      \
+        __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);      \
+        __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);      \
+        __m256i u0 = _mm256_unpacklo_epi64(t0, t2);          \
+        __m256i u1 = _mm256_unpackhi_epi64(t0, t2);          \
+        __m256i u2 = _mm256_unpacklo_epi64(t1, t3);          \
+        __m256i u3 = _mm256_unpackhi_epi64(t1, t3);          \
+        __m256i u4 = _mm256_unpacklo_epi64(t4, t6);          \
+        __m256i u5 = _mm256_unpackhi_epi64(t4, t6);          \
+        __m256i u6 = _mm256_unpacklo_epi64(t5, t7);          \
+        __m256i u7 = _mm256_unpackhi_epi64(t5, t7);          \
+        r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);      \
+        r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);      \
+        r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);      \
+        r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);      \
+        r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);      \
+        r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);      \
+        r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);      \
+        r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);      \
+    }
+
+#define AVX2_ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+// Hashes up to 8 messages, one per 32 bit lane.
+__attribute__((target("avx2"))) static void _SHA256BatchAVX2(const HashBatchItem* items, int count, uint8_t* outHashes) {
+    const __m256i byteSwap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+                                             12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    _BatchLane lanes[8];
+    uint64_t maxBlocks = 0;
+    for (int l = 0; l < 8; l++) {
+        _BatchLaneInit(lanes + l, items + (l < count ? l : 0), true);
+        if (l < count && lanes[l].totalBlocks > maxBlocks) {
+            maxBlocks = lanes[l].totalBlocks;
+        }
+    }
+    __m256i state[8];
+    for (int i = 0; i < 8; i++) {
+        state[i] = _mm256_set1_epi32(initial[i]);
+    }
+    for (uint64_t b = 0; b < maxBlocks; b++) {
+        uint32_t activeMask[8];
+        const uint8_t* blocks[8];
+        for (int l = 0; l < 8; l++) {
+            blocks[l] = _BatchLaneBlock(lanes + l, b);
+            activeMask[l] = (l < count && b < lanes[l].totalBlocks) ? 0xffffffff : 0;
+        }
+        __m256i w[16];
+        for (int half = 0; half < 2; half++) {
+            for (int l = 0; l < 8; l++) {
+                w[half * 8 + l] = _mm256_loadu_si256((const __m256i*)(blocks[l] + half * 32));
+            }
+            AVX2_TRANSPOSE8((w + half * 8));
+            for (int i = 0; i < 8; i++) {
+                w[half * 8 + i] = _mm256_shuffle_epi8(w[half * 8 + i], byteSwap);
+            }
+        }
+        __m256i a = state[0], b_ = state[1], c = state[2], d = state[3];
+        __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            if (i >= 16) {
+                __m256i w15 = w[(i - 15) & 15];
+                __m256i w2 = w[(i - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w15, 7), AVX2_ROTR(w15, 18)),
+                                              _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(w2, 17), AVX2_ROTR(w2, 19)),
+                                              _mm256_srli_epi32(w2, 10));
+                w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0),
+                                             _mm256_add_epi32(w[(i - 7) & 15], s1));
+            }
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(e, 6), AVX2_ROTR(e, 11)), AVX2_ROTR(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                             _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(_SHA256K[i])), w[i & 15]));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(AVX2_ROTR(a, 2), AVX2_ROTR(a, 13)), AVX2_ROTR(a, 22));
+            __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b_), _mm256_and_si256(a, c)),
+                                           _mm256_and_si256(b_, c));
+            __m256i temp2 = _mm256_add_epi32(S0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, temp1);
+            d = c;
+            c = b_;
+            b_ = a;
+            a = _mm256_add_epi32(temp1, temp2);
+        }
+        __m256i active = _mm256_loadu_si256((const __m256i*)activeMask);
+        __m256i result[8] = {a, b_, c, d, e, f, g, h};
+        for (int i = 0; i < 8; i++) {
+            state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], result[i]), active);
+        }
+    }
+    AVX2_TRANSPOSE8(state);
+    for (int l = 0; l < count; l++) {
+        __m256i digest = _mm256_shuffle_epi8(state[l], byteSwap);
+        _mm256_storeu_si256((__m256i*)(outHashes + l * 32), digest);
+    }
+}
+
+// Hashes up to 8 messages, one per 32 bit lane.
+__attribute__((target("avx2"))) static void _MD5BatchAVX2(const HashBatchItem* items, int count, uint8_t* outHashes) {
+    _BatchLane lanes[8];
+    uint64_t maxBlocks = 0;
+    for (int l = 0; l < 8; l++) {
+        _BatchLaneInit(lanes + l, items + (l < count ? l : 0), false);
+        if (l < count && lanes[l].totalBlocks > maxBlocks) {
+            maxBlocks = lanes[l].totalBlocks;
+        }
+    }
+    __m256i state[8];
+    state[0] = _mm256_set1_epi32(0x67452301);
+    state[1] = _mm256_set1_epi32(0xefcdab89);
+    state[2] = _mm256_set1_epi32(0x98badcfe);
+    state[3] = _mm256_set1_epi32(0x10325476);
+    const __m256i ones = _mm256_set1_epi32(-1);
+    for (uint64_t b = 0; b < maxBlocks; b++) {
+        uint32_t activeMask[8];
+        const uint8_t* blocks[8];
+        for (int l = 0; l < 8; l++) {
+            blocks[l] = _BatchLaneBlock(lanes + l, b);
+            activeMask[l] = (l < count && b < lanes[l].totalBlocks) ? 0xffffffff : 0;
+        }
+        __m256i M[16];
+        for (int half = 0; half < 2; half++) {
+            for (int l = 0; l < 8; l++) {
+                M[half * 8 + l] = _mm256_loadu_si256((const __m256i*)(blocks[l] + half * 32));
+            }
+            AVX2_TRANSPOSE8((M + half * 8));
+        }
+        __m256i A = state[0], B = state[1], C = state[2], D = state[3];
+        for (uint32_t i = 0; i < 64; i++) {
+            __m256i F;
             uint32_t g;
             if (i < 16) {
-                F = (B & C) | (~B & D);
+                F = _mm256_or_si256(_mm256_and_si256(B, C), _mm256_andnot_si256(B, D));
                 g = i;
             } else if (i < 32) {
-                F = (D & B) | (~D & C);
+                F = _mm256_or_si256(_mm256_and_si256(D, B), _mm256_andnot_si256(D, C));
                 g = (5 * i + 1) % 16;
             } else if (i < 48) {
-                F = B ^ C ^ D;
+                F = _mm256_xor_si256(_mm256_xor_si256(B, C), D);
                 g = (3 * i + 5) % 16;
             } else {
-                F = C ^ (B | ~D);
+                F = _mm256_xor_si256(C, _mm256_or_si256(B, _mm256_xor_si256(D, ones)));
                 g = (7 * i) % 16;
             }
-            uint32_t tempD = D;
+            __m256i temp = _mm256_add_epi32(_mm256_add_epi32(A, F),
+                                            _mm256_add_epi32(_mm256_set1_epi32(_MD5K[i]), M[g]));
+            temp = _mm256_or_si256(_mm256_sll_epi32(temp, _mm_cvtsi32_si128(_MD5Shifts[i])),
+                                   _mm256_srl_epi32(temp, _mm_cvtsi32_si128(32 - _MD5Shifts[i])));
+            __m256i tempD = D;
             D = C;
             C = B;
-            B = B + _LRot32(A + F + K[i] + M[g], s[i]);
+            B = _mm256_add_epi32(B, temp);
             A = tempD;
         }
-        a += A;
-        b += B;
-        c += C;
-        d += D;
+        __m256i active = _mm256_loadu_si256((const __m256i*)activeMask);
+        __m256i result[4] = {A, B, C, D};
+        for (int i = 0; i < 4; i++) {
+            state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], result[i]), active);
+        }
+    }
+    for (int i = 4; i < 8; i++) {
+        state[i] = _mm256_setzero_si256();
+    }
+    AVX2_TRANSPOSE8(state);
+    for (int l = 0; l < count; l++) {
+        // Little-endian words, lower 16 bytes of the row.
+        _mm_storeu_si128((__m128i*)(outHashes + l * 16), _mm256_castsi256_si128(state[l]));
     }
-    CUtilsFree(message);
-    uint8_t* hash = CUtilsMalloc(16);
-    memcpy(hash + 0, &a, 4);
-    memcpy(hash + 4, &b, 4);
-    memcpy(hash + 8, &c, 4);
-    memcpy(hash + 12, &d, 4);
-    return hash;
 }
 
-uint8_t* Hash_SHA2_256(const char* buffer, size_t bufferSize) {
-    uint32_t h0 = 0x6a09e667;
-    uint32_t h1 = 0xbb67ae85;
-    uint32_t h2 = 0x3c6ef372;
-    uint32_t h3 = 0xa54ff53a;
-    uint32_t h4 = 0x510e527f;
-    uint32_t h5 = 0x9b05688c;
-    uint32_t h6 = 0x1f83d9ab;
-    uint32_t h7 = 0x5be0cd19;
-
-    uint32_t k[64] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
-
-    uint64_t messageSize;
-    uint8_t* message = _PreProcessMessage(buffer, bufferSize, &messageSize, 64, true);
-
-    for (uint64_t j = 0; j < messageSize / 64; j++) {
-        uint32_t w[64];
-        memcpy(w, message + j * (messageSize / 64), 16 * 4);
-        // This implementation is little-endian and constant values are
-        // big-endian. We must switch these bytes.
-        for (int i = 0; i < 16; i++) {
-            _SwitchEndian32(w + i);
+#undef AVX2_TRANSPOSE8
+#undef AVX2_ROTR
+#endif
+
+static _Atomic(HashBatchBackend) _BatchBackend = HASH_BATCH_BACKEND_AUTO;
+
+bool HashBatchSetBackend(HashBatchBackend backend) {
+    if (backend == HASH_BATCH_BACKEND_AVX2) {
+#ifdef HASH_BATCH_AVX2
+        if (!CpuInfoGet()->avx2) {
+            return false;
         }
+#else
+        return false;
+#endif
+    }
+    atomic_store(&_BatchBackend, backend);
+    return true;
+}
+
+static bool _BatchUseAVX2(bool hardwareSingleStream) {
+#ifdef HASH_BATCH_AVX2
+    switch (atomic_load(&_BatchBackend)) {
+        case HASH_BATCH_BACKEND_AVX2:
+            return true;
+        case HASH_BATCH_BACKEND_SCALAR:
+            return false;
+        default:
+            // Hardware single stream kernels beat 8 software lanes.
+            return !hardwareSingleStream && CpuInfoGet()->avx2;
+    }
+#else
+    return false;
+#endif
+}
 
-        for (int i = 16; i < 64; i++) {
-            uint32_t s0 = _RRot32(w[i - 15], 7) ^
-                          _RRot32(w[i - 15], 18) ^ (w[i - 15] >> 3);
-            uint32_t s1 = _RRot32(w[i - 2], 17) ^
-                          _RRot32(w[i - 2], 19) ^ (w[i - 2] >> 10);
-            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+void HashSHA256Batch(const HashBatchItem* items, size_t count, uint8_t* outHashes) {
+    size_t i = 0;
+#ifdef HASH_BATCH_AVX2
+    if (_BatchUseAVX2(HashSHA256GetBackend() != HASH_SHA256_BACKEND_PORTABLE)) {
+        for (; i < count; i += 8) {
+            int lanes = count - i < 8 ? count - i : 8;
+            _SHA256BatchAVX2(items + i, lanes, outHashes + i * 32);
         }
+        return;
+    }
+#endif
+    HashSHA256Context context;
+    for (; i < count; i++) {
+        HashSHA256Init(&context);
+        HashSHA256Update(&context, items[i].buffer, items[i].bufferSize);
+        HashSHA256Final(&context, outHashes + i * 32);
+    }
+}
 
-        uint32_t a = h0;
-        uint32_t b = h1;
-        uint32_t c = h2;
-        uint32_t d = h3;
-        uint32_t e = h4;
-        uint32_t f = h5;
-        uint32_t g = h6;
-        uint32_t h = h7;
+void HashMD5Batch(const HashBatchItem* items, size_t count, uint8_t* outHashes) {
+    size_t i = 0;
+#ifdef HASH_BATCH_AVX2
+    if (_BatchUseAVX2(false)) {
+        for (; i < count; i += 8) {
+            int lanes = count - i < 8 ? count - i : 8;
+            _MD5BatchAVX2(items + i, lanes, outHashes + i * 16);
+        }
+        return;
+    }
+#endif
+    HashMD5Context context;
+    for (; i < count; i++) {
+        HashMD5Init(&context);
+        HashMD5Update(&context, items[i].buffer, items[i].bufferSize);
+        HashMD5Final(&context, outHashes + i * 16);
+    }
+}
+// BATCH END
 
-        for (int i = 0; i < 64; i++) {
-            uint32_t S1 = _RRot32(e, 6) ^ _RRot32(e, 11) ^ _RRot32(e, 25);
-            uint32_t ch = (e & f) ^ (~e & g);
-            uint32_t temp1 = h + S1 + ch + k[i] + w[i];
-            uint32_t S0 = _RRot32(a, 2) ^ _RRot32(a, 13) ^ _RRot32(a, 22);
-            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
-            uint32_t temp2 = S0 + maj;
-            h = g;
-            g = f;
-            f = e;
-            e = d + temp1;
-            d = c;
-            c = b;
-            b = a;
-            a = temp1 + temp2;
+// TREE BEGIN
+typedef struct {
+    const uint8_t* buffer;  // NULL if hashing a file
+    const char* path;
+    uint8_t* chunk;         // read buffer for file mode
+    uint64_t size;
+    uint64_t leafCount;
+    uint32_t threadIndex;
+    uint32_t threadCount;
+    uint8_t* leaves;
+    bool failed;
+} _TreeWorker;
+
+static void _TreeLeaf(const uint8_t* data, uint64_t size, uint8_t* outHash) {
+    static const char leafPrefix = 0x00;
+    HashSHA256Context context;
+    HashSHA256Init(&context);
+    HashSHA256Update(&context, &leafPrefix, 1);
+    HashSHA256Update(&context, (const char*)data, size);
+    HashSHA256Final(&context, outHash);
+}
+
+// Workers take every threadCount'th chunk, all chunks have the same size.
+static void* _TreeWorkerRun(void* arg) {
+    _TreeWorker* worker = arg;
+    FILE* file = NULL;
+    if (worker->path) {
+        file = fopen(worker->path, "rb");
+        if (file == NULL) {
+            worker->failed = true;
+            return NULL;
+        }
+    }
+    for (uint64_t leaf = worker->threadIndex; leaf < worker->leafCount; leaf += worker->threadCount) {
+        uint64_t offset = leaf * HASH_TREE_CHUNK_SIZE;
+        uint64_t length = worker->size - offset < HASH_TREE_CHUNK_SIZE ? worker->size - offset : HASH_TREE_CHUNK_SIZE;
+        const uint8_t* data = worker->buffer + offset;
+        if (file) {
+            if (fseeko(file, (off_t)offset, SEEK_SET) != 0 ||
+                fread(worker->chunk, 1, length, file) != length) {
+                worker->failed = true;
+                break;
+            }
+            data = worker->chunk;
+        }
+        _TreeLeaf(data, length, worker->leaves + leaf * 32);
+    }
+    if (file) {
+        fclose(file);
+    }
+    return NULL;
+}
+
+// Parent is SHA256(0x01 || left || right), an odd node moves up unchanged.
+static void _TreeCombine(uint8_t* nodes, uint64_t count, uint8_t outHash[32]) {
+    static const char nodePrefix = 0x01;
+    HashSHA256Context context;
+    while (count > 1) {
+        uint64_t next = 0;
+        for (uint64_t i = 0; i + 1 < count; i += 2) {
+            HashSHA256Init(&context);
+            HashSHA256Update(&context, &nodePrefix, 1);
+            HashSHA256Update(&context, (const char*)nodes + i * 32, 64);
+            HashSHA256Final(&context, nodes + next * 32);
+            next++;
+        }
+        if (count % 2 == 1) {
+            memmove(nodes + next * 32, nodes + (count - 1) * 32, 32);
+            next++;
+        }
+        count = next;
+    }
+    memcpy(outHash, nodes, 32);
+}
+
+static bool _TreeHash(const uint8_t* buffer, const char* path, uint64_t size,
+                      uint32_t threadCount, uint8_t outHash[32]) {
+    uint64_t leafCount = size == 0 ? 1 : (size + HASH_TREE_CHUNK_SIZE - 1) / HASH_TREE_CHUNK_SIZE;
+    if (threadCount == 0) {
+        long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpuCount > 0 ? (uint32_t)cpuCount : 1;
+    }
+    if (threadCount > leafCount) {
+        threadCount = leafCount;
+    }
+    uint8_t* leaves = CUtilsMalloc(leafCount * 32);
+    _TreeWorker* workers = CUtilsMalloc(threadCount * sizeof(_TreeWorker));
+    pthread_t* threads = CUtilsMalloc(threadCount * sizeof(pthread_t));
+    bool* started = CUtilsMalloc(threadCount * sizeof(bool));
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers[i].buffer = buffer;
+        workers[i].path = path;
+        workers[i].chunk = path ? CUtilsMalloc(HASH_TREE_CHUNK_SIZE) : NULL;
+        workers[i].size = size;
+        workers[i].leafCount = leafCount;
+        workers[i].threadIndex = i;
+        workers[i].threadCount = threadCount;
+        workers[i].leaves = leaves;
+        workers[i].failed = false;
+    }
+    // The calling thread works as the first worker.
+    for (uint32_t i = 1; i < threadCount; i++) {
+        started[i] = pthread_create(threads + i, NULL, _TreeWorkerRun, workers + i) == 0;
+    }
+    _TreeWorkerRun(workers);
+    bool success = !workers[0].failed;
+    for (uint32_t i = 1; i < threadCount; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        } else {
+            _TreeWorkerRun(workers + i);
+        }
+        success = success && !workers[i].failed;
+    }
+    if (success) {
+        _TreeCombine(leaves, leafCount, outHash);
+    }
+    for (uint32_t i = 0; i < threadCount; i++) {
+        if (workers[i].chunk) {
+            CUtilsFree(workers[i].chunk);
         }
+    }
+    CUtilsFree(started);
+    CUtilsFree(threads);
+    CUtilsFree(workers);
+    CUtilsFree(leaves);
+    return success;
+}
 
-        h0 += a;
-        h1 += b;
-        h2 += c;
-        h3 += d;
-        h4 += e;
-        h5 += f;
-        h6 += g;
-        h7 += h;
+void HashTreeSHA256(const char* buffer, size_t bufferSize, uint32_t threadCount, uint8_t outHash[32]) {
+    if (bufferSize == 0) {
+        // Empty input hashes the same with or without a buffer.
+        buffer = "";
     }
+    _TreeHash((const uint8_t*)buffer, NULL, bufferSize, threadCount, outHash);
+}
 
-    CUtilsFree(message);
+bool HashTreeSHA256File(const char* path, uint32_t threadCount, uint8_t outHash[32]) {
+    size_t fileSize;
+    if (!FileUtilsGetSize(path, &fileSize)) {
+        DEBUG_LOG_ERROR("HashTreeSHA256File: File not found: %s", path);
+        return false;
+    }
+    return _TreeHash(NULL, path, fileSize, threadCount, outHash);
+}
+// TREE END
 
-    _SwitchEndian32(&h0);
-    _SwitchEndian32(&h1);
-    _SwitchEndian32(&h2);
-    _SwitchEndian32(&h3);
-    _SwitchEndian32(&h4);
-    _SwitchEndian32(&h5);
-    _SwitchEndian32(&h6);
-    _SwitchEndian32(&h7);
+// clang-format off
+static const uint64_t _SHA512K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+// clang-format on
 
-    uint8_t* hash = CUtilsMalloc(32);
-    memcpy(hash + 0, &h0, 4);
-    memcpy(hash + 4, &h1, 4);
-    memcpy(hash + 8, &h2, 4);
-    memcpy(hash + 12, &h3, 4);
-    memcpy(hash + 16, &h4, 4);
-    memcpy(hash + 20, &h5, 4);
-    memcpy(hash + 24, &h6, 4);
-    memcpy(hash + 28, &h7, 4);
+static inline uint64_t _RRot64(uint64_t x, uint32_t c) {
+    return (x >> c) | (x << (64 - c));
+}
+
+static inline uint64_t _Load64BE(const uint8_t* p) {
+    return ((uint64_t)_Load32BE(p) << 32) | _Load32BE(p + 4);
+}
+
+// One round. Instead of shifting eight variables the callers rotate
+// their roles, so each round only writes d and h.
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, i)                                         \
+    {                                                                                   \
+        uint64_t t1 = h + (_RRot64(e, 14) ^ _RRot64(e, 18) ^ _RRot64(e, 41)) +          \
+                      ((e & f) ^ (~e & g)) + _SHA512K[i] + w[(i)&15];                   \
+        uint64_t t2 = (_RRot64(a, 28) ^ _RRot64(a, 34) ^ _RRot64(a, 39)) +              \
+                      ((a & b) ^ (a & c) ^ (b & c));                                    \
+        d += t1;                                                                        \
+        h = t1 + t2;                                                                    \
+    }
+
+// Message schedule is kept in a 16 word ring.
+#define SHA512_SCHEDULE(i)                                                                  \
+    {                                                                                       \
+        uint64_t w15 = w[((i)-15) & 15];                                                    \
+        uint64_t w2 = w[((i)-2) & 15];                                                      \
+        uint64_t s0 = _RRot64(w15, 1) ^ _RRot64(w15, 8) ^ (w15 >> 7);                       \
+        uint64_t s1 = _RRot64(w2, 19) ^ _RRot64(w2, 61) ^ (w2 >> 6);                        \
+        w[(i)&15] += s0 + w[((i)-7) & 15] + s1;                                             \
+    }
+
+static void _SHA512Blocks(void* statePtr, const uint8_t* data, size_t blockCount) {
+    uint64_t* state = statePtr;
+    for (size_t n = 0; n < blockCount; n++, data += 128) {
+        uint64_t w[16];
+        for (int i = 0; i < 16; i++) {
+            w[i] = _Load64BE(data + i * 8);
+        }
+        uint64_t a = state[0];
+        uint64_t b = state[1];
+        uint64_t c = state[2];
+        uint64_t d = state[3];
+        uint64_t e = state[4];
+        uint64_t f = state[5];
+        uint64_t g = state[6];
+        uint64_t h = state[7];
+        for (int i = 0; i < 80; i += 8) {
+            if (i >= 16) {
+                for (int j = i; j < i + 8; j++) {
+                    SHA512_SCHEDULE(j);
+                }
+            }
+            SHA512_ROUND(a, b, c, d, e, f, g, h, i + 0);
+            SHA512_ROUND(h, a, b, c, d, e, f, g, i + 1);
+            SHA512_ROUND(g, h, a, b, c, d, e, f, i + 2);
+            SHA512_ROUND(f, g, h, a, b, c, d, e, i + 3);
+            SHA512_ROUND(e, f, g, h, a, b, c, d, i + 4);
+            SHA512_ROUND(d, e, f, g, h, a, b, c, i + 5);
+            SHA512_ROUND(c, d, e, f, g, h, a, b, i + 6);
+            SHA512_ROUND(b, c, d, e, f, g, h, a, i + 7);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#undef SHA512_ROUND
+#undef SHA512_SCHEDULE
+
+static void _SHA512Final(HashSHA512Context* context, uint8_t* outHash, int wordCount) {
+    uint64_t used = context->length % 128;
+    context->block[used++] = 0x80;
+    if (used > 112) {
+        memset(context->block + used, 0, 128 - used);
+        _SHA512Blocks(context->state, context->block, 1);
+        used = 0;
+    }
+    memset(context->block + used, 0, 112 - used);
+    // 128 bit big-endian length in bits.
+    _Store64BE(context->block + 112, context->length >> 61);
+    _Store64BE(context->block + 120, context->length << 3);
+    _SHA512Blocks(context->state, context->block, 1);
+    for (int i = 0; i < wordCount; i++) {
+        _Store64BE(outHash + i * 8, context->state[i]);
+    }
+}
+
+void HashSHA512Init(HashSHA512Context* context) {
+    context->state[0] = 0x6a09e667f3bcc908ULL;
+    context->state[1] = 0xbb67ae8584caa73bULL;
+    context->state[2] = 0x3c6ef372fe94f82bULL;
+    context->state[3] = 0xa54ff53a5f1d36f1ULL;
+    context->state[4] = 0x510e527fade682d1ULL;
+    context->state[5] = 0x9b05688c2b3e6c1fULL;
+    context->state[6] = 0x1f83d9abfb41bd6bULL;
+    context->state[7] = 0x5be0cd19137e2179ULL;
+    context->length = 0;
+}
+
+void HashSHA512Update(HashSHA512Context* context, const char* buffer, size_t bufferSize) {
+    _UpdateBlocks(context->state, context->block, 128, &context->length,
+                  (const uint8_t*)buffer, bufferSize, _SHA512Blocks);
+}
+
+void HashSHA512Final(HashSHA512Context* context, uint8_t outHash[64]) {
+    _SHA512Final(context, outHash, 8);
+}
+
+void HashSHA384Init(HashSHA384Context* context) {
+    context->state[0] = 0xcbbb9d5dc1059ed8ULL;
+    context->state[1] = 0x629a292a367cd507ULL;
+    context->state[2] = 0x9159015a3070dd17ULL;
+    context->state[3] = 0x152fecd8f70e5939ULL;
+    context->state[4] = 0x67332667ffc00b31ULL;
+    context->state[5] = 0x8eb44a8768581511ULL;
+    context->state[6] = 0xdb0c2e0d64f98fa7ULL;
+    context->state[7] = 0x47b5481dbefa4fa4ULL;
+    context->length = 0;
+}
+
+void HashSHA384Update(HashSHA384Context* context, const char* buffer, size_t bufferSize) {
+    HashSHA512Update(context, buffer, bufferSize);
+}
+
+void HashSHA384Final(HashSHA384Context* context, uint8_t outHash[48]) {
+    _SHA512Final(context, outHash, 6);
+}
 
+uint8_t* Hash_SHA2_384(const char* buffer, size_t bufferSize) {
+    HashSHA384Context context;
+    HashSHA384Init(&context);
+    HashSHA384Update(&context, buffer, bufferSize);
+    uint8_t* hash = CUtilsMalloc(48);
+    HashSHA384Final(&context, hash);
     return hash;
 }
 
 uint8_t* Hash_SHA2_512(const char* buffer, size_t bufferSize) {
-    // TODO implement
+    HashSHA512Context context;
+    HashSHA512Init(&context);
+    HashSHA512Update(&context, buffer, bufferSize);
+    uint8_t* hash = CUtilsMalloc(64);
+    HashSHA512Final(&context, hash);
+    return hash;
 }
 
 #ifdef __cplusplus
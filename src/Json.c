@@ -369,12 +369,30 @@ static _TokenInformation _GetNextToken(_JsonReadStatus* status) {
     return tokenInfo;
 }
 
-static List* _CreateListFromToken(_TokenInformation info, _JsonReadStatus* status) {
+// Nested values are parsed with the same allocator as their parent and
+// handed over without copying, the parent owns them after this call.
+static void _ListPushOwned(List* list, CUtilsDataType type, void* value) {
+    ListPush(list, -1, NULL);
+    ListNode* node = ListGetValue(list, ListGetSize(list) - 1);
+    node->dataType = type;
+    node->value = value;
+}
+
+static void _DictionarySetOwned(Dictionary* dict, char* key,
+                                CUtilsDataType type, void* value) {
+    DictionarySet(dict, key, -1, NULL);
+    DictPair* pair = DictionaryGet(dict, key);
+    pair->valueType = type;
+    pair->value = value;
+}
+
+static List* _CreateListFromToken(_TokenInformation info, _JsonReadStatus* status,
+                                  CUtilsAllocator* allocator) {
     _JsonReadStatus listStatus;
     memset(&listStatus, 0, sizeof(_JsonReadStatus));
     listStatus.jsonText = info.token;
     listStatus.level = status->level;
-    List* list = ListCreate();
+    List* list = ListCreateWithAllocator(allocator);
     _TokenInformation tokenInfo = _GetNextToken(&listStatus);
     while (tokenInfo.tokenType != -1) {
         switch (tokenInfo.tokenType) {
@@ -400,16 +418,14 @@ static List* _CreateListFromToken(_TokenInformation info, _JsonReadStatus* statu
                 StringFree(&tokenInfo.token);
                 break;
             case TOKEN_LIST: {
-                List* v = _CreateListFromToken(tokenInfo, &listStatus);
-                ListPush(list, DATA_TYPE_LIST, v);
-                ListFree(v);
+                List* v = _CreateListFromToken(tokenInfo, &listStatus, allocator);
+                _ListPushOwned(list, DATA_TYPE_LIST, v);
                 StringFree(&tokenInfo.token);
                 break;
             }
             case TOKEN_OBJECT: {
-                Dictionary* v = JsonParse(tokenInfo.token);
-                ListPush(list, DATA_TYPE_OBJECT, v);
-                DictionaryFree(v);
+                Dictionary* v = JsonParseWithAllocator(tokenInfo.token, allocator);
+                _ListPushOwned(list, DATA_TYPE_OBJECT, v);
                 StringFree(&tokenInfo.token);
                 break;
             }
@@ -420,7 +436,7 @@ static List* _CreateListFromToken(_TokenInformation info, _JsonReadStatus* statu
 }
 
 static void _SetNextDictValue(Dictionary* dict, char* key,
-                              _JsonReadStatus* status) {
+                              _JsonReadStatus* status, CUtilsAllocator* allocator) {
     _TokenInformation tokenInfo = _GetNextToken(status);
     switch (tokenInfo.tokenType) {
         case TOKEN_NULL:
@@ -446,15 +462,13 @@ static void _SetNextDictValue(Dictionary* dict, char* key,
             break;
         }
         case TOKEN_OBJECT: {
-            Dictionary* v = JsonParse(tokenInfo.token);
-            DictionarySet(dict, key, DATA_TYPE_OBJECT, v);
-            DictionaryFree(v);
+            Dictionary* v = JsonParseWithAllocator(tokenInfo.token, allocator);
+            _DictionarySetOwned(dict, key, DATA_TYPE_OBJECT, v);
             break;
         }
         case TOKEN_LIST: {
-            List* v = _CreateListFromToken(tokenInfo, status);
-            DictionarySet(dict, key, DATA_TYPE_LIST, v);
-            ListFree(v);
+            List* v = _CreateListFromToken(tokenInfo, status, allocator);
+            _DictionarySetOwned(dict, key, DATA_TYPE_LIST, v);
             break;
         }
     }
@@ -462,7 +476,11 @@ static void _SetNextDictValue(Dictionary* dict, char* key,
 }
 
 Dictionary* JsonParse(String jsonString) {
-    Dictionary* dict = DictionaryCreate();
+    return JsonParseWithAllocator(jsonString, NULL);
+}
+
+Dictionary* JsonParseWithAllocator(String jsonString, CUtilsAllocator* allocator) {
+    Dictionary* dict = DictionaryCreateWithAllocator(allocator);
     jsonString.length = strlen(jsonString.c_str);
     _JsonReadStatus status;
     memset(&status, 0, sizeof(_JsonReadStatus));
@@ -471,7 +489,7 @@ Dictionary* JsonParse(String jsonString) {
         _TokenInformation keyInfo = _GetNextToken(&status);
         if (keyInfo.tokenType == TOKEN_STRING &&
             keyInfo.token.c_str != NULL) {
-            _SetNextDictValue(dict, keyInfo.token.c_str, &status);
+            _SetNextDictValue(dict, keyInfo.token.c_str, &status, allocator);
             StringFree(&keyInfo.token);
         } else {
             break;
@@ -1,85 +1,1402 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// mremap
+#define _GNU_SOURCE
+#endif
+
 #include "MemoryUtils.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "CpuInfo.h"
 #include "Debug.h"
-#include "containers/HashMap.h"
-#include "containers/UniqueArray.h"
+#include "containers/Dictionary.h"
+#include "containers/List.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#define _MallocUsableSize(buf) _msize(buf)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define _MallocUsableSize(buf) malloc_size(buf)
+#else
+#include <malloc.h>
+#define _MallocUsableSize(buf) malloc_usable_size(buf)
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define MEMORY_LARGE_BLOCKS
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MEMORY_X86
+#endif
+
+#if defined(_MSC_VER)
+#define _THREAD_LOCAL __declspec(thread)
+#else
+#define _THREAD_LOCAL _Thread_local
+#endif
+
+#if defined(__GNUC__)
+#define _UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define _UNLIKELY(x) (x)
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-bool MemoryEquals(const void* buf1, const void* buf2, size_t size) {
-    const char* b1 = buf1;
-    const char* b2 = buf2;
-    for (uint64_t i = 0; i < size; i++) {
-        if (*b1++ != *b2++) {
+// PRIVATE BEGIN
+#define _WORD_ONES 0x0101010101010101ull
+#define _WORD_LOWS 0x7f7f7f7f7f7f7f7full
+
+static inline uint64_t _LoadWord(const uint8_t* p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline void _StoreWord(uint8_t* p, uint64_t w) {
+    memcpy(p, &w, sizeof(w));
+}
+
+// Returns 0x80 in every byte of the word which is zero, 0 in the others.
+static inline uint64_t _ZeroBytes(uint64_t w) {
+    return ~(((w & _WORD_LOWS) + _WORD_LOWS) | w | _WORD_LOWS);
+}
+
+static inline uint64_t _ByteSwap64(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_bswap64(w);
+#else
+    w = ((w & 0x00ff00ff00ff00ffull) << 8) | ((w >> 8) & 0x00ff00ff00ff00ffull);
+    w = ((w & 0x0000ffff0000ffffull) << 16) | ((w >> 16) & 0x0000ffff0000ffffull);
+    return (w << 32) | (w >> 32);
+#endif
+}
+
+static bool _EqualsPortable(const uint8_t* b1, const uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        if (_LoadWord(b1 + i) != _LoadWord(b2 + i)) {
+            return false;
+        }
+    }
+    for (; i < size; i++) {
+        if (b1[i] != b2[i]) {
             return false;
         }
     }
     return true;
 }
 
-bool MemoryIsNull(const void* buf, size_t size) {
-    const char* b = buf;
-    for (uint64_t i = 0; i < size; i++) {
-        if (*b++ != 0) {
+static bool _IsNullPortable(const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        if ((_LoadWord(b + i) | _LoadWord(b + i + 8) |
+             _LoadWord(b + i + 16) | _LoadWord(b + i + 24)) != 0) {
+            return false;
+        }
+    }
+    for (; i + 8 <= size; i += 8) {
+        if (_LoadWord(b + i) != 0) {
+            return false;
+        }
+    }
+    for (; i < size; i++) {
+        if (b[i] != 0) {
             return false;
         }
     }
     return true;
 }
 
+static void _SwapPortable(uint8_t* b1, uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w = _LoadWord(b1 + i);
+        _StoreWord(b1 + i, _LoadWord(b2 + i));
+        _StoreWord(b2 + i, w);
+    }
+    for (; i < size; i++) {
+        uint8_t c = b1[i];
+        b1[i] = b2[i];
+        b2[i] = c;
+    }
+}
+
+static const uint8_t* _FindBytePortable(const uint8_t* b, size_t size, uint8_t byte) {
+    uint64_t pattern = _WORD_ONES * byte;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        if (_ZeroBytes(_LoadWord(b + i) ^ pattern) != 0) {
+            break;
+        }
+    }
+    for (; i < size; i++) {
+        if (b[i] == byte) {
+            return b + i;
+        }
+    }
+    return NULL;
+}
+
+static size_t _CountBytePortable(const uint8_t* b, size_t size, uint8_t byte) {
+    uint64_t pattern = _WORD_ONES * byte;
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        // Moves the flags to the low bits and sums the bytes in the top one.
+        count += ((_ZeroBytes(_LoadWord(b + i) ^ pattern) >> 7) * _WORD_ONES) >> 56;
+    }
+    for (; i < size; i++) {
+        count += b[i] == byte;
+    }
+    return count;
+}
+
+static void _ReversePortable(uint8_t* b, size_t size) {
+    size_t lo = 0;
+    size_t hi = size;
+    for (; hi - lo >= 16; lo += 8, hi -= 8) {
+        uint64_t w = _LoadWord(b + lo);
+        _StoreWord(b + lo, _ByteSwap64(_LoadWord(b + hi - 8)));
+        _StoreWord(b + hi - 8, _ByteSwap64(w));
+    }
+    for (; hi - lo >= 2; lo++, hi--) {
+        uint8_t c = b[lo];
+        b[lo] = b[hi - 1];
+        b[hi - 1] = c;
+    }
+}
+
+#ifdef MEMORY_X86
+// Vector loops leave the last partial vector to the portable versions.
+__attribute__((target("sse2"))) static bool _EqualsSSE2(const uint8_t* b1, const uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(b1 + i));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(b2 + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v1, v2)) != 0xffff) {
+            return false;
+        }
+    }
+    return _EqualsPortable(b1 + i, b2 + i, size - i);
+}
+
+__attribute__((target("sse2"))) static bool _IsNullSSE2(const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128i v = _mm_or_si128(
+            _mm_or_si128(_mm_loadu_si128((const __m128i*)(b + i)),
+                         _mm_loadu_si128((const __m128i*)(b + i + 16))),
+            _mm_or_si128(_mm_loadu_si128((const __m128i*)(b + i + 32)),
+                         _mm_loadu_si128((const __m128i*)(b + i + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xffff) {
+            return false;
+        }
+    }
+    return _IsNullPortable(b + i, size - i);
+}
+
+__attribute__((target("sse2"))) static void _SwapSSE2(uint8_t* b1, uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(b1 + i));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(b2 + i));
+        _mm_storeu_si128((__m128i*)(b1 + i), v2);
+        _mm_storeu_si128((__m128i*)(b2 + i), v1);
+    }
+    _SwapPortable(b1 + i, b2 + i, size - i);
+}
+
+__attribute__((target("sse2"))) static const uint8_t* _FindByteSSE2(const uint8_t* b, size_t size, uint8_t byte) {
+    __m128i pattern = _mm_set1_epi8((char)byte);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(b + i)), pattern));
+        if (mask != 0) {
+            return b + i + __builtin_ctz(mask);
+        }
+    }
+    return _FindBytePortable(b + i, size - i, byte);
+}
+
+__attribute__((target("sse2"))) static size_t _CountByteSSE2(const uint8_t* b, size_t size, uint8_t byte) {
+    __m128i pattern = _mm_set1_epi8((char)byte);
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 16 <= size) {
+        // Matches are -1, subtracting them counts up to 255 per byte lane.
+        __m128i acc = _mm_setzero_si128();
+        for (int n = 0; n < 255 && i + 16 <= size; n++, i += 16) {
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(b + i)), pattern));
+        }
+        __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+        count += (size_t)_mm_cvtsi128_si32(sum) + (size_t)_mm_extract_epi16(sum, 4);
+    }
+    return count + _CountBytePortable(b + i, size - i, byte);
+}
+
+__attribute__((target("sse2"))) static inline __m128i _Reverse128(__m128i v) {
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+__attribute__((target("sse2"))) static void _ReverseSSE2(uint8_t* b, size_t size) {
+    size_t lo = 0;
+    size_t hi = size;
+    for (; hi - lo >= 32; lo += 16, hi -= 16) {
+        __m128i front = _mm_loadu_si128((const __m128i*)(b + lo));
+        __m128i back = _mm_loadu_si128((const __m128i*)(b + hi - 16));
+        _mm_storeu_si128((__m128i*)(b + lo), _Reverse128(back));
+        _mm_storeu_si128((__m128i*)(b + hi - 16), _Reverse128(front));
+    }
+    _ReversePortable(b + lo, hi - lo);
+}
+
+// GCC doesn't clear the upper halves before a tail call, the SSE code of
+// the tails would pay for the AVX to SSE transition on every instruction.
+__attribute__((target("avx2"))) static bool _EqualsAVX2(const uint8_t* b1, const uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(b1 + i));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(b2 + i));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, v2)) != 0xffffffffu) {
+            return false;
+        }
+    }
+    _mm256_zeroupper();
+    return _EqualsSSE2(b1 + i, b2 + i, size - i);
+}
+
+__attribute__((target("avx2"))) static bool _IsNullAVX2(const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 128 <= size; i += 128) {
+        __m256i v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(b + i)),
+                            _mm256_loadu_si256((const __m256i*)(b + i + 32))),
+            _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(b + i + 64)),
+                            _mm256_loadu_si256((const __m256i*)(b + i + 96))));
+        if (!_mm256_testz_si256(v, v)) {
+            return false;
+        }
+    }
+    _mm256_zeroupper();
+    return _IsNullSSE2(b + i, size - i);
+}
+
+__attribute__((target("avx2"))) static void _SwapAVX2(uint8_t* b1, uint8_t* b2, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(b1 + i));
+        __m256i v2 = _mm256_loadu_si256((const __m256i*)(b2 + i));
+        _mm256_storeu_si256((__m256i*)(b1 + i), v2);
+        _mm256_storeu_si256((__m256i*)(b2 + i), v1);
+    }
+    _mm256_zeroupper();
+    _SwapSSE2(b1 + i, b2 + i, size - i);
+}
+
+__attribute__((target("avx2"))) static const uint8_t* _FindByteAVX2(const uint8_t* b, size_t size, uint8_t byte) {
+    __m256i pattern = _mm256_set1_epi8((char)byte);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(b + i)), pattern));
+        if (mask != 0) {
+            return b + i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return _FindByteSSE2(b + i, size - i, byte);
+}
+
+__attribute__((target("avx2"))) static size_t _CountByteAVX2(const uint8_t* b, size_t size, uint8_t byte) {
+    __m256i pattern = _mm256_set1_epi8((char)byte);
+    size_t count = 0;
+    size_t i = 0;
+    while (i + 32 <= size) {
+        __m256i acc = _mm256_setzero_si256();
+        for (int n = 0; n < 255 && i + 32 <= size; n++, i += 32) {
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(b + i)), pattern));
+        }
+        __m256i sum = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+        count += (size_t)_mm256_extract_epi64(sum, 0) + (size_t)_mm256_extract_epi64(sum, 1) +
+                 (size_t)_mm256_extract_epi64(sum, 2) + (size_t)_mm256_extract_epi64(sum, 3);
+    }
+    _mm256_zeroupper();
+    return count + _CountByteSSE2(b + i, size - i, byte);
+}
+
+__attribute__((target("avx2"))) static inline __m256i _Reverse256(__m256i v) {
+    const __m256i mask = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                          15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_permute2x128_si256(_mm256_shuffle_epi8(v, mask), v, 0x01);
+}
+
+__attribute__((target("avx2"))) static void _ReverseAVX2(uint8_t* b, size_t size) {
+    size_t lo = 0;
+    size_t hi = size;
+    for (; hi - lo >= 64; lo += 32, hi -= 32) {
+        __m256i front = _mm256_loadu_si256((const __m256i*)(b + lo));
+        __m256i back = _mm256_loadu_si256((const __m256i*)(b + hi - 32));
+        _mm256_storeu_si256((__m256i*)(b + lo), _Reverse256(back));
+        _mm256_storeu_si256((__m256i*)(b + hi - 32), _Reverse256(front));
+    }
+    _mm256_zeroupper();
+    _ReverseSSE2(b + lo, hi - lo);
+}
+#endif
+
+typedef struct _MemoryFuncs {
+    bool (*equals)(const uint8_t* b1, const uint8_t* b2, size_t size);
+    bool (*isNull)(const uint8_t* b, size_t size);
+    void (*swap)(uint8_t* b1, uint8_t* b2, size_t size);
+    const uint8_t* (*findByte)(const uint8_t* b, size_t size, uint8_t byte);
+    size_t (*countByte)(const uint8_t* b, size_t size, uint8_t byte);
+    void (*reverse)(uint8_t* b, size_t size);
+} _MemoryFuncs;
+
+static const _MemoryFuncs _PortableFuncs = {
+    _EqualsPortable, _IsNullPortable, _SwapPortable,
+    _FindBytePortable, _CountBytePortable, _ReversePortable};
+#ifdef MEMORY_X86
+static const _MemoryFuncs _SSE2Funcs = {
+    _EqualsSSE2, _IsNullSSE2, _SwapSSE2,
+    _FindByteSSE2, _CountByteSSE2, _ReverseSSE2};
+static const _MemoryFuncs _AVX2Funcs = {
+    _EqualsAVX2, _IsNullAVX2, _SwapAVX2,
+    _FindByteAVX2, _CountByteAVX2, _ReverseAVX2};
+#endif
+
+static const _MemoryFuncs* _Atomic _Funcs = NULL;
+static _Atomic(MemoryBackend) _Backend = MEMORY_BACKEND_PORTABLE;
+static pthread_once_t _BackendOnce = PTHREAD_ONCE_INIT;
+
+static const _MemoryFuncs* _BackendFuncs(MemoryBackend backend) {
+    const CpuInfo* cpu = CpuInfoGet();
+    switch (backend) {
+        case MEMORY_BACKEND_PORTABLE:
+            return &_PortableFuncs;
+        case MEMORY_BACKEND_SSE2:
+#ifdef MEMORY_X86
+            if (cpu->sse2) {
+                return &_SSE2Funcs;
+            }
+#endif
+            return NULL;
+        case MEMORY_BACKEND_AVX2:
+#ifdef MEMORY_X86
+            if (cpu->avx2) {
+                return &_AVX2Funcs;
+            }
+#endif
+            return NULL;
+        default:
+            return NULL;
+    }
+}
+
+static bool _StoreBackend(MemoryBackend backend) {
+    const _MemoryFuncs* funcs = _BackendFuncs(backend);
+    if (funcs == NULL) {
+        return false;
+    }
+    atomic_store(&_Backend, backend);
+    atomic_store_explicit(&_Funcs, funcs, memory_order_release);
+    return true;
+}
+
+// Picks the fastest supported backend.
+static void _InitBackend(void) {
+    if (!_StoreBackend(MEMORY_BACKEND_AVX2) &&
+        !_StoreBackend(MEMORY_BACKEND_SSE2)) {
+        _StoreBackend(MEMORY_BACKEND_PORTABLE);
+    }
+}
+
+// Once the table is set the hot path is a single load.
+static inline const _MemoryFuncs* _Dispatch(void) {
+    const _MemoryFuncs* funcs = atomic_load_explicit(&_Funcs, memory_order_acquire);
+    if (_UNLIKELY(funcs == NULL)) {
+        pthread_once(&_BackendOnce, _InitBackend);
+        funcs = atomic_load_explicit(&_Funcs, memory_order_acquire);
+    }
+    return funcs;
+}
+// PRIVATE END
+
+bool MemoryEquals(const void* buf1, const void* buf2, size_t size) {
+    return _Dispatch()->equals(buf1, buf2, size);
+}
+
+bool MemoryIsNull(const void* buf, size_t size) {
+    return _Dispatch()->isNull(buf, size);
+}
+
 void MemorySwap(void* buf1, void* buf2, size_t size) {
-    char* b1 = buf1;
-    char* b2 = buf2;
-    for (size_t i = 0; i < size; i++) {
-        *b1 = *b1 + *b2;
-        *b2 = *b1 - *b2;
-        *b1 = *b1 - *b2;
-        b1++;
-        b2++;
+    if (buf1 != buf2) {
+        _Dispatch()->swap(buf1, buf2, size);
+    }
+}
+
+void* MemoryFindByte(const void* buf, size_t size, uint8_t byte) {
+    return (void*)_Dispatch()->findByte(buf, size, byte);
+}
+
+size_t MemoryCountByte(const void* buf, size_t size, uint8_t byte) {
+    return _Dispatch()->countByte(buf, size, byte);
+}
+
+void MemoryReverse(void* buf, size_t size) {
+    _Dispatch()->reverse(buf, size);
+}
+
+bool MemorySetBackend(MemoryBackend backend) {
+    // Resolve the default first, so it never overwrites this choice.
+    pthread_once(&_BackendOnce, _InitBackend);
+    return _StoreBackend(backend);
+}
+
+MemoryBackend MemoryGetBackend(void) {
+    _Dispatch();
+    return atomic_load(&_Backend);
+}
+
+// LARGE BLOCKS
+#define LARGE_BLOCK_ALIGNMENT ((size_t)2 * 1024 * 1024)
+#define LARGE_BLOCK_MAX_COUNT 256
+
+#ifdef MEMORY_LARGE_BLOCKS
+static atomic_size_t _LargeThreshold = CUTILS_LARGE_BLOCK_DEFAULT_THRESHOLD;
+
+typedef struct _LargeBlock {
+    char* base;
+    size_t length;
+} _LargeBlock;
+
+// Mapped blocks start at 2 MB boundaries. Malloc practically never returns
+// such an address, so only those pointers are looked up in the table.
+static struct {
+    atomic_flag lock;
+    size_t count;
+    _LargeBlock blocks[LARGE_BLOCK_MAX_COUNT];
+} _LargeBlocks = {
+    .lock = ATOMIC_FLAG_INIT,
+    .count = 0,
+    .blocks = {{NULL, 0}},
+};
+
+static inline void _LargeLock(void) {
+    while (atomic_flag_test_and_set_explicit(&_LargeBlocks.lock, memory_order_acquire)) {
+    }
+}
+
+static inline void _LargeUnlock(void) {
+    atomic_flag_clear_explicit(&_LargeBlocks.lock, memory_order_release);
+}
+
+static inline size_t _LargeLength(size_t size) {
+    return (size + LARGE_BLOCK_ALIGNMENT - 1) & ~(LARGE_BLOCK_ALIGNMENT - 1);
+}
+
+static inline bool _LargeWanted(size_t size) {
+    size_t threshold = atomic_load_explicit(&_LargeThreshold, memory_order_relaxed);
+    return threshold > 0 && size >= threshold;
+}
+
+// Returns the mapped length of the block, 0 if it is not a large block.
+static size_t _LargeSize(const void* buf) {
+    if (buf == NULL || ((uintptr_t)buf & (LARGE_BLOCK_ALIGNMENT - 1)) != 0) {
+        return 0;
+    }
+    size_t length = 0;
+    _LargeLock();
+    for (size_t i = 0; i < _LargeBlocks.count; i++) {
+        if (_LargeBlocks.blocks[i].base == buf) {
+            length = _LargeBlocks.blocks[i].length;
+            break;
+        }
+    }
+    _LargeUnlock();
+    return length;
+}
+
+// Replaces the entry of old base, adds a new one if old base is NULL and
+// removes it if new base is NULL. Returns false if the table is full.
+static bool _LargeUpdate(const char* oldBase, char* newBase, size_t newLength) {
+    bool found = false;
+    _LargeLock();
+    for (size_t i = 0; i < _LargeBlocks.count; i++) {
+        if (_LargeBlocks.blocks[i].base == oldBase) {
+            if (newBase) {
+                _LargeBlocks.blocks[i].base = newBase;
+                _LargeBlocks.blocks[i].length = newLength;
+            } else {
+                _LargeBlocks.blocks[i] = _LargeBlocks.blocks[--_LargeBlocks.count];
+            }
+            found = true;
+            break;
+        }
+    }
+    if (!found && newBase && _LargeBlocks.count < LARGE_BLOCK_MAX_COUNT) {
+        _LargeBlocks.blocks[_LargeBlocks.count].base = newBase;
+        _LargeBlocks.blocks[_LargeBlocks.count].length = newLength;
+        _LargeBlocks.count++;
+        found = true;
+    }
+    _LargeUnlock();
+    return found;
+}
+
+// Maps length bytes at a 2 MB boundary by trimming a bigger mapping.
+static char* _LargeMapAligned(size_t length) {
+    size_t mapped = length + LARGE_BLOCK_ALIGNMENT;
+    char* p = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    char* base = (char*)(((uintptr_t)p + LARGE_BLOCK_ALIGNMENT - 1) & ~(LARGE_BLOCK_ALIGNMENT - 1));
+    if (base > p) {
+        munmap(p, base - p);
+    }
+    if (p + mapped > base + length) {
+        munmap(base + length, p + mapped - (base + length));
+    }
+    return base;
+}
+
+// Returns NULL if the block should come from malloc instead.
+static void* _LargeAlloc(size_t size) {
+    if (!_LargeWanted(size)) {
+        return NULL;
+    }
+    size_t length = _LargeLength(size);
+    char* base = _LargeMapAligned(length);
+    if (base == NULL) {
+        return NULL;
+    }
+    madvise(base, length, MADV_HUGEPAGE);
+    if (!_LargeUpdate(NULL, base, length)) {
+        munmap(base, length);
+        return NULL;
+    }
+    return base;
+}
+
+static void _LargeFree(void* buf, size_t length) {
+    _LargeUpdate(buf, NULL, 0);
+    munmap(buf, length);
+}
+
+// Grows or shrinks a mapped block by moving its pages, nothing is copied.
+static void* _LargeRealloc(char* buf, size_t length, size_t newSize) {
+    size_t newLength = _LargeLength(newSize);
+    if (newLength == length) {
+        return buf;
+    }
+    char* p = mremap(buf, length, newLength, 0);
+    if (p == MAP_FAILED) {
+        // Can't grow in place, move the pages to a new aligned range.
+        char* target = _LargeMapAligned(newLength);
+        if (target == NULL) {
+            return NULL;
+        }
+        p = mremap(buf, length, newLength, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+        if (p == MAP_FAILED) {
+            munmap(target, newLength);
+            return NULL;
+        }
+    }
+    if (newLength > length) {
+        madvise(p + length, newLength - length, MADV_HUGEPAGE);
+    }
+    _LargeUpdate(buf, p, newLength);
+    return p;
+}
+#else
+static inline bool _LargeWanted(size_t size) {
+    return false;
+}
+
+static inline size_t _LargeSize(const void* buf) {
+    return 0;
+}
+
+static inline void* _LargeAlloc(size_t size) {
+    return NULL;
+}
+
+static inline void _LargeFree(void* buf, size_t length) {
+}
+
+static inline void* _LargeRealloc(char* buf, size_t length, size_t newSize) {
+    return NULL;
+}
+#endif
+
+static inline size_t _HeapUsableSize(void* buf) {
+    size_t length = _LargeSize(buf);
+    return length ? length : _MallocUsableSize(buf);
+}
+
+// ALLOCATOR
+static void* _HeapAlloc(void* userData, size_t size) {
+    (void)userData;
+    void* buf = _LargeAlloc(size);
+    return buf ? buf : malloc(size);
+}
+
+static void* _HeapRealloc(void* userData, void* buf, size_t newSize) {
+    (void)userData;
+    size_t length = _LargeSize(buf);
+    if (length == 0) {
+        void* large = _LargeAlloc(newSize);
+        if (large == NULL) {
+            return realloc(buf, newSize);
+        }
+        // Crossed the threshold, copy once, mremap from now on.
+        if (buf) {
+            size_t oldSize = _MallocUsableSize(buf);
+            memcpy(large, buf, oldSize < newSize ? oldSize : newSize);
+            free(buf);
+        }
+        return large;
+    }
+    if (_LargeWanted(newSize)) {
+        return _LargeRealloc(buf, length, newSize);
+    }
+    void* small = malloc(newSize);
+    if (small) {
+        memcpy(small, buf, newSize < length ? newSize : length);
+        _LargeFree(buf, length);
+    }
+    return small;
+}
+
+static void _HeapFree(void* userData, void* buf) {
+    (void)userData;
+    size_t length = _LargeSize(buf);
+    if (length) {
+        _LargeFree(buf, length);
+    } else {
+        free(buf);
+    }
+}
+
+// Mapped pages are zero already.
+static void* _HeapAllocZeroed(void* userData, size_t size) {
+    (void)userData;
+    void* buf = _LargeAlloc(size);
+    return buf ? buf : calloc(1, size);
+}
+
+static CUtilsAllocator _HeapAllocator = {_HeapAlloc, _HeapRealloc, _HeapFree, NULL, _HeapAllocZeroed};
+static CUtilsAllocator* _DefaultAllocator = &_HeapAllocator;
+
+// PROFILER
+#define PROFILER_SITE_COUNT 1024
+
+typedef struct _ProfilerSite {
+    const char* file;
+    int line;
+    uint64_t count;
+    uint64_t bytes;
+} _ProfilerSite;
+
+static atomic_bool _ProfilerEnabled;
+
+// Counters are updated with relaxed atomics, call sites under a spinlock.
+static struct {
+    atomic_uint_fast64_t mallocCount;
+    atomic_uint_fast64_t reallocCount;
+    atomic_uint_fast64_t freeCount;
+    atomic_int_fast64_t liveBytes;
+    atomic_int_fast64_t peakBytes;
+    atomic_uint_fast64_t totalBytes;
+    atomic_uint_fast64_t histogram[CUTILS_PROFILER_HISTOGRAM_SIZE];
+    atomic_flag siteLock;
+    _ProfilerSite sites[PROFILER_SITE_COUNT];
+    // Allocations of the call sites which don't fit into the table.
+    _ProfilerSite otherSites;
+} _Profiler = {.siteLock = ATOMIC_FLAG_INIT};
+
+static inline uint32_t _HistogramBucket(size_t size) {
+    uint32_t bucket = 0;
+    while (bucket < CUTILS_PROFILER_HISTOGRAM_SIZE - 1 && ((size_t)1 << bucket) < size) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void _ProfilerAddLive(int64_t bytes) {
+    int64_t live = atomic_fetch_add_explicit(&_Profiler.liveBytes, bytes,
+                                             memory_order_relaxed) + bytes;
+    int64_t peak = atomic_load_explicit(&_Profiler.peakBytes, memory_order_relaxed);
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&_Profiler.peakBytes, &peak, live,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void _ProfilerAddSite(const char* file, int line, size_t size) {
+    uint64_t hash = ((uint64_t)(uintptr_t)file ^ (uint64_t)line) * 0x9E3779B97F4A7C15ull;
+    uint64_t index = hash >> 54;  // 10 bits, PROFILER_SITE_COUNT
+    _ProfilerSite* site = &_Profiler.otherSites;
+    while (atomic_flag_test_and_set_explicit(&_Profiler.siteLock, memory_order_acquire)) {
+    }
+    for (uint64_t i = 0; i < PROFILER_SITE_COUNT; i++) {
+        _ProfilerSite* s = &_Profiler.sites[(index + i) & (PROFILER_SITE_COUNT - 1)];
+        if (s->file == NULL) {
+            s->file = file;
+            s->line = line;
+        }
+        if (s->file == file && s->line == line) {
+            site = s;
+            break;
+        }
+    }
+    site->count++;
+    site->bytes += size;
+    atomic_flag_clear_explicit(&_Profiler.siteLock, memory_order_release);
+}
+
+static void _ProfilerOnAlloc(void* buf, size_t size, const char* file, int line) {
+    atomic_fetch_add_explicit(&_Profiler.mallocCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_Profiler.totalBytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_Profiler.histogram[_HistogramBucket(size)], 1, memory_order_relaxed);
+    _ProfilerAddLive((int64_t)_HeapUsableSize(buf));
+    _ProfilerAddSite(file, line, size);
+}
+
+static void _ProfilerOnFree(size_t usableSize) {
+    atomic_fetch_add_explicit(&_Profiler.freeCount, 1, memory_order_relaxed);
+    _ProfilerAddLive(-(int64_t)usableSize);
+}
+
+void CUtilsProfilerEnable(bool enable) {
+    atomic_store(&_ProfilerEnabled, enable);
+}
+
+bool CUtilsProfilerIsEnabled(void) {
+    return atomic_load(&_ProfilerEnabled);
+}
+
+void CUtilsProfilerReset(void) {
+    atomic_store(&_Profiler.mallocCount, 0);
+    atomic_store(&_Profiler.reallocCount, 0);
+    atomic_store(&_Profiler.freeCount, 0);
+    atomic_store(&_Profiler.liveBytes, 0);
+    atomic_store(&_Profiler.peakBytes, 0);
+    atomic_store(&_Profiler.totalBytes, 0);
+    for (uint32_t i = 0; i < CUTILS_PROFILER_HISTOGRAM_SIZE; i++) {
+        atomic_store(&_Profiler.histogram[i], 0);
+    }
+    while (atomic_flag_test_and_set_explicit(&_Profiler.siteLock, memory_order_acquire)) {
+    }
+    memset(_Profiler.sites, 0, sizeof(_Profiler.sites));
+    memset(&_Profiler.otherSites, 0, sizeof(_Profiler.otherSites));
+    atomic_flag_clear_explicit(&_Profiler.siteLock, memory_order_release);
+}
+
+void CUtilsProfilerGetStats(CUtilsProfilerStats* outStats) {
+    outStats->mallocCount = atomic_load(&_Profiler.mallocCount);
+    outStats->reallocCount = atomic_load(&_Profiler.reallocCount);
+    outStats->freeCount = atomic_load(&_Profiler.freeCount);
+    outStats->liveBytes = atomic_load(&_Profiler.liveBytes);
+    outStats->peakBytes = atomic_load(&_Profiler.peakBytes);
+    outStats->totalBytes = atomic_load(&_Profiler.totalBytes);
+    for (uint32_t i = 0; i < CUTILS_PROFILER_HISTOGRAM_SIZE; i++) {
+        outStats->histogram[i] = atomic_load(&_Profiler.histogram[i]);
+    }
+}
+
+static int _CompareSites(const void* v1, const void* v2) {
+    const _ProfilerSite* s1 = v1;
+    const _ProfilerSite* s2 = v2;
+    if (s1->count != s2->count) {
+        return s1->count < s2->count ? 1 : -1;
+    }
+    return 0;
+}
+
+static void _ReportAddSite(List* list, const _ProfilerSite* site) {
+    Dictionary* dict = DictionaryCreate();
+    DictionarySetString(dict, "file", (char*)site->file);
+    DictionarySetNumber(dict, "line", site->line);
+    DictionarySetNumber(dict, "count", site->count);
+    DictionarySetNumber(dict, "bytes", site->bytes);
+    ListPush(list, DATA_TYPE_OBJECT, dict);
+    DictionaryFree(dict);
+}
+
+struct Dictionary* CUtilsProfilerCreateReport(void) {
+    CUtilsProfilerStats stats;
+    CUtilsProfilerGetStats(&stats);
+    // Copy the sites first, building the report allocates.
+    _ProfilerSite* sites = CUtilsMalloc(sizeof(_Profiler.sites));
+    _ProfilerSite otherSites;
+    uint64_t siteCount = 0;
+    while (atomic_flag_test_and_set_explicit(&_Profiler.siteLock, memory_order_acquire)) {
+    }
+    for (uint64_t i = 0; i < PROFILER_SITE_COUNT; i++) {
+        if (_Profiler.sites[i].file) {
+            sites[siteCount++] = _Profiler.sites[i];
+        }
+    }
+    otherSites = _Profiler.otherSites;
+    atomic_flag_clear_explicit(&_Profiler.siteLock, memory_order_release);
+    qsort(sites, siteCount, sizeof(_ProfilerSite), _CompareSites);
+
+    Dictionary* report = DictionaryCreate();
+    DictionarySetNumber(report, "mallocCount", stats.mallocCount);
+    DictionarySetNumber(report, "reallocCount", stats.reallocCount);
+    DictionarySetNumber(report, "freeCount", stats.freeCount);
+    DictionarySetNumber(report, "liveBytes", stats.liveBytes);
+    DictionarySetNumber(report, "peakBytes", stats.peakBytes);
+    DictionarySetNumber(report, "totalBytes", stats.totalBytes);
+    List* histogram = ListCreate();
+    for (uint32_t i = 0; i < CUTILS_PROFILER_HISTOGRAM_SIZE; i++) {
+        ListPushNumber(histogram, stats.histogram[i]);
+    }
+    DictionarySet(report, "histogram", DATA_TYPE_LIST, histogram);
+    ListFree(histogram);
+    List* siteList = ListCreate();
+    for (uint64_t i = 0; i < siteCount; i++) {
+        _ReportAddSite(siteList, &sites[i]);
     }
+    if (otherSites.count > 0) {
+        otherSites.file = "other";
+        _ReportAddSite(siteList, &otherSites);
+    }
+    DictionarySet(report, "sites", DATA_TYPE_LIST, siteList);
+    ListFree(siteList);
+    CUtilsFree(sites);
+    return report;
+}
+
+CUtilsAllocator* CUtilsGetHeapAllocator(void) {
+    return &_HeapAllocator;
 }
 
-#ifdef CUTILS_TESTS_ENABLED
-uint64_t c_utils_total_malloc = 0;
-uint64_t c_utils_total_free = 0;
-uint64_t c_utils_total_realloc = 0;
+void CUtilsSetDefaultAllocator(CUtilsAllocator* allocator) {
+    _DefaultAllocator = allocator ? allocator : &_HeapAllocator;
+}
+
+CUtilsAllocator* CUtilsGetDefaultAllocator(void) {
+    return _DefaultAllocator;
+}
+
+bool CUtilsSetLargeBlockThreshold(size_t threshold) {
+#ifdef MEMORY_LARGE_BLOCKS
+    if (threshold > 0 && threshold < LARGE_BLOCK_ALIGNMENT) {
+        threshold = LARGE_BLOCK_ALIGNMENT;
+    }
+    atomic_store_explicit(&_LargeThreshold, threshold, memory_order_relaxed);
+    return true;
+#else
+    return threshold == 0;
 #endif
+}
 
-void* CUtilsMalloc(size_t size) {
-    void* buf = malloc(size);
-#ifdef CUTILS_TESTS_ENABLED
-    c_utils_total_malloc++;
+size_t CUtilsGetLargeBlockThreshold(void) {
+#ifdef MEMORY_LARGE_BLOCKS
+    return atomic_load_explicit(&_LargeThreshold, memory_order_relaxed);
+#else
+    return 0;
 #endif
-    memset(buf, 0, size);
+}
+
+// Every allocation of the library ends here.
+static void* _AllocAt(CUtilsAllocator* allocator, size_t size, bool zeroed,
+                      const char* file, int line) {
+    if (allocator == NULL) {
+        allocator = _DefaultAllocator;
+    }
+    void* buf;
+    if (zeroed && allocator->allocZeroed) {
+        buf = allocator->allocZeroed(allocator->userData, size);
+    } else {
+        buf = allocator->alloc(allocator->userData, size);
+        if (zeroed && buf) {
+            memset(buf, 0, size);
+        }
+    }
+    if (buf == NULL) {
+        DEBUG_LOG_ERROR("CUtilsMalloc: Memory allocation error!");
+        return NULL;
+    }
+    if (_UNLIKELY(atomic_load_explicit(&_ProfilerEnabled, memory_order_relaxed))) {
+        if (allocator == &_HeapAllocator) {
+            _ProfilerOnAlloc(buf, size, file, line);
+        }
+    }
     return buf;
 }
 
-void* CUtilsRealloc(void* buf, size_t newSize) {
-    void* temp = realloc(buf, newSize);
-#ifdef CUTILS_TESTS_ENABLED
-    c_utils_total_realloc++;
-#endif
+void* CUtilsMallocWithAt(CUtilsAllocator* allocator, size_t size,
+                         const char* file, int line) {
+    return _AllocAt(allocator, size, true, file, line);
+}
+
+void* CUtilsMallocUninitWithAt(CUtilsAllocator* allocator, size_t size,
+                               const char* file, int line) {
+    return _AllocAt(allocator, size, false, file, line);
+}
+
+void* CUtilsReallocWithAt(CUtilsAllocator* allocator, void* buf, size_t newSize,
+                          const char* file, int line) {
+    if (allocator == NULL) {
+        allocator = _DefaultAllocator;
+    }
+    bool profile = false;
+    size_t oldSize = 0;
+    if (_UNLIKELY(atomic_load_explicit(&_ProfilerEnabled, memory_order_relaxed))) {
+        profile = allocator == &_HeapAllocator;
+        oldSize = profile && buf ? _HeapUsableSize(buf) : 0;
+    }
+    void* temp = allocator->realloc(allocator->userData, buf, newSize);
     if (temp == NULL) {
         DEBUG_LOG_ERROR("CUtilsRealloc: Memory allocation error! Old Buffer returned.");
         return buf;
     }
+    if (profile) {
+        atomic_fetch_add_explicit(&_Profiler.reallocCount, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&_Profiler.totalBytes, newSize, memory_order_relaxed);
+        atomic_fetch_add_explicit(&_Profiler.histogram[_HistogramBucket(newSize)], 1,
+                                  memory_order_relaxed);
+        _ProfilerAddLive((int64_t)_HeapUsableSize(temp) - (int64_t)oldSize);
+        _ProfilerAddSite(file, line, newSize);
+    }
     return temp;
 }
 
+void* CUtilsFreeWith(CUtilsAllocator* allocator, void* buf) {
+    if (allocator == NULL) {
+        allocator = _DefaultAllocator;
+    }
+    if (allocator->free) {
+        if (_UNLIKELY(atomic_load_explicit(&_ProfilerEnabled, memory_order_relaxed))) {
+            if (allocator == &_HeapAllocator && buf) {
+                _ProfilerOnFree(_HeapUsableSize(buf));
+            }
+        }
+        allocator->free(allocator->userData, buf);
+    }
+    return NULL;
+}
+
 void* CUtilsFree(void* buf) {
-    free(buf);
-#ifdef CUTILS_TESTS_ENABLED
-    c_utils_total_free++;
-#endif
+    return CUtilsFreeWith(_DefaultAllocator, buf);
+}
+
+// NODE POOL
+#define NODE_POOL_SLAB_SIZE (64 * 1024)
+#define NODE_POOL_CHUNK_SLABS 16
+#define NODE_POOL_GRANULE 16
+#define NODE_POOL_CLASS_COUNT (CUTILS_NODE_POOL_MAX_SIZE / NODE_POOL_GRANULE)
+#define NODE_POOL_REMOTE_BATCH 32
+
+typedef struct _PoolBlock {
+    struct _PoolBlock* next;
+    // Only set while the block travels to its owner.
+    size_t sizeClass;
+} _PoolBlock;
+
+// Every thread has a cache with a free list (magazine) for each size class
+// and carves new blocks from its own slab, so the common path takes no
+// lock. Slabs are aligned to their size and start with the owner cache.
+// A block freed by another thread is queued in that thread's pending
+// batch and pushed to the owner's remote list when the batch is full,
+// the owner changes or the thread exits. Owners take remote lists back
+// when their magazine runs empty. Caches of exited threads are orphaned
+// and adopted by new threads, slabs are never given back.
+typedef struct _PoolCache {
+    _PoolBlock* freeLists[NODE_POOL_CLASS_COUNT];
+    char* slabCursor;
+    char* slabEnd;
+    _Atomic(_PoolBlock*) remoteFrees;
+    struct _PoolCache* pendingOwner;
+    _PoolBlock* pendingHead;
+    _PoolBlock* pendingTail;
+    size_t pendingCount;
+    struct _PoolCache* nextOrphan;
+} _PoolCache;
+
+typedef struct _PoolSlab {
+    _PoolCache* owner;
+} _PoolSlab;
+
+#define NODE_POOL_SLAB_HEADER \
+    ((sizeof(_PoolSlab) + NODE_POOL_GRANULE - 1) / NODE_POOL_GRANULE * NODE_POOL_GRANULE)
+
+// Slabs and caches are shared by all threads.
+static struct {
+    atomic_flag lock;
+    char* chunkCursor;
+    char* chunkEnd;
+    _PoolCache* orphans;
+    pthread_once_t keyOnce;
+    pthread_key_t key;
+} _NodePool = {
+    .lock = ATOMIC_FLAG_INIT,
+    .chunkCursor = NULL,
+    .chunkEnd = NULL,
+    .orphans = NULL,
+    .keyOnce = PTHREAD_ONCE_INIT,
+    .key = 0,
+};
+
+static _THREAD_LOCAL _PoolCache* _ThreadCache = NULL;
+
+static inline bool _UsesNodePool(CUtilsAllocator* allocator, size_t size) {
+    if (allocator == NULL) {
+        allocator = _DefaultAllocator;
+    }
+    return allocator == &_HeapAllocator && size > 0 && size <= CUTILS_NODE_POOL_MAX_SIZE;
+}
+
+static inline void _NodePoolLock(void) {
+    while (atomic_flag_test_and_set_explicit(&_NodePool.lock, memory_order_acquire)) {
+    }
+}
+
+static inline void _NodePoolUnlock(void) {
+    atomic_flag_clear_explicit(&_NodePool.lock, memory_order_release);
+}
+
+static inline _PoolCache* _PoolOwner(const void* buf) {
+    return ((_PoolSlab*)((uintptr_t)buf & ~(uintptr_t)(NODE_POOL_SLAB_SIZE - 1)))->owner;
+}
+
+// Sends the pending batch to its owner with a single CAS.
+static void _PoolFlushPending(_PoolCache* cache) {
+    if (cache->pendingHead == NULL) {
+        return;
+    }
+    _PoolCache* owner = cache->pendingOwner;
+    _PoolBlock* head = atomic_load_explicit(&owner->remoteFrees, memory_order_relaxed);
+    do {
+        cache->pendingTail->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&owner->remoteFrees, &head, cache->pendingHead,
+                                                    memory_order_release, memory_order_relaxed));
+    cache->pendingOwner = NULL;
+    cache->pendingHead = NULL;
+    cache->pendingTail = NULL;
+    cache->pendingCount = 0;
+}
+
+static void _PoolTakeRemote(_PoolCache* cache) {
+    _PoolBlock* block = atomic_exchange_explicit(&cache->remoteFrees, NULL, memory_order_acquire);
+    while (block) {
+        _PoolBlock* next = block->next;
+        block->next = cache->freeLists[block->sizeClass];
+        cache->freeLists[block->sizeClass] = block;
+        block = next;
+    }
+}
+
+static void _PoolCacheRelease(void* arg) {
+    _PoolCache* cache = arg;
+    _PoolFlushPending(cache);
+    _NodePoolLock();
+    cache->nextOrphan = _NodePool.orphans;
+    _NodePool.orphans = cache;
+    _NodePoolUnlock();
+    _ThreadCache = NULL;
+}
+
+static void _PoolCreateKey(void) {
+    pthread_key_create(&_NodePool.key, _PoolCacheRelease);
+}
+
+static _PoolCache* _PoolCacheCreate(void) {
+    pthread_once(&_NodePool.keyOnce, _PoolCreateKey);
+    _NodePoolLock();
+    _PoolCache* cache = _NodePool.orphans;
+    if (cache) {
+        _NodePool.orphans = cache->nextOrphan;
+    }
+    _NodePoolUnlock();
+    if (cache == NULL) {
+        cache = _AllocAt(&_HeapAllocator, sizeof(_PoolCache), true, __FILE__, __LINE__);
+        if (cache == NULL) {
+            return NULL;
+        }
+    }
+    cache->nextOrphan = NULL;
+    pthread_setspecific(_NodePool.key, cache);
+    _ThreadCache = cache;
+    return cache;
+}
+
+static inline _PoolCache* _PoolCacheGet(void) {
+    _PoolCache* cache = _ThreadCache;
+    return cache ? cache : _PoolCacheCreate();
+}
+
+static bool _PoolNewSlab(_PoolCache* cache) {
+    _NodePoolLock();
+    if (_NodePool.chunkCursor == _NodePool.chunkEnd) {
+        // One extra slab of room to align the chunk.
+        size_t chunkSize = NODE_POOL_SLAB_SIZE * (NODE_POOL_CHUNK_SLABS + 1);
+        char* chunk = _AllocAt(&_HeapAllocator, chunkSize, false, __FILE__, __LINE__);
+        if (chunk == NULL) {
+            _NodePoolUnlock();
+            return false;
+        }
+        _NodePool.chunkCursor = (char*)(((uintptr_t)chunk + NODE_POOL_SLAB_SIZE - 1) &
+                                        ~(uintptr_t)(NODE_POOL_SLAB_SIZE - 1));
+        _NodePool.chunkEnd = _NodePool.chunkCursor + NODE_POOL_SLAB_SIZE * NODE_POOL_CHUNK_SLABS;
+    }
+    char* slab = _NodePool.chunkCursor;
+    _NodePool.chunkCursor += NODE_POOL_SLAB_SIZE;
+    _NodePoolUnlock();
+    ((_PoolSlab*)slab)->owner = cache;
+    cache->slabCursor = slab + NODE_POOL_SLAB_HEADER;
+    cache->slabEnd = slab + NODE_POOL_SLAB_SIZE;
+    return true;
+}
+
+void* CUtilsNodeMalloc(CUtilsAllocator* allocator, size_t size) {
+    if (!_UsesNodePool(allocator, size)) {
+        return CUtilsMallocWith(allocator, size);
+    }
+    _PoolCache* cache = _PoolCacheGet();
+    if (cache == NULL) {
+        DEBUG_LOG_ERROR("CUtilsNodeMalloc: Memory allocation error!");
+        return NULL;
+    }
+    size_t sizeClass = (size - 1) / NODE_POOL_GRANULE;
+    _PoolBlock* block = cache->freeLists[sizeClass];
+    if (block == NULL && atomic_load_explicit(&cache->remoteFrees, memory_order_relaxed)) {
+        _PoolTakeRemote(cache);
+        block = cache->freeLists[sizeClass];
+    }
+    void* buf;
+    if (block) {
+        cache->freeLists[sizeClass] = block->next;
+        buf = block;
+    } else {
+        size_t blockSize = (sizeClass + 1) * NODE_POOL_GRANULE;
+        if ((size_t)(cache->slabEnd - cache->slabCursor) < blockSize && !_PoolNewSlab(cache)) {
+            DEBUG_LOG_ERROR("CUtilsNodeMalloc: Memory allocation error!");
+            return NULL;
+        }
+        buf = cache->slabCursor;
+        cache->slabCursor += blockSize;
+    }
+    memset(buf, 0, size);
+    return buf;
+}
+
+void* CUtilsNodeFree(CUtilsAllocator* allocator, void* buf, size_t size) {
+    if (buf == NULL) {
+        return NULL;
+    }
+    if (!_UsesNodePool(allocator, size)) {
+        return CUtilsFreeWith(allocator, buf);
+    }
+    size_t sizeClass = (size - 1) / NODE_POOL_GRANULE;
+    _PoolBlock* block = buf;
+    _PoolCache* cache = _PoolCacheGet();
+    _PoolCache* owner = _PoolOwner(buf);
+    if (owner == cache) {
+        block->next = cache->freeLists[sizeClass];
+        cache->freeLists[sizeClass] = block;
+        return NULL;
+    }
+    if (cache == NULL) {
+        // No cache to batch in, send the block alone.
+        _PoolCache single = {0};
+        single.pendingOwner = owner;
+        single.pendingHead = single.pendingTail = block;
+        block->sizeClass = sizeClass;
+        _PoolFlushPending(&single);
+        return NULL;
+    }
+    if (cache->pendingOwner != owner) {
+        _PoolFlushPending(cache);
+        cache->pendingOwner = owner;
+    }
+    block->sizeClass = sizeClass;
+    block->next = cache->pendingHead;
+    cache->pendingHead = block;
+    if (cache->pendingTail == NULL) {
+        cache->pendingTail = block;
+    }
+    if (++cache->pendingCount == NODE_POOL_REMOTE_BATCH) {
+        _PoolFlushPending(cache);
+    }
     return NULL;
 }
 
+// ARENA
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+// Every allocation is prefixed with its size, which keeps the data
+// 16 byte aligned and lets realloc know how much to copy.
+#define ARENA_BLOCK_HEADER 16
+
+static inline char* _ArenaChunkData(CUtilsArenaChunk* chunk) {
+    return (char*)chunk + ARENA_BLOCK_HEADER * 2;
+}
+
+static inline size_t _ArenaBlockSize(void* buf) {
+    return *(size_t*)((char*)buf - ARENA_BLOCK_HEADER);
+}
+
+static inline size_t _ArenaAlign(size_t size) {
+    return (size + 15) & ~(size_t)15;
+}
+
+static CUtilsArenaChunk* _ArenaAddChunk(CUtilsArena* arena, size_t minCapacity) {
+    size_t capacity = minCapacity > arena->chunkSize ? minCapacity : arena->chunkSize;
+    CUtilsArenaChunk* chunk = _AllocAt(arena->backing, ARENA_BLOCK_HEADER * 2 + capacity,
+                                       false, __FILE__, __LINE__);
+    if (chunk == NULL) {
+        DEBUG_LOG_ERROR("CUtilsArena: Memory allocation error!");
+        return NULL;
+    }
+    chunk->prev = arena->current;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    arena->current = chunk;
+    return chunk;
+}
+
+static void _ArenaFreeChunk(CUtilsArena* arena, CUtilsArenaChunk* chunk) {
+    CUtilsFreeWith(arena->backing, chunk);
+}
+
+// Bumps the arena without clearing the block.
+static void* _ArenaPush(CUtilsArena* arena, size_t size) {
+    size_t blockSize = ARENA_BLOCK_HEADER + _ArenaAlign(size);
+    CUtilsArenaChunk* chunk = arena->current;
+    if (chunk == NULL || chunk->capacity - chunk->used < blockSize) {
+        chunk = _ArenaAddChunk(arena, blockSize);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+    char* block = _ArenaChunkData(chunk) + chunk->used;
+    chunk->used += blockSize;
+    *(size_t*)block = size;
+    return block + ARENA_BLOCK_HEADER;
+}
+
+static void* _ArenaAlloc(void* userData, size_t size) {
+    return _ArenaPush(userData, size);
+}
+
+static void* _ArenaAllocZeroed(void* userData, size_t size) {
+    return CUtilsArenaMalloc(userData, size);
+}
+
+static void* _ArenaRealloc(void* userData, void* buf, size_t newSize) {
+    return CUtilsArenaRealloc(userData, buf, newSize);
+}
+
+CUtilsArena* CUtilsArenaCreate(size_t chunkSize) {
+    CUtilsAllocator* backing = CUtilsGetDefaultAllocator();
+    CUtilsArena* arena = CUtilsMallocWith(backing, sizeof(CUtilsArena));
+    arena->allocator.alloc = _ArenaAlloc;
+    arena->allocator.realloc = _ArenaRealloc;
+    arena->allocator.free = NULL;
+    arena->allocator.userData = arena;
+    arena->allocator.allocZeroed = _ArenaAllocZeroed;
+    arena->backing = backing;
+    arena->current = NULL;
+    arena->chunkSize = chunkSize > 0 ? _ArenaAlign(chunkSize) : ARENA_DEFAULT_CHUNK_SIZE;
+    return arena;
+}
+
+void CUtilsArenaFree(CUtilsArena* arena) {
+    CUtilsArenaClear(arena);
+    if (arena->current) {
+        _ArenaFreeChunk(arena, arena->current);
+    }
+    CUtilsFreeWith(arena->backing, arena);
+}
+
+void CUtilsArenaClear(CUtilsArena* arena) {
+    CUtilsArenaMark mark = {NULL, 0};
+    CUtilsArenaReset(arena, mark);
+}
+
+CUtilsArenaMark CUtilsArenaGetMark(CUtilsArena* arena) {
+    CUtilsArenaMark mark;
+    mark.chunk = arena->current;
+    mark.used = arena->current ? arena->current->used : 0;
+    return mark;
+}
+
+void CUtilsArenaReset(CUtilsArena* arena, CUtilsArenaMark mark) {
+    // Keep the oldest chunk when clearing, so the arena can be reused
+    // without going to the heap again.
+    while (arena->current && arena->current != mark.chunk &&
+           (mark.chunk || arena->current->prev)) {
+        CUtilsArenaChunk* prev = arena->current->prev;
+        _ArenaFreeChunk(arena, arena->current);
+        arena->current = prev;
+    }
+    if (arena->current) {
+        arena->current->used = mark.chunk ? mark.used : 0;
+    }
+}
+
+void* CUtilsArenaMalloc(CUtilsArena* arena, size_t size) {
+    void* buf = _ArenaPush(arena, size);
+    if (buf) {
+        memset(buf, 0, size);
+    }
+    return buf;
+}
+
+void* CUtilsArenaRealloc(CUtilsArena* arena, void* buf, size_t newSize) {
+    if (buf == NULL) {
+        return CUtilsArenaMalloc(arena, newSize);
+    }
+    size_t oldSize = _ArenaBlockSize(buf);
+    CUtilsArenaChunk* chunk = arena->current;
+    char* blockEnd = (char*)buf + _ArenaAlign(oldSize);
+    if (chunk && blockEnd == _ArenaChunkData(chunk) + chunk->used) {
+        // Last allocation of the chunk, try to grow in place.
+        size_t start = (char*)buf - _ArenaChunkData(chunk);
+        if (start + _ArenaAlign(newSize) <= chunk->capacity) {
+            chunk->used = start + _ArenaAlign(newSize);
+            if (newSize > oldSize) {
+                memset((char*)buf + oldSize, 0, newSize - oldSize);
+            }
+            *(size_t*)((char*)buf - ARENA_BLOCK_HEADER) = newSize;
+            return buf;
+        }
+    }
+    if (newSize <= oldSize) {
+        *(size_t*)((char*)buf - ARENA_BLOCK_HEADER) = newSize;
+        return buf;
+    }
+    void* newBuf = CUtilsArenaMalloc(arena, newSize);
+    if (newBuf == NULL) {
+        DEBUG_LOG_ERROR("CUtilsArenaRealloc: Memory allocation error! Old Buffer returned.");
+        return buf;
+    }
+    memcpy(newBuf, buf, oldSize);
+    return newBuf;
+}
+
+CUtilsAllocator* CUtilsArenaGetAllocator(CUtilsArena* arena) {
+    return &arena->allocator;
+}
+
 #ifdef __cplusplus
 }
 #endif
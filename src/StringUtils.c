@@ -18,41 +18,56 @@ extern "C" {
 #endif
 
 // PRIVATE BEGIN
-static void _CheckCapacity(String* string) {
+// Array doesn't clear its spare capacity, so the terminator is written
+// after every change of the size. Shrinking is left to the array policy.
+static void _Terminate(String* string) {
     uint64_t size = ArrayGetSize(string->c_str);
-    uint64_t capacity = ArrayGetCapacity(string->c_str);
-    if (size >= capacity) {
-        ArrayReserve(string->c_str, capacity * 2);
-    } else if (size < capacity / 2) {
-        ArrayReserve(string->c_str, size + 1);
-    }
+    ArrayGrow(string->c_str, size + 1);
+    string->c_str[size] = '\0';
 }
 
 static char* _CreateStrFormat(const char* Format, va_list args) {
     char* str = NULL;
-    int n = vsnprintf(NULL, 0, Format, args);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    int n = vsnprintf(NULL, 0, Format, argsCopy);
+    va_end(argsCopy);
     ASSERT_BREAK(n > 0);
-    str = CUtilsMalloc(n + 1);
+    str = CUtilsMallocUninit(n + 1);
     int c = vsnprintf(str, n + 1, Format, args);
     ASSERT_BREAK(c == n);
     return str;
 }
 
+static String _CreateCStrWithAllocator(const char* str, CUtilsAllocator* allocator) {
+    uint64_t strLen = strlen(str);
+    String string = StringCreateWithAllocator(strLen, allocator);
+    string.length = strLen;
+    ArrayInsert(string.c_str, str, strLen);
+    _Terminate(&string);
+    return string;
+}
+
+static bool _IsTrimmed(const void* element, void* userData) {
+    return ((bool*)userData)[*(const uint8_t*)element];
+}
+
 // PRIVATE END
 
 String StringCreate(uint64_t capacity) {
+    return StringCreateWithAllocator(capacity, NULL);
+}
+
+String StringCreateWithAllocator(uint64_t capacity, CUtilsAllocator* allocator) {
     String string;
-    string.c_str = _ArrayCreate(CHAR_STRIDE, capacity);
+    string.c_str = _ArrayCreateWithAllocator(CHAR_STRIDE, capacity, allocator);
     string.length = 0;
+    _Terminate(&string);
     return string;
 }
 
 String StringCreateCStr(const char* str) {
-    uint64_t strLen = strlen(str);
-    String string = StringCreate(strLen);
-    string.length = strLen;
-    ArrayInsert(string.c_str, str, strLen);
-    return string;
+    return _CreateCStrWithAllocator(str, NULL);
 }
 
 String StringCreateFormat(const char* Format, ...) {
@@ -66,7 +81,7 @@ String StringCreateFormat(const char* Format, ...) {
 }
 
 String StringGetCopy(const String* string) {
-    return StringCreateCStr(string->c_str);
+    return _CreateCStrWithAllocator(string->c_str, ArrayGetAllocator(string->c_str));
 }
 
 void StringFree(String* string) {
@@ -168,14 +183,14 @@ void StringAppend(String* string, const String* appendString) {
 void StringAppendCStr(String* string, const char* append) {
     uint64_t appLen = strlen(append);
     ArrayInsert(string->c_str, append, appLen);
-    _CheckCapacity(string);
+    _Terminate(string);
     string->length += appLen;
     ASSERT_BREAK(string->length == ArrayGetSize(string->c_str));
 }
 
 void StringAppendChar(String* string, const char c) {
     ArrayPush(string->c_str, c);
-    _CheckCapacity(string);
+    _Terminate(string);
     string->length++;
     ASSERT_BREAK(string->length == ArrayGetSize(string->c_str));
 }
@@ -195,7 +210,7 @@ void StringErase(String* string, uint64_t from, uint64_t to) {
         to = stringLen;
     }
     ArrayRemove(string->c_str, from, to - from);
-    _CheckCapacity(string);
+    _Terminate(string);
     string->length -= (to - from);
     ASSERT_BREAK(string->length == ArrayGetSize(string->c_str));
 }
@@ -205,9 +220,10 @@ String StringSubString(const String* string, uint64_t from, uint64_t to) {
     if (to == 0 || to > stringLen || to < from) {
         to = stringLen;
     }
-    String sub = StringCreate(to - from);
+    String sub = StringCreateWithAllocator(to - from, ArrayGetAllocator(string->c_str));
     ArrayInsert(sub.c_str, string->c_str + from, to - from);
     sub.length = to - from;
+    _Terminate(&sub);
     ASSERT_BREAK(sub.length == ArrayGetSize(sub.c_str));
     return sub;
 }
@@ -222,6 +238,7 @@ void StringReplace(String* string, const char* from,
     while (StringFind(string, from, index, 0, &foundIndex)) {
         StringErase(string, foundIndex, foundIndex + fromLen);
         ArrayInsertAt(string->c_str, to, toLen, foundIndex);
+        _Terminate(string);
         string->length += toLen;
         index = foundIndex + toLen;
         if (!replaceAll) {
@@ -231,20 +248,18 @@ void StringReplace(String* string, const char* from,
 }
 
 void StringTrim(String* string, const char* trimList) {
-    uint64_t stringLen = ArrayGetSize(string->c_str);
-    uint32_t trimListLen = strlen(trimList);
-    uint64_t i = 0;
-    while (i < stringLen) {
+    uint64_t trimListLen = strlen(trimList);
+    if (trimListLen == 1) {
+        ArrayRemoveValue(string->c_str, trimList[0]);
+    } else if (trimListLen > 1) {
+        bool trimmed[256] = {false};
         for (uint64_t j = 0; j < trimListLen; j++) {
-            if (string->c_str[i] == trimList[j]) {
-                CUtilsFree(ArrayPopAt(string->c_str, i));
-                stringLen--;
-                i--;
-            }
+            trimmed[(uint8_t)trimList[j]] = true;
         }
-        i++;
+        ArrayRemoveIf(string->c_str, _IsTrimmed, trimmed);
     }
-    ArrayReserve(string->c_str, ArrayGetSize(string->c_str) + 1);
+    string->length = ArrayGetSize(string->c_str);
+    _Terminate(string);
 }
 
 void StringEncode(String* string, const char* password) {
@@ -1,5 +1,6 @@
 #include "containers/Array.h"
 
+#include <math.h>
 #include <memory.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,6 +11,11 @@
 #include "Debug.h"
 #include "MemoryUtils.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ARRAY_X86
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -18,13 +24,39 @@ typedef enum header_fields {
     CAPACITY = 0,
     SIZE = 1,
     STRIDE = 2,
-    TOTAL = 3
+    ALLOCATOR = 3,
+    GROWTH = 4,  // growth factor bits | shrink divisor << 32
+    MIN_CAPACITY = 5,
+    ALIGNMENT = 6,
+    OFFSET = 7,  // bytes from the allocated block to the header
+    TOTAL = 8    // keeps the data 16 byte aligned
 } header_fields;
 
+_Static_assert(TOTAL * sizeof(uint64_t) == ARRAY_HEADER_SIZE, "ARRAY_HEADER_SIZE is out of date");
+
+#define ARRAY_DEFAULT_ALIGNMENT 16
+// Set in the offset field while the array lives in caller storage.
+#define OFFSET_INLINE ((uint64_t)1 << 63)
+
 static inline uint64_t *_Header(const void *array) {
     return (uint64_t *)array - TOTAL;
 }
 
+// Room to slide the header into place, enough for any 8 byte aligned block.
+// Allocators must give 16 byte aligned blocks, the default alignment, so
+// default arrays need no padding.
+static inline uint64_t _AlignmentPadding(uint64_t alignment) {
+    return alignment > ARRAY_DEFAULT_ALIGNMENT ? alignment - 8 : 0;
+}
+
+static inline uint64_t _AlignmentOffset(const char *block, uint64_t alignment) {
+    if (alignment <= ARRAY_DEFAULT_ALIGNMENT) {
+        return 0;
+    }
+    uintptr_t data = (uintptr_t)block + TOTAL * sizeof(uint64_t);
+    return (alignment - data % alignment) % alignment;
+}
+
 static inline uint64_t _FieldGet(const void *array, header_fields field) {
     return _Header(array)[field];
 }
@@ -33,6 +65,26 @@ static inline void _FieldSet(const void *array, header_fields field, uint64_t va
     _Header(array)[field] = val;
 }
 
+static inline void _PolicySet(const void *array, ArrayGrowthPolicy policy) {
+    uint32_t factorBits;
+    memcpy(&factorBits, &policy.growthFactor, sizeof(factorBits));
+    _FieldSet(array, GROWTH, factorBits | ((uint64_t)policy.shrinkDivisor << 32));
+    _FieldSet(array, MIN_CAPACITY, policy.minCapacity > 0 ? policy.minCapacity : 1);
+}
+
+static void *_HeaderInit(uint64_t *head, uint64_t capacity, size_t stride,
+                         CUtilsAllocator *allocator, uint64_t alignment, uint64_t offset) {
+    head[CAPACITY] = capacity;
+    head[SIZE] = 0;
+    head[STRIDE] = stride;
+    head[ALLOCATOR] = (uint64_t)(uintptr_t)allocator;
+    head[ALIGNMENT] = alignment;
+    head[OFFSET] = offset;
+    void *array = (void *)(head + TOTAL);
+    _PolicySet(array, (ArrayGrowthPolicy)ARRAY_DEFAULT_GROWTH_POLICY);
+    return array;
+}
+
 static inline void _RaiseIndexOutOfBounds(const void *array, uint64_t index) {
     DEBUG_LOG_ERROR("Index out of bounds. Index: %lu, Array Size: %lu.",
                     (unsigned long)index, (unsigned long)ArrayGetSize(array));
@@ -40,56 +92,160 @@ static inline void _RaiseIndexOutOfBounds(const void *array, uint64_t index) {
 }
 
 void *_ArrayCreate(size_t stride, uint64_t capacity) {
-    uint64_t create_size = TOTAL * sizeof(uint64_t) + stride * capacity;
-    uint64_t *head = CUtilsMalloc(create_size);
-    memset(head, 0, create_size);
-    head[CAPACITY] = capacity > 0 ? capacity : 1;
-    head[SIZE] = 0;
-    head[STRIDE] = stride;
-    return (void *)(head + TOTAL);
+    return _ArrayCreateWithAllocator(stride, capacity, NULL);
+}
+
+void *_ArrayCreateWithAllocator(size_t stride, uint64_t capacity, CUtilsAllocator *allocator) {
+    return _ArrayCreateAligned(stride, capacity, ARRAY_DEFAULT_ALIGNMENT, allocator);
+}
+
+void *_ArrayCreateAligned(size_t stride, uint64_t capacity, size_t alignment,
+                          CUtilsAllocator *allocator) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        DEBUG_LOG_ERROR("ArrayCreateAligned: Alignment must be a power of two, given: %lu.",
+                        (unsigned long)alignment);
+        return NULL;
+    }
+    if (alignment < ARRAY_DEFAULT_ALIGNMENT) {
+        alignment = ARRAY_DEFAULT_ALIGNMENT;
+    }
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    uint64_t create_size = _AlignmentPadding(alignment) + TOTAL * sizeof(uint64_t) + stride * capacity;
+    char *block = CUtilsMallocUninitWith(allocator, create_size);
+    uint64_t offset = _AlignmentOffset(block, alignment);
+    return _HeaderInit((uint64_t *)(block + offset), capacity, stride, allocator, alignment, offset);
+}
+
+void *_ArrayCreateInline(void *storage, size_t storageSize, size_t stride,
+                         CUtilsAllocator *allocator) {
+    if ((uintptr_t)storage % ARRAY_DEFAULT_ALIGNMENT != 0 ||
+        storageSize < TOTAL * sizeof(uint64_t) + stride) {
+        DEBUG_LOG_ERROR("ArrayCreateInline: Storage must be 16 byte aligned and fit the header and an element. Size: %lu.",
+                        (unsigned long)storageSize);
+        return NULL;
+    }
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    uint64_t capacity = (storageSize - TOTAL * sizeof(uint64_t)) / stride;
+    return _HeaderInit(storage, capacity, stride, allocator, ARRAY_DEFAULT_ALIGNMENT, OFFSET_INLINE);
 }
 
 void *_ArrayFree(void *array) {
-    CUtilsFree(_Header(array));
+    uint64_t offset = _FieldGet(array, OFFSET);
+    if (offset & OFFSET_INLINE) {
+        return NULL;
+    }
+    CUtilsFreeWith(ArrayGetAllocator(array), (char *)_Header(array) - offset);
     return NULL;
 }
 
+// Inline arrays keep their storage until they outgrow it, then move to
+// the heap for good.
+static void *_ArraySpill(void *array, uint64_t new_capacity) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t new_size = (size > new_capacity) ? new_capacity : size;
+    if (new_capacity <= ArrayGetCapacity(array)) {
+        _FieldSet(array, SIZE, new_size);
+        return array;
+    }
+    uint64_t stride = ArrayGetStride(array);
+    uint64_t alignment = _FieldGet(array, ALIGNMENT);
+    uint64_t create_size = _AlignmentPadding(alignment) + TOTAL * sizeof(uint64_t) + stride * new_capacity;
+    char *block = CUtilsMallocUninitWith(ArrayGetAllocator(array), create_size);
+    uint64_t offset = _AlignmentOffset(block, alignment);
+    memcpy(block + offset, _Header(array), TOTAL * sizeof(uint64_t) + size * stride);
+    array = (void *)(block + offset + TOTAL * sizeof(uint64_t));
+    _FieldSet(array, OFFSET, offset);
+    _FieldSet(array, CAPACITY, new_capacity);
+    return array;
+}
+
 void *_ArrayResize(void *array, uint64_t new_capacity) {
-    uint64_t capacity = ArrayGetCapacity(array);
+    if (_FieldGet(array, OFFSET) & OFFSET_INLINE) {
+        return _ArraySpill(array, new_capacity);
+    }
     uint64_t size = ArrayGetSize(array);
     uint64_t stride = ArrayGetStride(array);
-    uint64_t create_size = TOTAL * sizeof(uint64_t) + stride * new_capacity;
-    uint64_t *head = CUtilsRealloc(_Header(array), create_size);
+    uint64_t alignment = _FieldGet(array, ALIGNMENT);
+    uint64_t offset = _FieldGet(array, OFFSET);
+    uint64_t new_size = (size > new_capacity) ? new_capacity : size;
+    uint64_t create_size = _AlignmentPadding(alignment) + TOTAL * sizeof(uint64_t) + stride * new_capacity;
+    char *block = (char *)_Header(array) - offset;
+    block = CUtilsReallocWith(ArrayGetAllocator(array), block, create_size);
+    uint64_t new_offset = _AlignmentOffset(block, alignment);
+    if (new_offset != offset) {
+        // Realloc kept the old offset, slide header and elements into place.
+        memmove(block + new_offset, block + offset, TOTAL * sizeof(uint64_t) + new_size * stride);
+    }
 
-    array = (void *)(head + TOTAL);
+    array = (void *)(block + new_offset + TOTAL * sizeof(uint64_t));
+    _FieldSet(array, OFFSET, new_offset);
     _FieldSet(array, CAPACITY, new_capacity);
-    uint64_t new_size = (size > new_capacity) ? new_capacity : size;
     _FieldSet(array, SIZE, new_size);
+    return array;
+}
+
+void *_ArrayGrow(void *array, uint64_t minCapacity) {
+    uint64_t capacity = ArrayGetCapacity(array);
+    if (capacity >= minCapacity) {
+        return array;
+    }
+    double factor = ArrayGetGrowthPolicy(array).growthFactor;
+    uint64_t new_capacity = capacity;
+    while (new_capacity < minCapacity) {
+        uint64_t grown = (uint64_t)(new_capacity * factor);
+        new_capacity = grown > new_capacity ? grown : new_capacity + 1;
+    }
+    return _ArrayResize(array, new_capacity);
+}
 
-    if (new_size < new_capacity) {
-        memset((char *)array + new_size * stride,
-               0,
-               (new_capacity - new_size) * stride);
+// Shrinks to twice the size once the size drops below capacity / divisor,
+// so push and pop around a boundary never realloc back to back.
+static void *_ArrayShrinkIfSparse(void *array) {
+    uint64_t divisor = _FieldGet(array, GROWTH) >> 32;
+    uint64_t capacity = ArrayGetCapacity(array);
+    uint64_t size = ArrayGetSize(array);
+    if (divisor == 0 || size >= capacity / divisor) {
+        return array;
+    }
+    uint64_t new_capacity = size * 2;
+    uint64_t min_capacity = _FieldGet(array, MIN_CAPACITY);
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+    if (new_capacity < capacity) {
+        array = _ArrayResize(array, new_capacity);
     }
     return array;
 }
 
-void *_ArrayClear(void *array) {
-    if (ArrayGetCapacity(array) > 1) {
-        array = _ArrayResize(array, 1);
+void *_ArrayShrinkToFit(void *array) {
+    uint64_t new_capacity = ArrayGetSize(array);
+    uint64_t min_capacity = _FieldGet(array, MIN_CAPACITY);
+    if (new_capacity < min_capacity) {
+        new_capacity = min_capacity;
+    }
+    if (new_capacity != ArrayGetCapacity(array)) {
+        array = _ArrayResize(array, new_capacity);
     }
-    _FieldSet(array, CAPACITY, 1);
-    _FieldSet(array, SIZE, 0);
     return array;
 }
 
+void *_ArrayClear(void *array) {
+    _FieldSet(array, SIZE, 0);
+    return _ArrayShrinkIfSparse(array);
+}
+
 void *_ArrayPushAt(void *array, const void *value, uint64_t index) {
-    uint64_t capacity = ArrayGetCapacity(array);
     uint64_t size = ArrayGetSize(array);
     uint64_t stride = ArrayGetStride(array);
-    if (capacity <= size) {
-        array = _ArrayResize(array, capacity * 2);
-    }
+    array = _ArrayGrow(array, size + 1);
     if (index > size) {
         index = size;
     } else if (index < size) {
@@ -103,38 +259,53 @@ void *_ArrayPushAt(void *array, const void *value, uint64_t index) {
     return array;
 }
 
-void *ArrayPopAt(void *array, uint64_t index) {
-    uint64_t capacity = ArrayGetCapacity(array);
+// Removes the element at index, copies it to outValue if it is not NULL.
+// Returns false if the array is empty.
+static bool _ArrayTakeAt(void *array, uint64_t index, void *outValue) {
     uint64_t size = ArrayGetSize(array);
     uint64_t stride = ArrayGetStride(array);
-    if (size <= 0) {
-        _RaiseIndexOutOfBounds(array, index);
-        return NULL;
+    if (size == 0) {
+        return false;
     }
     if (index >= size) {
         index = size - 1;
     }
-    void *value = CUtilsMalloc(stride);
     void *src = (char *)array + index * stride;
-    memcpy(value, src, stride);
+    if (outValue) {
+        memcpy(outValue, src, stride);
+    }
     _FieldSet(array, SIZE, size - 1);
     if (index < size - 1) {
         memmove(src,
                 (char *)array + (index + 1) * stride,
                 (size - 1 - index) * stride);
     }
+    return true;
+}
+
+void *ArrayPopAt(void *array, uint64_t index) {
+    if (ArrayGetSize(array) == 0) {
+        _RaiseIndexOutOfBounds(array, index);
+        return NULL;
+    }
+    void *value = CUtilsMallocUninit(ArrayGetStride(array));
+    _ArrayTakeAt(array, index, value);
     return value;
 }
 
+bool ArrayPopInto(void *array, uint64_t index, void *outValue) {
+    return _ArrayTakeAt(array, index, outValue);
+}
+
+bool ArrayDiscardAt(void *array, uint64_t index) {
+    return _ArrayTakeAt(array, index, NULL);
+}
+
 void *_ArrayInsertAt(void *array, const void *buffer,
                      uint64_t bufferLength, uint64_t index) {
-    uint64_t capacity = ArrayGetCapacity(array);
     uint64_t size = ArrayGetSize(array);
     uint64_t stride = ArrayGetStride(array);
-    while (capacity <= size + bufferLength) {
-        array = _ArrayResize(array, capacity * 2);
-        capacity = ArrayGetCapacity(array);
-    }
+    array = _ArrayGrow(array, size + bufferLength);
     if (index > size) {
         index = size;
     } else if (index < size) {
@@ -165,8 +336,1313 @@ void *_ArrayRemove(void *array, uint64_t startIndex, uint64_t length) {
                 (size - (startIndex + length)) * stride);
     }
     _FieldSet(array, SIZE, size - length);
-    ArrayPack(array);
-    return array;
+    return _ArrayShrinkIfSparse(array);
+}
+
+// Moves the kept run [start, end) down to write, returns the new write index.
+static inline uint64_t _ArrayKeepRun(void *array, uint64_t stride, uint64_t write,
+                                     uint64_t start, uint64_t end) {
+    if (start != write && end > start) {
+        memmove((char *)array + write * stride,
+                (char *)array + start * stride,
+                (end - start) * stride);
+    }
+    return write + (end - start);
+}
+
+void *_ArrayRemoveIf(void *array, ArrayPredicate predicate, void *userData) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    uint64_t write = 0;
+    uint64_t i = 0;
+    while (i < size) {
+        while (i < size && predicate((char *)array + i * stride, userData)) {
+            i++;
+        }
+        uint64_t start = i;
+        while (i < size && !predicate((char *)array + i * stride, userData)) {
+            i++;
+        }
+        write = _ArrayKeepRun(array, stride, write, start, i);
+    }
+    _FieldSet(array, SIZE, write);
+    return _ArrayShrinkIfSparse(array);
+}
+
+void *_ArrayRemoveIndices(void *array, const uint64_t *indices, uint64_t count) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    if (count == 0) {
+        return array;
+    }
+    for (uint64_t i = 1; i < count; i++) {
+        if (indices[i] < indices[i - 1]) {
+            DEBUG_LOG_ERROR("ArrayRemoveIndices: Indices are not sorted. Index: %lu, Previous: %lu.",
+                            (unsigned long)indices[i], (unsigned long)indices[i - 1]);
+            return array;
+        }
+    }
+    if (indices[count - 1] >= size) {
+        _RaiseIndexOutOfBounds(array, indices[count - 1]);
+        return array;
+    }
+    uint64_t write = indices[0];
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t end = i + 1 < count ? indices[i + 1] : size;
+        write = _ArrayKeepRun(array, stride, write, indices[i] + 1 > end ? end : indices[i] + 1, end);
+    }
+    _FieldSet(array, SIZE, write);
+    return _ArrayShrinkIfSparse(array);
+}
+
+void *_ArrayRemoveValue(void *array, const void *value) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    uint64_t write = 0;
+    uint64_t i = 0;
+    if (stride == 1) {
+        // Byte arrays jump between matches with the vectorized search.
+        uint8_t byte = *(const uint8_t *)value;
+        while (i < size) {
+            uint8_t *found = MemoryFindByte((char *)array + i, size - i, byte);
+            uint64_t end = found ? (uint64_t)(found - (uint8_t *)array) : size;
+            write = _ArrayKeepRun(array, stride, write, i, end);
+            i = end + 1;
+        }
+    } else {
+        while (i < size) {
+            while (i < size && memcmp((char *)array + i * stride, value, stride) == 0) {
+                i++;
+            }
+            uint64_t start = i;
+            while (i < size && memcmp((char *)array + i * stride, value, stride) != 0) {
+                i++;
+            }
+            write = _ArrayKeepRun(array, stride, write, start, i);
+        }
+    }
+    _FieldSet(array, SIZE, write);
+    return _ArrayShrinkIfSparse(array);
+}
+
+#define SORT_INSERTION_THRESHOLD 16
+#define SORT_MERGE_RUN 32
+
+// Sort kernels are inlined once per common stride so the stride is a
+// constant in every copy and swap below.
+#if defined(__GNUC__)
+#define _ALWAYS_INLINE static inline __attribute__((always_inline))
+#else
+#define _ALWAYS_INLINE static inline
+#endif
+
+_ALWAYS_INLINE void _SortCopy(char *dest, const char *src, size_t stride) {
+    switch (stride) {
+        case 4: {
+            uint32_t value;
+            memcpy(&value, src, 4);
+            memcpy(dest, &value, 4);
+            break;
+        }
+        case 8: {
+            uint64_t value;
+            memcpy(&value, src, 8);
+            memcpy(dest, &value, 8);
+            break;
+        }
+        case 16: {
+            uint64_t value[2];
+            memcpy(value, src, 16);
+            memcpy(dest, value, 16);
+            break;
+        }
+        default:
+            memcpy(dest, src, stride);
+            break;
+    }
+}
+
+_ALWAYS_INLINE void _SortSwap(char *a, char *b, size_t stride) {
+    switch (stride) {
+        case 4: {
+            uint32_t x, y;
+            memcpy(&x, a, 4);
+            memcpy(&y, b, 4);
+            memcpy(a, &y, 4);
+            memcpy(b, &x, 4);
+            break;
+        }
+        case 8: {
+            uint64_t x, y;
+            memcpy(&x, a, 8);
+            memcpy(&y, b, 8);
+            memcpy(a, &y, 8);
+            memcpy(b, &x, 8);
+            break;
+        }
+        case 16: {
+            uint64_t x[2], y[2];
+            memcpy(x, a, 16);
+            memcpy(y, b, 16);
+            memcpy(a, y, 16);
+            memcpy(b, x, 16);
+            break;
+        }
+        default: {
+            size_t i = 0;
+            for (; i + 8 <= stride; i += 8) {
+                uint64_t x, y;
+                memcpy(&x, a + i, 8);
+                memcpy(&y, b + i, 8);
+                memcpy(a + i, &y, 8);
+                memcpy(b + i, &x, 8);
+            }
+            for (; i < stride; i++) {
+                char temp = a[i];
+                a[i] = b[i];
+                b[i] = temp;
+            }
+            break;
+        }
+    }
+}
+
+// Stable, only moves an element past strictly bigger ones.
+_ALWAYS_INLINE void _SortInsertion(char *base, uint64_t n, size_t stride, ArrayComparator comparator) {
+    for (uint64_t i = 1; i < n; i++) {
+        char *p = base + i * stride;
+        while (p > base && comparator(p - stride, p) > 0) {
+            _SortSwap(p - stride, p, stride);
+            p -= stride;
+        }
+    }
+}
+
+_ALWAYS_INLINE void _SortSiftDown(char *base, uint64_t root, uint64_t n, size_t stride,
+                                  ArrayComparator comparator) {
+    for (;;) {
+        uint64_t child = root * 2 + 1;
+        if (child >= n) {
+            return;
+        }
+        if (child + 1 < n && comparator(base + child * stride, base + (child + 1) * stride) < 0) {
+            child++;
+        }
+        if (comparator(base + root * stride, base + child * stride) >= 0) {
+            return;
+        }
+        _SortSwap(base + root * stride, base + child * stride, stride);
+        root = child;
+    }
+}
+
+_ALWAYS_INLINE void _SortHeap(char *base, uint64_t n, size_t stride, ArrayComparator comparator) {
+    for (uint64_t i = n / 2; i-- > 0;) {
+        _SortSiftDown(base, i, n, stride, comparator);
+    }
+    for (uint64_t end = n - 1; end > 0; end--) {
+        _SortSwap(base, base + end * stride, stride);
+        _SortSiftDown(base, 0, end, stride, comparator);
+    }
+}
+
+// Puts the median of first, middle and last at base and partitions around
+// it. Returns the final index of the pivot.
+_ALWAYS_INLINE uint64_t _SortPartition(char *base, uint64_t n, size_t stride, ArrayComparator comparator) {
+    char *mid = base + (n / 2) * stride;
+    char *last = base + (n - 1) * stride;
+    if (comparator(mid, base) < 0) {
+        _SortSwap(mid, base, stride);
+    }
+    if (comparator(last, mid) < 0) {
+        _SortSwap(last, mid, stride);
+        if (comparator(mid, base) < 0) {
+            _SortSwap(mid, base, stride);
+        }
+    }
+    _SortSwap(base, mid, stride);
+    // Last is not smaller than the pivot and the pivot itself stops the
+    // right scan, so neither scan needs a bounds check.
+    char *i = base;
+    char *j = base + n * stride;
+    for (;;) {
+        do {
+            i += stride;
+        } while (comparator(i, base) < 0);
+        do {
+            j -= stride;
+        } while (comparator(base, j) < 0);
+        if (i >= j) {
+            break;
+        }
+        _SortSwap(i, j, stride);
+    }
+    _SortSwap(base, j, stride);
+    return (uint64_t)(j - base) / stride;
+}
+
+_ALWAYS_INLINE void _SortIntro(char *base, uint64_t n, size_t stride, ArrayComparator comparator) {
+    struct {
+        char *base;
+        uint64_t n;
+        uint32_t depth;
+    } stack[64];
+    uint32_t top = 0;
+    uint32_t depth = 0;
+    for (uint64_t i = n; i > 1; i >>= 1) {
+        depth += 2;
+    }
+    char *start = base;
+    uint64_t count = n;
+    for (;;) {
+        while (count > SORT_INSERTION_THRESHOLD) {
+            if (depth == 0) {
+                _SortHeap(start, count, stride, comparator);
+                break;
+            }
+            depth--;
+            uint64_t pivot = _SortPartition(start, count, stride, comparator);
+            char *right = start + (pivot + 1) * stride;
+            uint64_t rightCount = count - pivot - 1;
+            // The smaller side goes first so the stack stays under log2(n).
+            if (pivot < rightCount) {
+                stack[top].base = right;
+                stack[top].n = rightCount;
+                stack[top].depth = depth;
+                count = pivot;
+            } else {
+                stack[top].base = start;
+                stack[top].n = pivot;
+                stack[top].depth = depth;
+                start = right;
+                count = rightCount;
+            }
+            top++;
+        }
+        if (top == 0) {
+            break;
+        }
+        top--;
+        start = stack[top].base;
+        count = stack[top].n;
+        depth = stack[top].depth;
+    }
+    // Small partitions are left unsorted, elements never move out of them.
+    _SortInsertion(base, n, stride, comparator);
+}
+
+_ALWAYS_INLINE void _SortMerge(char *dest, const char *left, uint64_t leftCount,
+                               const char *right, uint64_t rightCount, size_t stride,
+                               ArrayComparator comparator) {
+    while (leftCount > 0 && rightCount > 0) {
+        if (comparator(right, left) < 0) {
+            _SortCopy(dest, right, stride);
+            right += stride;
+            rightCount--;
+        } else {
+            _SortCopy(dest, left, stride);
+            left += stride;
+            leftCount--;
+        }
+        dest += stride;
+    }
+    memcpy(dest, left, leftCount * stride);
+    memcpy(dest + leftCount * stride, right, rightCount * stride);
+}
+
+// Bottom up, merges between the array and scratch so no pass copies back.
+_ALWAYS_INLINE void _SortStable(char *base, char *scratch, uint64_t n, size_t stride,
+                                ArrayComparator comparator) {
+    for (uint64_t i = 0; i < n; i += SORT_MERGE_RUN) {
+        uint64_t run = n - i < SORT_MERGE_RUN ? n - i : SORT_MERGE_RUN;
+        _SortInsertion(base + i * stride, run, stride, comparator);
+    }
+    char *src = base;
+    char *dest = scratch;
+    for (uint64_t width = SORT_MERGE_RUN; width < n; width *= 2) {
+        for (uint64_t i = 0; i < n; i += width * 2) {
+            uint64_t leftCount = n - i < width ? n - i : width;
+            uint64_t rightCount = n - i - leftCount < width ? n - i - leftCount : width;
+            char *left = src + i * stride;
+            char *right = left + leftCount * stride;
+            if (rightCount == 0 || comparator(right - stride, right) <= 0) {
+                memcpy(dest + i * stride, left, (leftCount + rightCount) * stride);
+            } else {
+                _SortMerge(dest + i * stride, left, leftCount, right, rightCount, stride, comparator);
+            }
+        }
+        char *temp = src;
+        src = dest;
+        dest = temp;
+    }
+    if (src != base) {
+        memcpy(base, src, n * stride);
+    }
+}
+
+void ArraySort(void *array, ArrayComparator comparator) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    if (size < 2) {
+        return;
+    }
+    switch (stride) {
+        case 1: _SortIntro(array, size, 1, comparator); break;
+        case 2: _SortIntro(array, size, 2, comparator); break;
+        case 4: _SortIntro(array, size, 4, comparator); break;
+        case 8: _SortIntro(array, size, 8, comparator); break;
+        case 16: _SortIntro(array, size, 16, comparator); break;
+        default: _SortIntro(array, size, stride, comparator); break;
+    }
+}
+
+void ArrayStableSort(void *array, ArrayComparator comparator) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    if (size <= SORT_MERGE_RUN) {
+        _SortInsertion(array, size, stride, comparator);
+        return;
+    }
+    CUtilsAllocator *allocator = ArrayGetAllocator(array);
+    char *scratch = CUtilsMallocUninitWith(allocator, size * stride);
+    switch (stride) {
+        case 1: _SortStable(array, scratch, size, 1, comparator); break;
+        case 2: _SortStable(array, scratch, size, 2, comparator); break;
+        case 4: _SortStable(array, scratch, size, 4, comparator); break;
+        case 8: _SortStable(array, scratch, size, 8, comparator); break;
+        case 16: _SortStable(array, scratch, size, 16, comparator); break;
+        default: _SortStable(array, scratch, size, stride, comparator); break;
+    }
+    CUtilsFreeWith(allocator, scratch);
+}
+
+static inline size_t _ElementTypeSize(ArrayElementType type) {
+    return (type == ARRAY_ELEMENT_INT32 || type == ARRAY_ELEMENT_UINT32 ||
+            type == ARRAY_ELEMENT_FLOAT)
+               ? 4
+               : 8;
+}
+
+static inline bool _IsFloatType(ArrayElementType type) {
+    return type == ARRAY_ELEMENT_FLOAT || type == ARRAY_ELEMENT_DOUBLE;
+}
+
+_ALWAYS_INLINE uint64_t _NumberLoad(const char *p, size_t width) {
+    if (width == 4) {
+        uint32_t value;
+        memcpy(&value, p, 4);
+        return value;
+    }
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+_ALWAYS_INLINE void _NumberStore(char *p, uint64_t value, size_t width) {
+    if (width == 4) {
+        uint32_t narrow = (uint32_t)value;
+        memcpy(p, &narrow, 4);
+    } else {
+        memcpy(p, &value, 8);
+    }
+}
+
+// Maps the value to an unsigned key with the same order. Signed values
+// flip the sign bit, floats flip every bit when negative.
+static inline uint64_t _OrderKey(uint64_t value, uint64_t sign, ArrayElementType type) {
+    switch (type) {
+        case ARRAY_ELEMENT_INT32:
+        case ARRAY_ELEMENT_INT64:
+            return value ^ sign;
+        case ARRAY_ELEMENT_FLOAT:
+        case ARRAY_ELEMENT_DOUBLE:
+            return value ^ ((value & sign) ? (sign | (sign - 1)) : sign);
+        default:
+            return value;
+    }
+}
+
+static inline uint64_t _OrderUnkey(uint64_t key, uint64_t sign, ArrayElementType type) {
+    switch (type) {
+        case ARRAY_ELEMENT_INT32:
+        case ARRAY_ELEMENT_INT64:
+            return key ^ sign;
+        case ARRAY_ELEMENT_FLOAT:
+        case ARRAY_ELEMENT_DOUBLE:
+            return key ^ ((key & sign) ? sign : (sign | (sign - 1)));
+        default:
+            return key;
+    }
+}
+
+_ALWAYS_INLINE void _RadixScatter(const char *src, char *dest, uint64_t n, size_t width,
+                                  uint32_t shift, uint64_t *offsets) {
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t key = _NumberLoad(src + i * width, width);
+        _NumberStore(dest + offsets[(key >> shift) & 0xFF]++ * width, key, width);
+    }
+}
+
+// One pass turns values into keys and counts every digit, then each digit
+// which doesn't have the same value everywhere scatters once.
+static void _RadixSort(char *base, char *scratch, uint64_t n, size_t width, ArrayElementType type) {
+    uint64_t counts[8][256] = {0};
+    uint32_t digits = (uint32_t)width;
+    uint64_t sign = (uint64_t)1 << (width * 8 - 1);
+    for (uint64_t i = 0; i < n; i++) {
+        char *p = base + i * width;
+        uint64_t key = _OrderKey(_NumberLoad(p, width), sign, type);
+        _NumberStore(p, key, width);
+        for (uint32_t d = 0; d < digits; d++) {
+            counts[d][(key >> (d * 8)) & 0xFF]++;
+        }
+    }
+    char *src = base;
+    char *dest = scratch;
+    for (uint32_t d = 0; d < digits; d++) {
+        uint64_t offsets[256];
+        uint64_t total = 0;
+        bool trivial = false;
+        for (uint32_t b = 0; b < 256; b++) {
+            if (counts[d][b] == n) {
+                trivial = true;
+                break;
+            }
+            offsets[b] = total;
+            total += counts[d][b];
+        }
+        if (trivial) {
+            continue;
+        }
+        if (width == 4) {
+            _RadixScatter(src, dest, n, 4, d * 8, offsets);
+        } else {
+            _RadixScatter(src, dest, n, 8, d * 8, offsets);
+        }
+        char *temp = src;
+        src = dest;
+        dest = temp;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t key = _NumberLoad(src + i * width, width);
+        _NumberStore(base + i * width, _OrderUnkey(key, sign, type), width);
+    }
+}
+
+bool ArrayRadixSort(void *array, ArrayElementType type) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    size_t width = _ElementTypeSize(type);
+    if (stride != width) {
+        DEBUG_LOG_ERROR("ArrayRadixSort: Stride doesn't match the element type. Stride: %lu, Type size: %lu.",
+                        (unsigned long)stride, (unsigned long)width);
+        return false;
+    }
+    if (size < 2) {
+        return true;
+    }
+    CUtilsAllocator *allocator = ArrayGetAllocator(array);
+    char *scratch = CUtilsMallocUninitWith(allocator, size * stride);
+    _RadixSort(array, scratch, size, width, type);
+    CUtilsFreeWith(allocator, scratch);
+    return true;
+}
+
+// Equality is (bits & mask) == pattern, which is == for every type. Float
+// zero ignores the sign bit, NaN returns false since it matches nothing.
+static bool _SearchPattern(ArrayElementType type, const void *value,
+                           uint64_t *outPattern, uint64_t *outMask) {
+    size_t width = _ElementTypeSize(type);
+    uint64_t sign = (uint64_t)1 << (width * 8 - 1);
+    uint64_t all = sign | (sign - 1);
+    uint64_t bits = _NumberLoad((const char *)value, width);
+    *outPattern = bits;
+    *outMask = all;
+    if (_IsFloatType(type)) {
+        uint64_t infinity = width == 4 ? 0x7F800000u : 0x7FF0000000000000u;
+        uint64_t magnitude = bits & (all ^ sign);
+        if (magnitude > infinity) {
+            return false;
+        }
+        if (magnitude == 0) {
+            *outPattern = 0;
+            *outMask = all ^ sign;
+        }
+    }
+    return true;
+}
+
+static uint64_t _FindScalar(const char *base, uint64_t n, size_t stride, size_t width,
+                            uint64_t pattern, uint64_t mask) {
+    for (uint64_t i = 0; i < n; i++) {
+        if ((_NumberLoad(base + i * stride, width) & mask) == pattern) {
+            return i;
+        }
+    }
+    return n;
+}
+
+static uint64_t _CountScalar(const char *base, uint64_t n, size_t stride, size_t width,
+                             uint64_t pattern, uint64_t mask) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        count += (_NumberLoad(base + i * stride, width) & mask) == pattern;
+    }
+    return count;
+}
+
+// Integer sums wrap around in 64 bits, float sums are double.
+static void _SumScalar(const char *base, uint64_t n, size_t stride, ArrayElementType type,
+                       uint64_t *intSum, double *realSum) {
+    uint64_t integer = 0;
+    double real = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        const char *p = base + i * stride;
+        switch (type) {
+            case ARRAY_ELEMENT_INT32: {
+                int32_t value;
+                memcpy(&value, p, 4);
+                integer += (uint64_t)(int64_t)value;
+                break;
+            }
+            case ARRAY_ELEMENT_FLOAT: {
+                float value;
+                memcpy(&value, p, 4);
+                real += value;
+                break;
+            }
+            case ARRAY_ELEMENT_DOUBLE: {
+                double value;
+                memcpy(&value, p, 8);
+                real += value;
+                break;
+            }
+            default:
+                integer += _NumberLoad(p, _ElementTypeSize(type));
+                break;
+        }
+    }
+    *intSum += integer;
+    *realSum += real;
+}
+
+// Min and max are tracked as order keys, NaNs are skipped.
+static void _MinMaxScalar(const char *base, uint64_t n, size_t stride, ArrayElementType type,
+                          uint64_t *minKey, uint64_t *maxKey) {
+    size_t width = _ElementTypeSize(type);
+    uint64_t sign = (uint64_t)1 << (width * 8 - 1);
+    uint64_t infinity = width == 4 ? 0x7F800000u : 0x7FF0000000000000u;
+    bool isFloat = _IsFloatType(type);
+    uint64_t lo = *minKey;
+    uint64_t hi = *maxKey;
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t bits = _NumberLoad(base + i * stride, width);
+        if (isFloat && (bits & (sign - 1)) > infinity) {
+            continue;
+        }
+        uint64_t key = _OrderKey(bits, sign, type);
+        lo = key < lo ? key : lo;
+        hi = key > hi ? key : hi;
+    }
+    *minKey = lo;
+    *maxKey = hi;
+}
+
+#ifdef ARRAY_X86
+__attribute__((target("sse2"))) static uint64_t _Find32SSE2(const void *b, uint64_t n,
+                                                           uint64_t pattern, uint64_t mask) {
+    const uint32_t *p = b;
+    __m128i pv = _mm_set1_epi32((int)pattern);
+    __m128i mv = _mm_set1_epi32((int)mask);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), mv), pv);
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(eq));
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + _FindScalar((const char *)(p + i), n - i, 4, 4, pattern, mask);
+}
+
+// SSE2 has no 64 bit compare, both halves of a lane must match.
+__attribute__((target("sse2"))) static inline __m128i _CmpEq64SSE2(__m128i a, __m128i b) {
+    __m128i eq = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+__attribute__((target("sse2"))) static uint64_t _Find64SSE2(const void *b, uint64_t n,
+                                                           uint64_t pattern, uint64_t mask) {
+    const uint64_t *p = b;
+    __m128i pv = _mm_set1_epi64x((long long)pattern);
+    __m128i mv = _mm_set1_epi64x((long long)mask);
+    uint64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i eq = _CmpEq64SSE2(_mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), mv), pv);
+        int bits = _mm_movemask_pd(_mm_castsi128_pd(eq));
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    return i + _FindScalar((const char *)(p + i), n - i, 8, 8, pattern, mask);
+}
+
+__attribute__((target("sse2"))) static uint64_t _Count32SSE2(const void *b, uint64_t n,
+                                                            uint64_t pattern, uint64_t mask) {
+    const uint32_t *p = b;
+    __m128i pv = _mm_set1_epi32((int)pattern);
+    __m128i mv = _mm_set1_epi32((int)mask);
+    uint64_t count = 0;
+    uint64_t i = 0;
+    while (i + 4 <= n) {
+        // Matches are -1, lanes count in blocks so they never overflow.
+        __m128i acc = _mm_setzero_si128();
+        for (uint32_t k = 0; k < 65536 && i + 4 <= n; k++, i += 4) {
+            __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), mv);
+            acc = _mm_sub_epi32(acc, _mm_cmpeq_epi32(v, pv));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        count += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return count + _CountScalar((const char *)(p + i), n - i, 4, 4, pattern, mask);
+}
+
+__attribute__((target("sse2"))) static uint64_t _Count64SSE2(const void *b, uint64_t n,
+                                                            uint64_t pattern, uint64_t mask) {
+    const uint64_t *p = b;
+    __m128i pv = _mm_set1_epi64x((long long)pattern);
+    __m128i mv = _mm_set1_epi64x((long long)mask);
+    __m128i acc = _mm_setzero_si128();
+    uint64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), mv);
+        acc = _mm_sub_epi64(acc, _CmpEq64SSE2(v, pv));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + _CountScalar((const char *)(p + i), n - i, 8, 8, pattern, mask);
+}
+
+__attribute__((target("sse2"))) static uint64_t _Sum32SSE2(const void *b, uint64_t n, bool isSigned) {
+    const uint32_t *p = b;
+    __m128i signMask = _mm_set1_epi32(isSigned ? -1 : 0);
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i high = _mm_and_si128(_mm_srai_epi32(v, 31), signMask);
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, high));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, high));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    uint64_t sum = lanes[0] + lanes[1];
+    double unused = 0;
+    _SumScalar((const char *)(p + i), n - i, 4,
+               isSigned ? ARRAY_ELEMENT_INT32 : ARRAY_ELEMENT_UINT32, &sum, &unused);
+    return sum;
+}
+
+__attribute__((target("sse2"))) static uint64_t _Sum64SSE2(const void *b, uint64_t n) {
+    const uint64_t *p = b;
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_epi64(acc0, _mm_loadu_si128((const __m128i *)(p + i)));
+        acc1 = _mm_add_epi64(acc1, _mm_loadu_si128((const __m128i *)(p + i + 2)));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    uint64_t sum = lanes[0] + lanes[1];
+    double unused = 0;
+    _SumScalar((const char *)(p + i), n - i, 8, ARRAY_ELEMENT_UINT64, &sum, &unused);
+    return sum;
+}
+
+__attribute__((target("sse2"))) static double _SumFloatSSE2(const void *b, uint64_t n) {
+    const float *p = b;
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(p + i);
+        acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(v));
+        acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double sum = lanes[0] + lanes[1];
+    uint64_t unused = 0;
+    _SumScalar((const char *)(p + i), n - i, 4, ARRAY_ELEMENT_FLOAT, &unused, &sum);
+    return sum;
+}
+
+__attribute__((target("sse2"))) static double _SumDoubleSSE2(const void *b, uint64_t n) {
+    const double *p = b;
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(p + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(p + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    double sum = lanes[0] + lanes[1];
+    uint64_t unused = 0;
+    _SumScalar((const char *)(p + i), n - i, 8, ARRAY_ELEMENT_DOUBLE, &unused, &sum);
+    return sum;
+}
+
+// Min/max kernels cover whole vectors and return how many elements that
+// was, the caller finishes the rest. Unsigned values are biased by the
+// sign bit so signed compares order them.
+__attribute__((target("sse2"))) static uint64_t _MinMax32SSE2(const void *b, uint64_t n, uint64_t bias,
+                                                             void *outMin, void *outMax) {
+    const uint32_t *p = b;
+    __m128i bv = _mm_set1_epi32((int)bias);
+    __m128i lo = _mm_set1_epi32(INT32_MAX);
+    __m128i hi = _mm_set1_epi32(INT32_MIN);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + i)), bv);
+        __m128i less = _mm_cmpgt_epi32(lo, v);
+        __m128i more = _mm_cmpgt_epi32(v, hi);
+        lo = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, lo));
+        hi = _mm_or_si128(_mm_and_si128(more, v), _mm_andnot_si128(more, hi));
+    }
+    int32_t los[4], his[4];
+    _mm_storeu_si128((__m128i *)los, lo);
+    _mm_storeu_si128((__m128i *)his, hi);
+    for (int k = 1; k < 4; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    uint32_t min = (uint32_t)los[0] ^ (uint32_t)bias;
+    uint32_t max = (uint32_t)his[0] ^ (uint32_t)bias;
+    memcpy(outMin, &min, 4);
+    memcpy(outMax, &max, 4);
+    return i;
+}
+
+// MINPS returns the second operand when either is NaN, so NaNs never
+// replace the accumulator.
+__attribute__((target("sse2"))) static uint64_t _MinMaxFloatSSE2(const void *b, uint64_t n, uint64_t bias,
+                                                                void *outMin, void *outMax) {
+    (void)bias;
+    const float *p = b;
+    __m128 lo = _mm_set1_ps(INFINITY);
+    __m128 hi = _mm_set1_ps(-INFINITY);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(p + i);
+        lo = _mm_min_ps(v, lo);
+        hi = _mm_max_ps(v, hi);
+    }
+    float los[4], his[4];
+    _mm_storeu_ps(los, lo);
+    _mm_storeu_ps(his, hi);
+    for (int k = 1; k < 4; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    memcpy(outMin, &los[0], 4);
+    memcpy(outMax, &his[0], 4);
+    return i;
+}
+
+__attribute__((target("sse2"))) static uint64_t _MinMaxDoubleSSE2(const void *b, uint64_t n, uint64_t bias,
+                                                                 void *outMin, void *outMax) {
+    (void)bias;
+    const double *p = b;
+    __m128d lo = _mm_set1_pd(INFINITY);
+    __m128d hi = _mm_set1_pd(-INFINITY);
+    uint64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_loadu_pd(p + i);
+        lo = _mm_min_pd(v, lo);
+        hi = _mm_max_pd(v, hi);
+    }
+    double los[2], his[2];
+    _mm_storeu_pd(los, lo);
+    _mm_storeu_pd(his, hi);
+    los[0] = los[1] < los[0] ? los[1] : los[0];
+    his[0] = his[1] > his[0] ? his[1] : his[0];
+    memcpy(outMin, &los[0], 8);
+    memcpy(outMax, &his[0], 8);
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint64_t _Find32AVX2(const void *b, uint64_t n,
+                                                           uint64_t pattern, uint64_t mask) {
+    const uint32_t *p = b;
+    __m256i pv = _mm256_set1_epi32((int)pattern);
+    __m256i mv = _mm256_set1_epi32((int)mask);
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + i)), mv);
+        int bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, pv)));
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    _mm256_zeroupper();
+    return i + _Find32SSE2(p + i, n - i, pattern, mask);
+}
+
+__attribute__((target("avx2"))) static uint64_t _Find64AVX2(const void *b, uint64_t n,
+                                                           uint64_t pattern, uint64_t mask) {
+    const uint64_t *p = b;
+    __m256i pv = _mm256_set1_epi64x((long long)pattern);
+    __m256i mv = _mm256_set1_epi64x((long long)mask);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + i)), mv);
+        int bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, pv)));
+        if (bits != 0) {
+            return i + __builtin_ctz(bits);
+        }
+    }
+    _mm256_zeroupper();
+    return i + _Find64SSE2(p + i, n - i, pattern, mask);
+}
+
+__attribute__((target("avx2"))) static uint64_t _Count32AVX2(const void *b, uint64_t n,
+                                                            uint64_t pattern, uint64_t mask) {
+    const uint32_t *p = b;
+    __m256i pv = _mm256_set1_epi32((int)pattern);
+    __m256i mv = _mm256_set1_epi32((int)mask);
+    uint64_t count = 0;
+    uint64_t i = 0;
+    while (i + 8 <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        for (uint32_t k = 0; k < 65536 && i + 8 <= n; k++, i += 8) {
+            __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + i)), mv);
+            acc = _mm256_sub_epi32(acc, _mm256_cmpeq_epi32(v, pv));
+        }
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (int k = 0; k < 8; k++) {
+            count += lanes[k];
+        }
+    }
+    _mm256_zeroupper();
+    return count + _Count32SSE2(p + i, n - i, pattern, mask);
+}
+
+__attribute__((target("avx2"))) static uint64_t _Count64AVX2(const void *b, uint64_t n,
+                                                            uint64_t pattern, uint64_t mask) {
+    const uint64_t *p = b;
+    __m256i pv = _mm256_set1_epi64x((long long)pattern);
+    __m256i mv = _mm256_set1_epi64x((long long)mask);
+    __m256i acc = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + i)), mv);
+        acc = _mm256_sub_epi64(acc, _mm256_cmpeq_epi64(v, pv));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    uint64_t count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_zeroupper();
+    return count + _Count64SSE2(p + i, n - i, pattern, mask);
+}
+
+__attribute__((target("avx2"))) static uint64_t _Sum32AVX2(const void *b, uint64_t n, bool isSigned) {
+    const uint32_t *p = b;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    uint64_t i = 0;
+    if (isSigned) {
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(p + i))));
+            acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(p + i + 4))));
+        }
+    } else {
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_epi64(acc0, _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(p + i))));
+            acc1 = _mm256_add_epi64(acc1, _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(p + i + 4))));
+        }
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_zeroupper();
+    return sum + _Sum32SSE2(p + i, n - i, isSigned);
+}
+
+__attribute__((target("avx2"))) static uint64_t _Sum64AVX2(const void *b, uint64_t n) {
+    const uint64_t *p = b;
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i *)(p + i)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i *)(p + i + 4)));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_zeroupper();
+    return sum + _Sum64SSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) static double _SumFloatAVX2(const void *b, uint64_t n) {
+    const float *p = b;
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm_loadu_ps(p + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm_loadu_ps(p + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_zeroupper();
+    return sum + _SumFloatSSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) static double _SumDoubleAVX2(const void *b, uint64_t n) {
+    const double *p = b;
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(p + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(p + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(acc0, acc1));
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_zeroupper();
+    return sum + _SumDoubleSSE2(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) static uint64_t _MinMax32AVX2(const void *b, uint64_t n, uint64_t bias,
+                                                             void *outMin, void *outMax) {
+    const uint32_t *p = b;
+    __m256i bv = _mm256_set1_epi32((int)bias);
+    __m256i lo = _mm256_set1_epi32(INT32_MAX);
+    __m256i hi = _mm256_set1_epi32(INT32_MIN);
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i)), bv);
+        lo = _mm256_min_epi32(lo, v);
+        hi = _mm256_max_epi32(hi, v);
+    }
+    int32_t los[8], his[8];
+    _mm256_storeu_si256((__m256i *)los, lo);
+    _mm256_storeu_si256((__m256i *)his, hi);
+    for (int k = 1; k < 8; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    uint32_t min = (uint32_t)los[0] ^ (uint32_t)bias;
+    uint32_t max = (uint32_t)his[0] ^ (uint32_t)bias;
+    memcpy(outMin, &min, 4);
+    memcpy(outMax, &max, 4);
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint64_t _MinMax64AVX2(const void *b, uint64_t n, uint64_t bias,
+                                                             void *outMin, void *outMax) {
+    const uint64_t *p = b;
+    __m256i bv = _mm256_set1_epi64x((long long)bias);
+    __m256i lo = _mm256_set1_epi64x(INT64_MAX);
+    __m256i hi = _mm256_set1_epi64x(INT64_MIN);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(p + i)), bv);
+        lo = _mm256_blendv_epi8(lo, v, _mm256_cmpgt_epi64(lo, v));
+        hi = _mm256_blendv_epi8(hi, v, _mm256_cmpgt_epi64(v, hi));
+    }
+    int64_t los[4], his[4];
+    _mm256_storeu_si256((__m256i *)los, lo);
+    _mm256_storeu_si256((__m256i *)his, hi);
+    for (int k = 1; k < 4; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    uint64_t min = (uint64_t)los[0] ^ bias;
+    uint64_t max = (uint64_t)his[0] ^ bias;
+    memcpy(outMin, &min, 8);
+    memcpy(outMax, &max, 8);
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint64_t _MinMaxFloatAVX2(const void *b, uint64_t n, uint64_t bias,
+                                                                void *outMin, void *outMax) {
+    (void)bias;
+    const float *p = b;
+    __m256 lo = _mm256_set1_ps(INFINITY);
+    __m256 hi = _mm256_set1_ps(-INFINITY);
+    uint64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(p + i);
+        lo = _mm256_min_ps(v, lo);
+        hi = _mm256_max_ps(v, hi);
+    }
+    float los[8], his[8];
+    _mm256_storeu_ps(los, lo);
+    _mm256_storeu_ps(his, hi);
+    for (int k = 1; k < 8; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    memcpy(outMin, &los[0], 4);
+    memcpy(outMax, &his[0], 4);
+    return i;
+}
+
+__attribute__((target("avx2"))) static uint64_t _MinMaxDoubleAVX2(const void *b, uint64_t n, uint64_t bias,
+                                                                 void *outMin, void *outMax) {
+    (void)bias;
+    const double *p = b;
+    __m256d lo = _mm256_set1_pd(INFINITY);
+    __m256d hi = _mm256_set1_pd(-INFINITY);
+    uint64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_loadu_pd(p + i);
+        lo = _mm256_min_pd(v, lo);
+        hi = _mm256_max_pd(v, hi);
+    }
+    double los[4], his[4];
+    _mm256_storeu_pd(los, lo);
+    _mm256_storeu_pd(his, hi);
+    for (int k = 1; k < 4; k++) {
+        los[0] = los[k] < los[0] ? los[k] : los[0];
+        his[0] = his[k] > his[0] ? his[k] : his[0];
+    }
+    memcpy(outMin, &los[0], 8);
+    memcpy(outMax, &his[0], 8);
+    return i;
+}
+#endif  // ARRAY_X86
+
+typedef uint64_t (*_SearchKernel)(const void *b, uint64_t n, uint64_t pattern, uint64_t mask);
+typedef uint64_t (*_MinMaxKernel)(const void *b, uint64_t n, uint64_t bias, void *outMin, void *outMax);
+
+typedef struct _ArrayKernels {
+    _SearchKernel find32;
+    _SearchKernel find64;
+    _SearchKernel count32;
+    _SearchKernel count64;
+    uint64_t (*sum32)(const void *b, uint64_t n, bool isSigned);
+    uint64_t (*sum64)(const void *b, uint64_t n);
+    double (*sumFloat)(const void *b, uint64_t n);
+    double (*sumDouble)(const void *b, uint64_t n);
+    _MinMaxKernel minMax32;
+    _MinMaxKernel minMax64;  // NULL if there is no 64 bit compare
+    _MinMaxKernel minMaxFloat;
+    _MinMaxKernel minMaxDouble;
+} _ArrayKernels;
+
+#ifdef ARRAY_X86
+static const _ArrayKernels _SSE2Kernels = {
+    _Find32SSE2, _Find64SSE2, _Count32SSE2, _Count64SSE2,
+    _Sum32SSE2, _Sum64SSE2, _SumFloatSSE2, _SumDoubleSSE2,
+    _MinMax32SSE2, NULL, _MinMaxFloatSSE2, _MinMaxDoubleSSE2};
+static const _ArrayKernels _AVX2Kernels = {
+    _Find32AVX2, _Find64AVX2, _Count32AVX2, _Count64AVX2,
+    _Sum32AVX2, _Sum64AVX2, _SumFloatAVX2, _SumDoubleAVX2,
+    _MinMax32AVX2, _MinMax64AVX2, _MinMaxFloatAVX2, _MinMaxDoubleAVX2};
+#endif
+
+// Vector kernels follow the memory backend and need contiguous numbers,
+// NULL means the scalar loops.
+static const _ArrayKernels *_KernelsFor(uint64_t stride, size_t width) {
+#ifdef ARRAY_X86
+    if (stride == width) {
+        switch (MemoryGetBackend()) {
+            case MEMORY_BACKEND_AVX2:
+                return &_AVX2Kernels;
+            case MEMORY_BACKEND_SSE2:
+                return &_SSE2Kernels;
+            default:
+                break;
+        }
+    }
+#endif
+    return NULL;
+}
+
+// Returns the size of the type, 0 if the elements can't hold it.
+static size_t _CheckElementType(const void *array, ArrayElementType type, const char *caller) {
+    (void)caller;
+    size_t width = _ElementTypeSize(type);
+    if (ArrayGetStride(array) < width) {
+        DEBUG_LOG_ERROR("%s: Stride is smaller than the element type. Stride: %lu, Type size: %lu.",
+                        caller, (unsigned long)ArrayGetStride(array), (unsigned long)width);
+        return 0;
+    }
+    return width;
+}
+
+static uint64_t _FindFrom(const void *array, uint64_t start, size_t width,
+                          uint64_t pattern, uint64_t mask) {
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    const char *base = (const char *)array + start * stride;
+    const _ArrayKernels *kernels = _KernelsFor(stride, width);
+    if (kernels) {
+        _SearchKernel find = width == 4 ? kernels->find32 : kernels->find64;
+        return start + find(base, size - start, pattern, mask);
+    }
+    return start + _FindScalar(base, size - start, stride, width, pattern, mask);
+}
+
+bool ArrayFind(const void *array, ArrayElementType type, const void *value, uint64_t *outIndex) {
+    size_t width = _CheckElementType(array, type, "ArrayFind");
+    uint64_t pattern, mask;
+    if (width == 0 || !_SearchPattern(type, value, &pattern, &mask)) {
+        return false;
+    }
+    uint64_t index = _FindFrom(array, 0, width, pattern, mask);
+    if (index >= ArrayGetSize(array)) {
+        return false;
+    }
+    if (outIndex) {
+        *outIndex = index;
+    }
+    return true;
+}
+
+uint64_t *ArrayFindAll(const void *array, ArrayElementType type, const void *value) {
+    uint64_t *indices = _ArrayCreateWithAllocator(sizeof(uint64_t), 1, ArrayGetAllocator(array));
+    size_t width = _CheckElementType(array, type, "ArrayFindAll");
+    uint64_t pattern, mask;
+    if (width == 0 || !_SearchPattern(type, value, &pattern, &mask)) {
+        return indices;
+    }
+    uint64_t size = ArrayGetSize(array);
+    for (uint64_t i = _FindFrom(array, 0, width, pattern, mask); i < size;
+         i = _FindFrom(array, i + 1, width, pattern, mask)) {
+        ArrayPush(indices, i);
+    }
+    return indices;
+}
+
+uint64_t ArrayCount(const void *array, ArrayElementType type, const void *value) {
+    size_t width = _CheckElementType(array, type, "ArrayCount");
+    uint64_t pattern, mask;
+    if (width == 0 || !_SearchPattern(type, value, &pattern, &mask)) {
+        return 0;
+    }
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    const _ArrayKernels *kernels = _KernelsFor(stride, width);
+    if (kernels) {
+        _SearchKernel count = width == 4 ? kernels->count32 : kernels->count64;
+        return count(array, size, pattern, mask);
+    }
+    return _CountScalar(array, size, stride, width, pattern, mask);
+}
+
+bool ArraySum(const void *array, ArrayElementType type, void *outSum) {
+    size_t width = _CheckElementType(array, type, "ArraySum");
+    if (width == 0) {
+        return false;
+    }
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    const _ArrayKernels *kernels = _KernelsFor(stride, width);
+    uint64_t intSum = 0;
+    double realSum = 0;
+    if (kernels) {
+        switch (type) {
+            case ARRAY_ELEMENT_INT32:
+            case ARRAY_ELEMENT_UINT32:
+                intSum = kernels->sum32(array, size, type == ARRAY_ELEMENT_INT32);
+                break;
+            case ARRAY_ELEMENT_FLOAT:
+                realSum = kernels->sumFloat(array, size);
+                break;
+            case ARRAY_ELEMENT_DOUBLE:
+                realSum = kernels->sumDouble(array, size);
+                break;
+            default:
+                intSum = kernels->sum64(array, size);
+                break;
+        }
+    } else {
+        _SumScalar(array, size, stride, type, &intSum, &realSum);
+    }
+    if (_IsFloatType(type)) {
+        memcpy(outSum, &realSum, sizeof(realSum));
+    } else {
+        memcpy(outSum, &intSum, sizeof(intSum));
+    }
+    return true;
+}
+
+bool ArrayMinMax(const void *array, ArrayElementType type, void *outMin, void *outMax) {
+    size_t width = _CheckElementType(array, type, "ArrayMinMax");
+    if (width == 0) {
+        return false;
+    }
+    uint64_t size = ArrayGetSize(array);
+    uint64_t stride = ArrayGetStride(array);
+    uint64_t sign = (uint64_t)1 << (width * 8 - 1);
+    uint64_t minKey = UINT64_MAX;
+    uint64_t maxKey = 0;
+    uint64_t start = 0;
+    const _ArrayKernels *kernels = _KernelsFor(stride, width);
+    if (kernels) {
+        _MinMaxKernel minMax = NULL;
+        uint64_t bias = 0;
+        switch (type) {
+            case ARRAY_ELEMENT_UINT32:
+                bias = sign;
+                // fall through
+            case ARRAY_ELEMENT_INT32:
+                minMax = kernels->minMax32;
+                break;
+            case ARRAY_ELEMENT_UINT64:
+                bias = sign;
+                // fall through
+            case ARRAY_ELEMENT_INT64:
+                minMax = kernels->minMax64;
+                break;
+            case ARRAY_ELEMENT_FLOAT:
+                minMax = kernels->minMaxFloat;
+                break;
+            case ARRAY_ELEMENT_DOUBLE:
+                minMax = kernels->minMaxDouble;
+                break;
+        }
+        uint64_t lo = 0, hi = 0;
+        if (minMax) {
+            start = minMax(array, size, bias, &lo, &hi);
+        }
+        if (start > 0) {
+            minKey = _OrderKey(_NumberLoad((const char *)&lo, width), sign, type);
+            maxKey = _OrderKey(_NumberLoad((const char *)&hi, width), sign, type);
+        }
+    }
+    _MinMaxScalar((const char *)array + start * stride, size - start, stride, type, &minKey, &maxKey);
+    // Nothing but NaNs leaves the float kernels at +inf and -inf.
+    if (minKey > maxKey) {
+        return false;
+    }
+    if (outMin) {
+        _NumberStore(outMin, _OrderUnkey(minKey, sign, type), width);
+    }
+    if (outMax) {
+        _NumberStore(outMax, _OrderUnkey(maxKey, sign, type), width);
+    }
+    return true;
+}
+
+bool ArrayMin(const void *array, ArrayElementType type, void *outMin) {
+    return ArrayMinMax(array, type, outMin, NULL);
+}
+
+bool ArrayMax(const void *array, ArrayElementType type, void *outMax) {
+    return ArrayMinMax(array, type, NULL, outMax);
 }
 
 void ArraySetValue(void *array, void *value, uint64_t index) {
@@ -200,6 +1676,37 @@ uint64_t ArrayGetStride(const void *array) {
     return _FieldGet(array, STRIDE);
 }
 
+CUtilsAllocator *ArrayGetAllocator(const void *array) {
+    return (CUtilsAllocator *)(uintptr_t)_FieldGet(array, ALLOCATOR);
+}
+
+size_t ArrayGetAlignment(const void *array) {
+    return (size_t)_FieldGet(array, ALIGNMENT);
+}
+
+bool ArrayIsInline(const void *array) {
+    return (_FieldGet(array, OFFSET) & OFFSET_INLINE) != 0;
+}
+
+void ArraySetGrowthPolicy(void *array, ArrayGrowthPolicy policy) {
+    if (!(policy.growthFactor > 1.0f)) {
+        DEBUG_LOG_ERROR("ArraySetGrowthPolicy: Growth factor must be bigger than 1, given: %f.",
+                        (double)policy.growthFactor);
+        return;
+    }
+    _PolicySet(array, policy);
+}
+
+ArrayGrowthPolicy ArrayGetGrowthPolicy(const void *array) {
+    uint64_t growth = _FieldGet(array, GROWTH);
+    uint32_t factorBits = (uint32_t)growth;
+    ArrayGrowthPolicy policy;
+    memcpy(&policy.growthFactor, &factorBits, sizeof(factorBits));
+    policy.shrinkDivisor = (uint32_t)(growth >> 32);
+    policy.minCapacity = _FieldGet(array, MIN_CAPACITY);
+    return policy;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,14 +15,22 @@ extern "C" {
 #endif
 
 // PRIVATE BEGIN
+// Numbers, floats and bools are stored right after the pair, so they
+// don't need a second allocation.
+#define DICT_PAIR_SIZE (sizeof(DictPair) + sizeof(int64_t))
+
+static inline void* _InlineValue(DictPair* pair) {
+    return pair + 1;
+}
+
 static void _FreePairValue(Dictionary* dict, DictPair* pair) {
-    if (pair->value) {
+    if (pair->value && pair->value != _InlineValue(pair)) {
         if (pair->valueType == DATA_TYPE_LIST) {
             ListFree(pair->value);
         } else if (pair->valueType == DATA_TYPE_OBJECT) {
             DictionaryFree(pair->value);
         } else {
-            CUtilsFree(pair->value);
+            CUtilsFreeWith(ArrayGetAllocator(dict->data), pair->value);
         }
     }
     pair->value = NULL;
@@ -31,29 +39,30 @@ static void _FreePairValue(Dictionary* dict, DictPair* pair) {
 
 void _DictionarySetPairValue(Dictionary* dict, DictPair* pair,
                              CUtilsDataType valueType, void* value) {
+    CUtilsAllocator* allocator = ArrayGetAllocator(dict->data);
     pair->valueType = valueType;
     switch (valueType) {
         case DATA_TYPE_STRING:
-            pair->value = CUtilsMalloc(strlen(value) + 1);
+            pair->value = CUtilsMallocUninitWith(allocator, strlen(value) + 1);
             memcpy(pair->value, value, strlen(value) + 1);
             break;
         case DATA_TYPE_NUMBER:
-            pair->value = CUtilsMalloc(sizeof(int64_t));
+            pair->value = _InlineValue(pair);
             memcpy(pair->value, value, sizeof(int64_t));
             break;
         case DATA_TYPE_FLOAT:
-            pair->value = CUtilsMalloc(sizeof(float));
+            pair->value = _InlineValue(pair);
             memcpy(pair->value, value, sizeof(float));
             break;
         case DATA_TYPE_BOOL:
-            pair->value = CUtilsMalloc(sizeof(bool));
+            pair->value = _InlineValue(pair);
             memcpy(pair->value, value, sizeof(bool));
             break;
         case DATA_TYPE_LIST:
-            pair->value = ListCopy(value);
+            pair->value = ListCopyWithAllocator(value, allocator);
             break;
         case DATA_TYPE_OBJECT:
-            pair->value = DictionaryCopy(value);
+            pair->value = DictionaryCopyWithAllocator(value, allocator);
             break;
         default:
             pair->value = NULL;
@@ -63,22 +72,40 @@ void _DictionarySetPairValue(Dictionary* dict, DictPair* pair,
 
 DictPair* _DictionaryCreatePair(Dictionary* dict, char* key,
                                 CUtilsDataType valueType, void* value) {
-    DictPair* pair = CUtilsMalloc(sizeof(DictPair));
-    pair->key = CUtilsMalloc(strlen(key) + 1);
+    CUtilsAllocator* allocator = ArrayGetAllocator(dict->data);
+    DictPair* pair = CUtilsNodeMalloc(allocator, DICT_PAIR_SIZE);
+    pair->key = CUtilsMallocUninitWith(allocator, strlen(key) + 1);
     memcpy(pair->key, key, strlen(key) + 1);
     _DictionarySetPairValue(dict, pair, valueType, value);
     return pair;
 }
+// Small dictionaries keep their first elements right after the Dictionary struct,
+// so creating one is a single allocation.
+#define DICTIONARY_INLINE_CAPACITY 8
+
+typedef struct _DictionaryBlock {
+    Dictionary dict;
+    ArrayInlineStorage(uint64_t, DICTIONARY_INLINE_CAPACITY) storage;
+} _DictionaryBlock;
 // PRIVATE END
 
 Dictionary* DictionaryCreate() {
-    Dictionary* dict = CUtilsMalloc(sizeof(Dictionary));
-    dict->data = ArrayCreate(uint64_t);
-    return dict;
+    return DictionaryCreateWithAllocator(NULL);
+}
+
+Dictionary* DictionaryCreateWithAllocator(CUtilsAllocator* allocator) {
+    _DictionaryBlock* block = CUtilsMallocUninitWith(allocator, sizeof(_DictionaryBlock));
+    block->dict.data = _ArrayCreateInline(&block->storage, sizeof(block->storage),
+                                          sizeof(uint64_t), allocator);
+    return &block->dict;
 }
 
 Dictionary* DictionaryCopy(Dictionary* dict) {
-    Dictionary* cpy = DictionaryCreate();
+    return DictionaryCopyWithAllocator(dict, NULL);
+}
+
+Dictionary* DictionaryCopyWithAllocator(Dictionary* dict, CUtilsAllocator* allocator) {
+    Dictionary* cpy = DictionaryCreateWithAllocator(allocator);
     for (uint64_t i = 0; i < ArrayGetSize(dict->data); i++) {
         DictPair* pair = (DictPair*)dict->data[i];
         DictionarySet(cpy, pair->key, pair->valueType, pair->value);
@@ -87,20 +114,29 @@ Dictionary* DictionaryCopy(Dictionary* dict) {
 }
 
 void DictionaryFree(Dictionary* dict) {
+    CUtilsAllocator* allocator = ArrayGetAllocator(dict->data);
+    if (!CUtilsAllocatorCanFree(allocator)) {
+        // Everything is released with the allocator.
+        return;
+    }
     for (uint64_t i = 0; i < ArrayGetSize(dict->data); i++) {
         DictPair* pair = (DictPair*)dict->data[i];
         DictionaryFreePair(dict, pair);
     }
     ArrayFree(dict->data);
-    CUtilsFree(dict);
+    CUtilsFreeWith(allocator, dict);
 }
 
 void DictionaryFreePair(Dictionary* dict, DictPair* pair) {
+    CUtilsAllocator* allocator = ArrayGetAllocator(dict->data);
+    if (!CUtilsAllocatorCanFree(allocator)) {
+        return;
+    }
     if (pair->key) {
-        CUtilsFree(pair->key);
+        CUtilsFreeWith(allocator, pair->key);
     }
     _FreePairValue(dict, pair);
-    CUtilsFree(pair);
+    CUtilsNodeFree(allocator, pair, DICT_PAIR_SIZE);
 }
 
 DictPair* DictionaryGet(Dictionary* dict, char* key) {
@@ -136,7 +172,7 @@ void DictionaryRemove(Dictionary* dict, char* key) {
         DictPair* pair = (DictPair*)dict->data[i];
         if (pair->key && strcmp(pair->key, key) == 0) {
             DictionaryFreePair(dict, pair);
-            CUtilsFree(ArrayPopAt(dict->data, i));
+            ArrayDiscardAt(dict->data, i);
             return;
         }
     }
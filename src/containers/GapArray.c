@@ -0,0 +1,168 @@
+#include "containers/GapArray.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Debug.h"
+#include "MemoryUtils.h"
+#include "containers/Array.h"
+
+#define GARR_DEFAULT_CAPACITY 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PRIVATE BEGIN
+static inline uint64_t _GapLength(const GapArray* garr) {
+    return garr->gapEnd - garr->gapStart;
+}
+
+static inline uint8_t* _Element(const GapArray* garr, uint64_t index) {
+    if (index >= garr->gapStart) {
+        index += _GapLength(garr);
+    }
+    return garr->data + index * garr->stride;
+}
+
+static inline void _RaiseIndexOutOfBounds(const GapArray* garr, uint64_t index) {
+    (void)garr;
+    (void)index;
+    DEBUG_LOG_ERROR("Index out of bounds. Index: %lu, GapArray Size: %lu.",
+                    (unsigned long)index, (unsigned long)GapArrayGetSize(garr));
+    RAISE_SIGSEGV;
+}
+
+// Doubles the capacity until the gap holds length elements. The elements
+// after the gap move to the end of the new capacity.
+static void _GrowGap(GapArray* garr, uint64_t length) {
+    uint64_t newCapacity = garr->capacity;
+    uint64_t size = GapArrayGetSize(garr);
+    while (newCapacity - size < length) {
+        newCapacity *= 2;
+    }
+    uint64_t tail = garr->capacity - garr->gapEnd;
+    garr->data = CUtilsReallocWith(garr->allocator, garr->data, newCapacity * garr->stride);
+    memmove(garr->data + (newCapacity - tail) * garr->stride,
+            garr->data + garr->gapEnd * garr->stride,
+            tail * garr->stride);
+    garr->gapEnd = newCapacity - tail;
+    garr->capacity = newCapacity;
+}
+// PRIVATE END
+
+GapArray* GapArrayCreate(size_t stride) {
+    return GapArrayCreateWithAllocator(stride, NULL);
+}
+
+GapArray* GapArrayCreateWithAllocator(size_t stride, CUtilsAllocator* allocator) {
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    GapArray* garr = CUtilsMallocWith(allocator, sizeof(GapArray));
+    garr->stride = stride;
+    garr->allocator = allocator;
+    garr->capacity = GARR_DEFAULT_CAPACITY;
+    garr->gapStart = 0;
+    garr->gapEnd = garr->capacity;
+    garr->data = CUtilsMallocUninitWith(allocator, garr->capacity * stride);
+    return garr;
+}
+
+void GapArrayFree(GapArray* garr) {
+    if (garr == NULL || !CUtilsAllocatorCanFree(garr->allocator)) {
+        return;
+    }
+    CUtilsFreeWith(garr->allocator, garr->data);
+    CUtilsFreeWith(garr->allocator, garr);
+}
+
+void GapArrayClear(GapArray* garr) {
+    garr->gapStart = 0;
+    garr->gapEnd = garr->capacity;
+}
+
+uint64_t GapArrayGetSize(const GapArray* garr) {
+    return garr->capacity - _GapLength(garr);
+}
+
+uint64_t GapArrayGetCursor(const GapArray* garr) {
+    return garr->gapStart;
+}
+
+void GapArraySetCursor(GapArray* garr, uint64_t index) {
+    uint64_t size = GapArrayGetSize(garr);
+    if (index > size) {
+        index = size;
+    }
+    uint64_t gap = _GapLength(garr);
+    if (index < garr->gapStart) {
+        // Elements between the index and the cursor go to the end of the gap.
+        uint64_t count = garr->gapStart - index;
+        memmove(garr->data + (garr->gapEnd - count) * garr->stride,
+                garr->data + index * garr->stride,
+                count * garr->stride);
+    } else if (index > garr->gapStart) {
+        uint64_t count = index - garr->gapStart;
+        memmove(garr->data + garr->gapStart * garr->stride,
+                garr->data + garr->gapEnd * garr->stride,
+                count * garr->stride);
+    }
+    garr->gapStart = index;
+    garr->gapEnd = index + gap;
+}
+
+void GapArrayInsert(GapArray* garr, const void* buffer, uint64_t length) {
+    if (_GapLength(garr) < length) {
+        _GrowGap(garr, length);
+    }
+    memcpy(garr->data + garr->gapStart * garr->stride, buffer, length * garr->stride);
+    garr->gapStart += length;
+}
+
+uint64_t GapArrayDelete(GapArray* garr, uint64_t length) {
+    uint64_t after = garr->capacity - garr->gapEnd;
+    if (length > after) {
+        length = after;
+    }
+    garr->gapEnd += length;
+    return length;
+}
+
+uint64_t GapArrayBackspace(GapArray* garr, uint64_t length) {
+    if (length > garr->gapStart) {
+        length = garr->gapStart;
+    }
+    garr->gapStart -= length;
+    return length;
+}
+
+void* GapArrayGetValue(const GapArray* garr, uint64_t index) {
+    if (index >= GapArrayGetSize(garr)) {
+        _RaiseIndexOutOfBounds(garr, index);
+        return NULL;
+    }
+    return _Element(garr, index);
+}
+
+void GapArraySetValue(GapArray* garr, const void* value, uint64_t index) {
+    if (index >= GapArrayGetSize(garr)) {
+        _RaiseIndexOutOfBounds(garr, index);
+        return;
+    }
+    memcpy(_Element(garr, index), value, garr->stride);
+}
+
+void* GapArrayLinearize(const GapArray* garr) {
+    uint64_t size = GapArrayGetSize(garr);
+    void* array = _ArrayCreateWithAllocator(garr->stride, size ? size : 1, garr->allocator);
+    ArrayInsert(array, garr->data, garr->gapStart);
+    ArrayInsert(array, garr->data + garr->gapEnd * garr->stride, garr->capacity - garr->gapEnd);
+    return array;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,156 +8,221 @@
 #include "Debug.h"
 #include "Hash.h"
 #include "MemoryUtils.h"
-#include "containers/Array.h"
-#include "containers/UniqueArray.h"
 
+// Capacity must be a power of two.
 #define HMAP_DEFAULT_CAPACITY 64
+#define HMAP_MAX_LOAD_PERCENT 80
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // PRIVATE BEGIN
+// Node is a single allocation which holds the value and the key:
+// [_HashNode][value (stride bytes)][key (keyLength + 1 bytes)]
 typedef struct {
-    uint64_t hash;
-    void* value;
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-    char* key;
-#endif
+    uint64_t keyLength;
 } _HashNode;
 
-static uint64_t _Hash(const char* key) {
-    return Hash_64(key, strlen(key));
+// Slot is empty if node is NULL.
+typedef struct {
+    uint64_t hash;
+    _HashNode* node;
+} _HashSlot;
+
+static uint64_t _Hash(HashMap* hmap, const char* key, uint64_t keyLength) {
+    return Hash_WY_64(key, keyLength, hmap->seed);
 }
 
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-static void _CheckCollision(HashMap* hmap, const char* key1, const char* key2) {
-    if (strcmp(key1, key2) != 0) {
-        DEBUG_LOG_ERROR("Collision! (Key: %s, Hash: %I64u), (Key: %s, Hash: %I64u) Please open issue.",
-                        key1, _Hash(key1), key2, _Hash(key2));
-        DEBUG_LOG_INFO("HashMap size: %I64u", UniqueArrayGetSize(hmap->data));
-        HashMapFree(hmap);
-        RAISE_SIGSEGV;
-    }
+static inline void* _NodeValue(_HashNode* node) {
+    return (char*)(node + 1);
 }
-#endif
 
-static _HashNode* _CreateNode(const char* key, void* value, size_t stride) {
-    _HashNode* node = CUtilsMalloc(sizeof(_HashNode));
-    node->hash = _Hash(key);
-    node->value = CUtilsMalloc(stride);
-    memcpy(node->value, value, stride);
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-    node->key = CUtilsMalloc(strlen(key) + 1);
-    memcpy(node->key, key, strlen(key) + 1);
-#endif
+static inline char* _NodeKey(HashMap* hmap, _HashNode* node) {
+    return (char*)(node + 1) + hmap->stride;
+}
+
+static inline size_t _NodeSize(HashMap* hmap, uint64_t keyLength) {
+    return sizeof(_HashNode) + hmap->stride + keyLength + 1;
+}
+
+static _HashNode* _CreateNode(HashMap* hmap, const char* key, uint64_t keyLength, void* value) {
+    _HashNode* node = CUtilsNodeMalloc(hmap->allocator, _NodeSize(hmap, keyLength));
+    node->keyLength = keyLength;
+    memcpy(_NodeValue(node), value, hmap->stride);
+    memcpy(_NodeKey(hmap, node), key, keyLength + 1);
     return node;
 }
 
-static inline void _DeleteNode(_HashNode* node) {
-    CUtilsFree(node->value);
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-    CUtilsFree(node->key);
-#endif
-    CUtilsFree(node);
+static inline bool _NodeKeyEquals(HashMap* hmap, _HashNode* node, const char* key, uint64_t keyLength) {
+    return node->keyLength == keyLength &&
+           memcmp(_NodeKey(hmap, node), key, keyLength) == 0;
+}
+
+// Returns how far the slot at index is from its ideal position.
+static inline uint64_t _ProbeDistance(HashMap* hmap, uint64_t hash, uint64_t index) {
+    return (index - (hash & (hmap->capacity - 1))) & (hmap->capacity - 1);
 }
 
-static int _HashNodeComparator(const void* k1, const void* k2) {
-    const uint64_t v1 = ((_HashNode*)*(uint64_t*)k1)->hash;
-    const uint64_t v2 = ((_HashNode*)*(uint64_t*)k2)->hash;
-    if (v1 < v2) {
-        return -1;
-    } else if (v1 > v2) {
-        return 1;
+// Robin hood insertion. The key must not be in the table and
+// the table must have at least one empty slot.
+static void _InsertNode(HashMap* hmap, uint64_t hash, _HashNode* node) {
+    _HashSlot* slots = hmap->slots;
+    uint64_t mask = hmap->capacity - 1;
+    uint64_t index = hash & mask;
+    uint64_t distance = 0;
+    while (true) {
+        _HashSlot* slot = slots + index;
+        if (slot->node == NULL) {
+            slot->hash = hash;
+            slot->node = node;
+            hmap->size++;
+            return;
+        }
+        uint64_t slotDistance = _ProbeDistance(hmap, slot->hash, index);
+        if (slotDistance < distance) {
+            // Take the slot from richer node and continue with it.
+            uint64_t tempHash = slot->hash;
+            _HashNode* tempNode = slot->node;
+            slot->hash = hash;
+            slot->node = node;
+            hash = tempHash;
+            node = tempNode;
+            distance = slotDistance;
+        }
+        index = (index + 1) & mask;
+        distance++;
     }
-    return 0;
 }
 
-static int _HashComparator(const void* k1, const void* k2) {
-    const uint64_t v1 = ((_HashNode*)*(uint64_t*)k1)->hash;  // k1 is always array value
-    const uint64_t v2 = *(uint64_t*)k2;                      // k2 is always value
-    if (v1 < v2) {
-        return -1;
-    } else if (v1 > v2) {
-        return 1;
+static void _Rehash(HashMap* hmap, uint64_t newCapacity) {
+    _HashSlot* oldSlots = hmap->slots;
+    uint64_t oldCapacity = hmap->capacity;
+    hmap->slots = CUtilsMallocWith(hmap->allocator, newCapacity * sizeof(_HashSlot));
+    hmap->capacity = newCapacity;
+    hmap->size = 0;
+    for (uint64_t i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i].node) {
+            _InsertNode(hmap, oldSlots[i].hash, oldSlots[i].node);
+        }
     }
-    return 0;
+    CUtilsFreeWith(hmap->allocator, oldSlots);
 }
 
-static bool _FindHash(HashMap* hmap, const char* key, uint64_t* outIndex) {
-    hmap->data->comparator = _HashComparator;
-    uint64_t hash = _Hash(key);
-    bool contains = UniqueArrayContains(hmap->data, &hash, outIndex);
-    hmap->data->comparator = _HashNodeComparator;
-    return contains;
+static _HashSlot* _FindSlot(HashMap* hmap, const char* key, uint64_t keyLength, uint64_t hash) {
+    _HashSlot* slots = hmap->slots;
+    uint64_t mask = hmap->capacity - 1;
+    uint64_t index = hash & mask;
+    uint64_t distance = 0;
+    while (true) {
+        _HashSlot* slot = slots + index;
+        // Robin hood invariant: the key would be placed before any
+        // node which is closer to its ideal position.
+        if (slot->node == NULL || _ProbeDistance(hmap, slot->hash, index) < distance) {
+            return NULL;
+        }
+        if (slot->hash == hash && _NodeKeyEquals(hmap, slot->node, key, keyLength)) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+// Backward shift deletion, no tombstones.
+static void _RemoveSlot(HashMap* hmap, _HashSlot* slot) {
+    _HashSlot* slots = hmap->slots;
+    uint64_t mask = hmap->capacity - 1;
+    uint64_t index = slot - slots;
+    while (true) {
+        uint64_t next = (index + 1) & mask;
+        if (slots[next].node == NULL || _ProbeDistance(hmap, slots[next].hash, next) == 0) {
+            slots[index].node = NULL;
+            slots[index].hash = 0;
+            break;
+        }
+        slots[index] = slots[next];
+        index = next;
+    }
+    hmap->size--;
 }
 // PRIVATE END
 
 HashMap* HashMapCreate(size_t stride) {
-    HashMap* hmap = CUtilsMalloc(sizeof(HashMap));
-    hmap->data = UniqueArrayCreate(sizeof(uint64_t),
-                                   HMAP_DEFAULT_CAPACITY,
-                                   _HashNodeComparator);
+    return HashMapCreateWithAllocator(stride, NULL);
+}
+
+HashMap* HashMapCreateWithAllocator(size_t stride, CUtilsAllocator* allocator) {
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    HashMap* hmap = CUtilsMallocWith(allocator, sizeof(HashMap));
+    hmap->allocator = allocator;
+    hmap->slots = CUtilsMallocWith(allocator, HMAP_DEFAULT_CAPACITY * sizeof(_HashSlot));
+    hmap->capacity = HMAP_DEFAULT_CAPACITY;
+    hmap->size = 0;
+    hmap->seed = HashGetProcessSeed();
     hmap->stride = stride;
     return hmap;
 }
 
 void HashMapFree(HashMap* hmap) {
-    for (uint64_t i = 0; i < UniqueArrayGetSize(hmap->data); i++) {
-        _HashNode* node = (_HashNode*)*(uint64_t*)UniqueArrayValueAt(hmap->data, i);
-        _DeleteNode(node);
+    if (!CUtilsAllocatorCanFree(hmap->allocator)) {
+        // Everything is released with the allocator.
+        return;
     }
-    UniqueArrayFree(hmap->data);
-    CUtilsFree(hmap);
+    _HashSlot* slots = hmap->slots;
+    for (uint64_t i = 0; i < hmap->capacity; i++) {
+        if (slots[i].node) {
+            CUtilsNodeFree(hmap->allocator, slots[i].node, _NodeSize(hmap, slots[i].node->keyLength));
+        }
+    }
+    CUtilsFreeWith(hmap->allocator, hmap->slots);
+    CUtilsFreeWith(hmap->allocator, hmap);
 }
 
 void HashMapSet(HashMap* hmap, const char* key, void* value) {
-    uint64_t index;
-    if (_FindHash(hmap, key, &index)) {
-        // this array has this hash and value, change it
-        _HashNode* node = (_HashNode*)*(uint64_t*)UniqueArrayValueAt(hmap->data, index);
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-        _CheckCollision(hmap, node->key, key);
-#endif
-        memcpy(node->value, value, hmap->stride);
-    } else {
-        // this array hasn't got this hash and value, create new
-        _HashNode* new = _CreateNode(key, value, hmap->stride);
-        uint64_t pointer = (uint64_t) new;
-        UniqueArrayAdd(hmap->data, &pointer, NULL);
+    uint64_t keyLength = strlen(key);
+    uint64_t hash = _Hash(hmap, key, keyLength);
+    _HashSlot* slot = _FindSlot(hmap, key, keyLength, hash);
+    if (slot) {
+        memcpy(_NodeValue(slot->node), value, hmap->stride);
+        return;
     }
+    if ((hmap->size + 1) * 100 > hmap->capacity * HMAP_MAX_LOAD_PERCENT) {
+        _Rehash(hmap, hmap->capacity * 2);
+    }
+    _InsertNode(hmap, hash, _CreateNode(hmap, key, keyLength, value));
 }
 
 void* HashMapGet(HashMap* hmap, const char* key) {
-    uint64_t index;
-    if (_FindHash(hmap, key, &index)) {
-        _HashNode* node = (_HashNode*)*(uint64_t*)UniqueArrayValueAt(hmap->data, index);
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-        _CheckCollision(hmap, node->key, key);
-#endif
-        ASSERT_BREAK(node->value);
-        return node->value;
+    uint64_t keyLength = strlen(key);
+    _HashSlot* slot = _FindSlot(hmap, key, keyLength, _Hash(hmap, key, keyLength));
+    if (slot) {
+        return _NodeValue(slot->node);
     }
     return NULL;
 }
 
 bool HashMapRemove(HashMap* hmap, const char* key) {
-    uint64_t index;
-    if (_FindHash(hmap, key, &index)) {
-        _HashNode* node = (_HashNode*)*(uint64_t*)UniqueArrayValueAt(hmap->data, index);
-#if defined(CUTILS_DEBUG_BUILD) && defined(CUTILS_TESTS_ENABLED)
-        _CheckCollision(hmap, node->key, key);
-#endif
-        UniqueArrayRemoveFrom(hmap->data, index);
-        _DeleteNode(node);
+    uint64_t keyLength = strlen(key);
+    _HashSlot* slot = _FindSlot(hmap, key, keyLength, _Hash(hmap, key, keyLength));
+    if (slot) {
+        _HashNode* node = slot->node;
+        _RemoveSlot(hmap, slot);
+        CUtilsNodeFree(hmap->allocator, node, _NodeSize(hmap, node->keyLength));
         return true;
     }
     return false;
 }
 
 bool HashMapContains(HashMap* hmap, const char* key) {
-    uint64_t index;
-    return _FindHash(hmap, key, &index);
+    uint64_t keyLength = strlen(key);
+    return _FindSlot(hmap, key, keyLength, _Hash(hmap, key, keyLength)) != NULL;
+}
+
+uint64_t HashMapGetSize(HashMap* hmap) {
+    return hmap->size;
 }
 
 #ifdef __cplusplus
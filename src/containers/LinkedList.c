@@ -17,7 +17,7 @@ extern "C" {
 static void _SetNodeValue(LinkedList* list, LinkedListNode* node,
                           const void* value) {
     if (node->value == NULL) {
-        node->value = CUtilsMalloc(list->stride);
+        node->value = CUtilsMallocUninitWith(list->allocator, list->stride);
     }
     memcpy(node->value, value, list->stride);
 }
@@ -60,8 +60,16 @@ static void _RaiseOutOfBounds(LinkedList* list, uint64_t index) {
 // PRIVATE END
 
 LinkedList* LinkedListCreate(size_t stride) {
-    LinkedList* list = CUtilsMalloc(sizeof(LinkedList));
-    list->first = CUtilsMalloc(sizeof(LinkedListNode));
+    return LinkedListCreateWithAllocator(stride, NULL);
+}
+
+LinkedList* LinkedListCreateWithAllocator(size_t stride, CUtilsAllocator* allocator) {
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    LinkedList* list = CUtilsMallocWith(allocator, sizeof(LinkedList));
+    list->allocator = allocator;
+    list->first = CUtilsNodeMalloc(list->allocator, sizeof(LinkedListNode));
     list->last = list->first;
     list->stride = stride;
     list->size = 0;
@@ -74,14 +82,14 @@ void LinkedListClear(LinkedList* list) {
     LinkedListNode* node = list->first->next;
     while (node) {
         if (node->value) {
-            CUtilsFree(node->value);
+            CUtilsFreeWith(list->allocator, node->value);
         }
         LinkedListNode* next = node->next;
-        CUtilsFree(node);
+        CUtilsNodeFree(list->allocator, node, sizeof(LinkedListNode));
         node = next;
     }
     if (list->first->value) {
-        CUtilsFree(list->first->value);
+        CUtilsFreeWith(list->allocator, list->first->value);
         list->first->value = NULL;
     }
     list->size = 0;
@@ -91,8 +99,8 @@ void LinkedListClear(LinkedList* list) {
 void LinkedListFree(LinkedList* list) {
     LinkedListClear(list);
     // Delete the first element now.
-    CUtilsFree(list->first);
-    CUtilsFree(list);
+    CUtilsNodeFree(list->allocator, list->first, sizeof(LinkedListNode));
+    CUtilsFreeWith(list->allocator, list);
 }
 
 void LinkedListSetValue(LinkedList* list, const void* value, uint64_t index) {
@@ -124,7 +132,7 @@ void LinkedListPush(LinkedList* list, const void* value) {
         _SetNodeValue(list, node, value);
         list->size = _CalculateListLength(list);
     } else {
-        LinkedListNode* newNode = CUtilsMalloc(sizeof(LinkedListNode));
+        LinkedListNode* newNode = CUtilsNodeMalloc(list->allocator, sizeof(LinkedListNode));
         _SetNodeValue(list, newNode, value);
         newNode->next = NULL;
         node->next = newNode;
@@ -144,7 +152,7 @@ void LinkedListPushAt(LinkedList* list, const void* value, uint64_t index) {
         _SetNodeValue(list, node, value);
         list->size = _CalculateListLength(list);
     } else {
-        LinkedListNode* newNode = CUtilsMalloc(sizeof(LinkedListNode));
+        LinkedListNode* newNode = CUtilsNodeMalloc(list->allocator, sizeof(LinkedListNode));
         _SetNodeValue(list, newNode, value);
         if (prevNode) {
             prevNode->next = newNode;
@@ -188,7 +196,7 @@ void* LinkedListPopAt(LinkedList* list, uint64_t index) {
         deleteNode = false;
     }
     if (deleteNode) {
-        CUtilsFree(node);
+        CUtilsNodeFree(list->allocator, node, sizeof(LinkedListNode));
         list->size--;
     } else {
         list->size = 0;
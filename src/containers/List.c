@@ -14,32 +14,41 @@
 extern "C" {
 #endif
 
+// Numbers, floats and bools are stored right after the node, so they
+// don't need a second allocation.
+#define LIST_NODE_SIZE (sizeof(ListNode) + sizeof(int64_t))
+
+static inline void* _InlineValue(ListNode* node) {
+    return node + 1;
+}
+
 static ListNode* _ListCreateNode(List* list, CUtilsDataType type, void* value) {
-    ListNode* node = CUtilsMalloc(sizeof(ListNode));
+    CUtilsAllocator* allocator = ArrayGetAllocator(list->data);
+    ListNode* node = CUtilsNodeMalloc(allocator, LIST_NODE_SIZE);
     node->dataType = type;
     switch (type) {
         case DATA_TYPE_STRING:;
             uint64_t len = strlen(value);
-            node->value = CUtilsMalloc(len + 1);
+            node->value = CUtilsMallocUninitWith(allocator, len + 1);
             memcpy(node->value, value, len + 1);
             break;
         case DATA_TYPE_NUMBER:
-            node->value = CUtilsMalloc(sizeof(int64_t));
+            node->value = _InlineValue(node);
             memcpy(node->value, value, sizeof(int64_t));
             break;
         case DATA_TYPE_FLOAT:
-            node->value = CUtilsMalloc(sizeof(float));
+            node->value = _InlineValue(node);
             memcpy(node->value, value, sizeof(float));
             break;
         case DATA_TYPE_BOOL:
-            node->value = CUtilsMalloc(sizeof(bool));
+            node->value = _InlineValue(node);
             memcpy(node->value, value, sizeof(bool));
             break;
         case DATA_TYPE_LIST:
-            node->value = ListCopy(value);
+            node->value = ListCopyWithAllocator(value, allocator);
             break;
         case DATA_TYPE_OBJECT:
-            node->value = DictionaryCopy(value);
+            node->value = DictionaryCopyWithAllocator(value, allocator);
             break;
         default:
             node->value = NULL;
@@ -48,14 +57,32 @@ static ListNode* _ListCreateNode(List* list, CUtilsDataType type, void* value) {
     return node;
 }
 
+// Small lists keep their first elements right after the List struct,
+// so creating one is a single allocation.
+#define LIST_INLINE_CAPACITY 8
+
+typedef struct _ListBlock {
+    List list;
+    ArrayInlineStorage(uint64_t, LIST_INLINE_CAPACITY) storage;
+} _ListBlock;
+
 List* ListCreate() {
-    List* list = CUtilsMalloc(sizeof(List));
-    list->data = ArrayCreate(uint64_t);
-    return list;
+    return ListCreateWithAllocator(NULL);
+}
+
+List* ListCreateWithAllocator(CUtilsAllocator* allocator) {
+    _ListBlock* block = CUtilsMallocUninitWith(allocator, sizeof(_ListBlock));
+    block->list.data = _ArrayCreateInline(&block->storage, sizeof(block->storage),
+                                          sizeof(uint64_t), allocator);
+    return &block->list;
 }
 
 List* ListCopy(List* list) {
-    List* cpy = ListCreate();
+    return ListCopyWithAllocator(list, NULL);
+}
+
+List* ListCopyWithAllocator(List* list, CUtilsAllocator* allocator) {
+    List* cpy = ListCreateWithAllocator(allocator);
     for (uint64_t i = 0; i < ArrayGetSize(list->data); i++) {
         ListNode* node = (ListNode*)list->data[i];
         ListPush(cpy, node->dataType, node->value);
@@ -67,6 +94,11 @@ void ListFree(List* list) {
     if (list == NULL) {
         return;
     }
+    CUtilsAllocator* allocator = list->data ? ArrayGetAllocator(list->data) : NULL;
+    if (!CUtilsAllocatorCanFree(allocator)) {
+        // Everything is released with the allocator.
+        return;
+    }
     if (list->data) {
         for (uint64_t i = 0; i < ArrayGetSize(list->data); i++) {
             ListNode* node = (ListNode*)list->data[i];
@@ -75,11 +107,15 @@ void ListFree(List* list) {
         ArrayFree(list->data);
         list->data = NULL;
     }
-    CUtilsFree(list);
+    CUtilsFreeWith(allocator, list);
 }
 
 void ListFreeNode(List* list, ListNode* node) {
-    if (node->value) {
+    CUtilsAllocator* allocator = ArrayGetAllocator(list->data);
+    if (!CUtilsAllocatorCanFree(allocator)) {
+        return;
+    }
+    if (node->value && node->value != _InlineValue(node)) {
         switch (node->dataType) {
             case DATA_TYPE_LIST:
                 ListFree(node->value);
@@ -88,11 +124,11 @@ void ListFreeNode(List* list, ListNode* node) {
                 DictionaryFree(node->value);
                 break;
             default:
-                CUtilsFree(node->value);
+                CUtilsFreeWith(allocator, node->value);
                 break;
         }
     }
-    CUtilsFree(node);
+    CUtilsNodeFree(allocator, node, LIST_NODE_SIZE);
 }
 
 void ListSetValue(List* list, uint64_t index, CUtilsDataType type, void* value) {
@@ -127,23 +163,19 @@ void ListPushAt(List* list, uint64_t index, CUtilsDataType type, void* value) {
 }
 
 ListNode* ListPop(List* list) {
-    uint64_t* pointer = ArrayPop(list->data);
-    if (pointer == NULL) {
+    uint64_t pointer;
+    if (!ArrayPopLastInto(list->data, &pointer)) {
         return NULL;
     }
-    ListNode* node = (ListNode*)*pointer;
-    CUtilsFree(pointer);
-    return node;
+    return (ListNode*)pointer;
 }
 
 ListNode* ListPopAt(List* list, uint64_t index) {
-    uint64_t* pointer = ArrayPopAt(list->data, index);
-    if (pointer == NULL) {
+    uint64_t pointer;
+    if (!ArrayPopInto(list->data, index, &pointer)) {
         return NULL;
     }
-    ListNode* node = (ListNode*)*pointer;
-    CUtilsFree(pointer);
-    return node;
+    return (ListNode*)pointer;
 }
 
 uint64_t ListGetSize(List* list) {
@@ -0,0 +1,175 @@
+#include "containers/SegmentedArray.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Debug.h"
+#include "MemoryUtils.h"
+
+#define SARR_BLOCK_BYTES (64 * 1024)
+#define SARR_DEFAULT_DIRECTORY_CAPACITY 16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// PRIVATE BEGIN
+static inline uint64_t _BlockCapacity(const SegmentedArray* sarr) {
+    return (uint64_t)1 << sarr->blockShift;
+}
+
+static inline size_t _BlockBytes(const SegmentedArray* sarr) {
+    return _BlockCapacity(sarr) * sarr->stride;
+}
+
+static inline void* _Element(const SegmentedArray* sarr, uint64_t index) {
+    uint64_t mask = _BlockCapacity(sarr) - 1;
+    return (char*)sarr->blocks[index >> sarr->blockShift] + (index & mask) * sarr->stride;
+}
+
+static inline void _RaiseIndexOutOfBounds(const SegmentedArray* sarr, uint64_t index) {
+    (void)sarr;
+    (void)index;
+    DEBUG_LOG_ERROR("Index out of bounds. Index: %lu, SegmentedArray Size: %lu.",
+                    (unsigned long)index, (unsigned long)sarr->size);
+    RAISE_SIGSEGV;
+}
+
+// Only the directory is reallocated, blocks never move.
+static void _AddBlock(SegmentedArray* sarr) {
+    if (sarr->blockCount == sarr->directoryCapacity) {
+        sarr->directoryCapacity *= 2;
+        sarr->blocks = CUtilsReallocWith(sarr->allocator, sarr->blocks,
+                                         sarr->directoryCapacity * sizeof(void*));
+    }
+    sarr->blocks[sarr->blockCount++] = CUtilsMallocUninitWith(sarr->allocator, _BlockBytes(sarr));
+}
+
+// Frees blocks past the one after the last used block.
+static void _TrimBlocks(SegmentedArray* sarr) {
+    uint64_t used = (sarr->size + _BlockCapacity(sarr) - 1) >> sarr->blockShift;
+    uint64_t keep = used + 1;
+    while (sarr->blockCount > keep) {
+        CUtilsFreeWith(sarr->allocator, sarr->blocks[--sarr->blockCount]);
+    }
+}
+// PRIVATE END
+
+SegmentedArray* SegmentedArrayCreate(size_t stride) {
+    return SegmentedArrayCreateWithAllocator(stride, NULL);
+}
+
+SegmentedArray* SegmentedArrayCreateWithAllocator(size_t stride, CUtilsAllocator* allocator) {
+    if (stride == 0) {
+        DEBUG_LOG_ERROR("SegmentedArray stride can't be 0.");
+        return NULL;
+    }
+    if (allocator == NULL) {
+        allocator = CUtilsGetDefaultAllocator();
+    }
+    SegmentedArray* sarr = CUtilsMallocWith(allocator, sizeof(SegmentedArray));
+    sarr->stride = stride;
+    sarr->allocator = allocator;
+    // Biggest power of two elements which fit the block bytes.
+    sarr->blockShift = 0;
+    while (sarr->blockShift < 62 &&
+           ((uint64_t)2 << sarr->blockShift) * stride <= SARR_BLOCK_BYTES) {
+        sarr->blockShift++;
+    }
+    sarr->directoryCapacity = SARR_DEFAULT_DIRECTORY_CAPACITY;
+    sarr->blocks = CUtilsMallocUninitWith(allocator, sarr->directoryCapacity * sizeof(void*));
+    return sarr;
+}
+
+void SegmentedArrayFree(SegmentedArray* sarr) {
+    if (sarr == NULL || !CUtilsAllocatorCanFree(sarr->allocator)) {
+        return;
+    }
+    for (uint64_t i = 0; i < sarr->blockCount; i++) {
+        CUtilsFreeWith(sarr->allocator, sarr->blocks[i]);
+    }
+    CUtilsFreeWith(sarr->allocator, sarr->blocks);
+    CUtilsFreeWith(sarr->allocator, sarr);
+}
+
+void SegmentedArrayClear(SegmentedArray* sarr) {
+    sarr->size = 0;
+    _TrimBlocks(sarr);
+}
+
+void* SegmentedArrayPush(SegmentedArray* sarr, const void* value) {
+    if ((sarr->size >> sarr->blockShift) == sarr->blockCount) {
+        _AddBlock(sarr);
+    }
+    void* dest = _Element(sarr, sarr->size);
+    if (value) {
+        memcpy(dest, value, sarr->stride);
+    }
+    sarr->size++;
+    return dest;
+}
+
+bool SegmentedArrayPop(SegmentedArray* sarr, void* outValue) {
+    if (sarr->size == 0) {
+        return false;
+    }
+    sarr->size--;
+    if (outValue) {
+        memcpy(outValue, _Element(sarr, sarr->size), sarr->stride);
+    }
+    // Leaving a block behind frees the spare one past it.
+    if ((sarr->size & (_BlockCapacity(sarr) - 1)) == 0) {
+        _TrimBlocks(sarr);
+    }
+    return true;
+}
+
+void* SegmentedArrayGetValue(const SegmentedArray* sarr, uint64_t index) {
+    if (index >= sarr->size) {
+        _RaiseIndexOutOfBounds(sarr, index);
+        return NULL;
+    }
+    return _Element(sarr, index);
+}
+
+void SegmentedArraySetValue(SegmentedArray* sarr, const void* value, uint64_t index) {
+    if (index >= sarr->size) {
+        _RaiseIndexOutOfBounds(sarr, index);
+        return;
+    }
+    memcpy(_Element(sarr, index), value, sarr->stride);
+}
+
+uint64_t SegmentedArrayGetSize(const SegmentedArray* sarr) {
+    return sarr->size;
+}
+
+uint64_t SegmentedArrayGetBlockCapacity(const SegmentedArray* sarr) {
+    return _BlockCapacity(sarr);
+}
+
+SegmentedArrayIterator SegmentedArrayIterate(const SegmentedArray* sarr) {
+    SegmentedArrayIterator it = {sarr, 0, NULL, 0};
+    return it;
+}
+
+bool SegmentedArrayNextBlock(SegmentedArrayIterator* it) {
+    const SegmentedArray* sarr = it->sarr;
+    uint64_t start = it->block << sarr->blockShift;
+    if (start >= sarr->size) {
+        it->data = NULL;
+        it->count = 0;
+        return false;
+    }
+    uint64_t left = sarr->size - start;
+    it->data = sarr->blocks[it->block];
+    it->count = left < _BlockCapacity(sarr) ? left : _BlockCapacity(sarr);
+    it->block++;
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -70,15 +70,22 @@ static bool _FindValue(UniqueArray* uniqueArray, void* value, uint64_t* outIndex
 
 UniqueArray* UniqueArrayCreate(size_t stride, size_t capacity,
                                int (*comparator)(const void* v1, const void* v2)) {
-    UniqueArray* uniqueArray = CUtilsMalloc(sizeof(UniqueArray));
-    uniqueArray->data = _ArrayCreate(stride, capacity);
+    return UniqueArrayCreateWithAllocator(stride, capacity, comparator, NULL);
+}
+
+UniqueArray* UniqueArrayCreateWithAllocator(size_t stride, size_t capacity,
+                                            int (*comparator)(const void* v1, const void* v2),
+                                            CUtilsAllocator* allocator) {
+    UniqueArray* uniqueArray = CUtilsMallocWith(allocator, sizeof(UniqueArray));
+    uniqueArray->data = _ArrayCreateWithAllocator(stride, capacity, allocator);
     uniqueArray->comparator = comparator;
     return uniqueArray;
 }
 
 void UniqueArrayFree(UniqueArray* uniqueArray) {
+    CUtilsAllocator* allocator = ArrayGetAllocator(uniqueArray->data);
     ArrayFree(uniqueArray->data);
-    CUtilsFree(uniqueArray);
+    CUtilsFreeWith(allocator, uniqueArray);
 }
 
 bool UniqueArrayAdd(UniqueArray* uniqueArray, void* value, uint64_t* outIndex) {
@@ -100,7 +107,7 @@ bool UniqueArrayAdd(UniqueArray* uniqueArray, void* value, uint64_t* outIndex) {
 bool UniqueArrayRemove(UniqueArray* uniqueArray, void* value, uint64_t* outIndex) {
     uint64_t index;
     if (_FindValue(uniqueArray, value, &index)) {
-        CUtilsFree(ArrayPopAt(uniqueArray->data, index));
+        ArrayDiscardAt(uniqueArray->data, index);
         if (outIndex) {
             *outIndex = index;
         }
@@ -111,7 +118,7 @@ bool UniqueArrayRemove(UniqueArray* uniqueArray, void* value, uint64_t* outIndex
 }
 
 void UniqueArrayRemoveFrom(UniqueArray* uniqueArray, uint64_t index) {
-    CUtilsFree(ArrayPopAt(uniqueArray->data, index));
+    ArrayDiscardAt(uniqueArray->data, index);
 }
 
 bool UniqueArrayContains(UniqueArray* uniqueArray, void* value, uint64_t* outIndex) {
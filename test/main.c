@@ -4,30 +4,74 @@
 #include <time.h>
 
 #include "Debug.h"
+#include "FileUtils.h"
+#include "Json.h"
 #include "MemoryUtils.h"
 #include "Timer.h"
 #include "tests.h"
 
 int main(void) {
     Timer t = TimerCreate("c_utils_test", true);
+    CUtilsProfilerEnable(true);
     // sandbox();
     test_array();
     test_array_performance();
+    test_array_churn_performance();
+    test_array_sort();
+    test_array_sort_performance();
+    test_array_search();
+    test_array_search_performance();
+    test_segmented_array();
+    test_segmented_array_performance();
+    test_gap_array();
+    test_gap_array_performance();
     test_strings();
+    test_string_trim_performance();
     test_linkedlist();
     test_linkedlist_performance();
     test_dictionary_and_json();
+    test_memory();
+    test_memory_performance();
+    test_allocator();
+    test_profiler();
+    test_node_pool();
+    test_node_pool_performance();
+    test_arena();
+    test_arena_performance();
     test_unique_array();
     test_unique_array_performance();
     test_hash_algorithms();
+    test_hash_streaming();
+    test_hash_sha512();
+    test_hash_sha256_backends();
+    test_hash_sha2_performance();
+    test_hash_batch();
+    test_hash_batch_performance();
+    test_hash_tree();
+    test_hash_tree_performance();
+    test_hash_wy();
+    test_hash_performance();
     test_hash_map();
     test_hash_map_performance();
     test_file_write_read_string();
     test_file_write_read_binary();
-    DEBUG_LOG_INFO("Total malloc: %lu, Total free: %lu, Total realloc: %lu",
-                   (unsigned long)c_utils_total_malloc,
-                   (unsigned long)c_utils_total_free,
-                   (unsigned long)c_utils_total_realloc);
+    test_large_allocation_performance();
+    test_large_blocks();
+    test_large_block_performance();
+    test_checksum();
+    test_checksum_performance();
+    CUtilsProfilerStats stats;
+    CUtilsProfilerGetStats(&stats);
+    DEBUG_LOG_INFO("Total malloc: %lu, Total free: %lu, Total realloc: %lu, Peak bytes: %ld",
+                   (unsigned long)stats.mallocCount,
+                   (unsigned long)stats.freeCount,
+                   (unsigned long)stats.reallocCount,
+                   (long)stats.peakBytes);
+    Dictionary* report = CUtilsProfilerCreateReport();
+    String json = JsonCreate(report);
+    FileUtilsWriteString("c_utils_test_memory.json", json);
+    StringFree(&json);
+    DictionaryFree(report);
     TimerLogElapsed(&t);
     return 0;
 }
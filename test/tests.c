@@ -1,12 +1,16 @@
 #include "tests.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 
+#include "Checksum.h"
 #include "Debug.h"
 #include "FileUtils.h"
 #include "Hash.h"
@@ -16,9 +20,11 @@
 #include "Timer.h"
 #include "containers/Array.h"
 #include "containers/Dictionary.h"
+#include "containers/GapArray.h"
 #include "containers/HashMap.h"
 #include "containers/LinkedList.h"
 #include "containers/List.h"
+#include "containers/SegmentedArray.h"
 #include "containers/UniqueArray.h"
 
 char* test_string =
@@ -57,9 +63,21 @@ char* rand_string(uint64_t max_len, char from, char to) {
     return str;
 }
 
+// Heap allocations counted by the profiler, main enables it.
+uint64_t test_malloc_count() {
+    CUtilsProfilerStats stats;
+    CUtilsProfilerGetStats(&stats);
+    return stats.mallocCount;
+}
+
 void sandbox() {
 }
 
+static bool test_array_is_odd(const void* element, void* userData) {
+    (void)userData;
+    return *(const int*)element % 2 == 1;
+}
+
 void test_array() {
     TEST_START;
     uint64_t test_size = 1000;
@@ -75,6 +93,83 @@ void test_array() {
         TEST_CHECK(array[index] == val);
     }
     ArrayFree(array);
+    // Growth policy.
+    int* ints = ArrayCreate(int);
+    ArrayGrowthPolicy policy = ArrayGetGrowthPolicy(ints);
+    TEST_CHECK(policy.growthFactor == 2.0f && policy.shrinkDivisor == 4 && policy.minCapacity == 1);
+    for (int i = 0; i < 1024; i++) {
+        ArrayPush(ints, i);
+    }
+    TEST_CHECK(ArrayGetCapacity(ints) == 1024);
+    // Removals keep the capacity until the size drops below a quarter.
+    ArrayRemove(ints, 0, 700);
+    TEST_CHECK(ArrayGetCapacity(ints) == 1024 && ints[0] == 700);
+    ArrayRemove(ints, 0, 100);
+    TEST_CHECK(ArrayGetCapacity(ints) == 448 && ArrayGetSize(ints) == 224 && ints[0] == 800);
+    ArrayShrinkToFit(ints);
+    TEST_CHECK(ArrayGetCapacity(ints) == 224);
+    ArrayGrowthPolicy custom = {1.5f, 0, 64};
+    ArraySetGrowthPolicy(ints, custom);
+    ArrayPush(ints, custom.minCapacity);
+    TEST_CHECK(ArrayGetCapacity(ints) == 336);
+    ArrayClear(ints);
+    TEST_CHECK(ArrayGetSize(ints) == 0 && ArrayGetCapacity(ints) == 336);
+    ArrayShrinkToFit(ints);
+    TEST_CHECK(ArrayGetCapacity(ints) == 64);
+    // Empty arrays have nothing to pop.
+    int popped = 0;
+    TEST_CHECK(!ArrayPopLastInto(ints, &popped) && !ArrayDiscard(ints));
+    ArrayFree(ints);
+    List* empty_list = ListCreate();
+    TEST_CHECK(ListPop(empty_list) == NULL && ListPopAt(empty_list, 0) == NULL);
+    ListFree(empty_list);
+    // Bulk removals.
+    ints = ArrayCreate(int);
+    for (int i = 0; i < 100; i++) {
+        ArrayPushRV(ints, int, i % 10);
+    }
+    ArrayRemoveIf(ints, test_array_is_odd, NULL);
+    TEST_CHECK(ArrayGetSize(ints) == 50 && ints[0] == 0 && ints[1] == 2 && ints[49] == 8);
+    int four = 4;
+    ArrayRemoveValue(ints, four);
+    TEST_CHECK(ArrayGetSize(ints) == 40 && ints[2] == 6);
+    uint64_t indices[] = {0, 1, 1, 38, 39};
+    ArrayRemoveIndices(ints, indices, 5);
+    TEST_CHECK(ArrayGetSize(ints) == 36 && ints[0] == 6 && ints[35] == 2);
+    ArrayFree(ints);
+    // Alignment survives growing and shrinking.
+    TEST_CHECK(ArrayGetAlignment(array = ArrayCreate(float)) == 16);
+    ArrayFree(array);
+    TEST_CHECK(ArrayCreateAligned(int, 48) == NULL);
+    for (size_t alignment = 32; alignment <= 4096; alignment *= 2) {
+        ints = ArrayCreateAligned(int, alignment);
+        TEST_CHECK(ArrayGetAlignment(ints) == alignment);
+        for (int i = 0; i < 5000; i++) {
+            ArrayPush(ints, i);
+            TEST_CHECK((uintptr_t)ints % alignment == 0);
+        }
+        ArrayRemove(ints, 10, 4980);
+        ArrayShrinkToFit(ints);
+        TEST_CHECK((uintptr_t)ints % alignment == 0 && ArrayGetCapacity(ints) == 20);
+        TEST_CHECK(ints[9] == 9 && ints[10] == 4990 && ints[19] == 4999);
+        ArrayFree(ints);
+    }
+    // Inline arrays allocate once they outgrow their storage.
+    ArrayInlineStorage(int, 16) storage;
+    uint64_t mallocCount = test_malloc_count();
+    ints = ArrayCreateInline(int, &storage);
+    for (int i = 0; i < 16; i++) {
+        ArrayPush(ints, i);
+    }
+    TEST_CHECK(ArrayIsInline(ints) && (void*)ints == storage.bytes + ARRAY_HEADER_SIZE);
+    TEST_CHECK(test_malloc_count() == mallocCount);
+    ArrayRemove(ints, 0, 12);
+    TEST_CHECK(ArrayIsInline(ints) && ArrayGetCapacity(ints) == 16 && ints[0] == 12);
+    for (int i = 4; i < 17; i++) {
+        ArrayPush(ints, i);
+    }
+    TEST_CHECK(!ArrayIsInline(ints) && ArrayGetSize(ints) == 17 && ints[0] == 12 && ints[16] == 16);
+    ArrayFree(ints);
     TEST_END;
 }
 
@@ -93,17 +188,623 @@ void test_array_performance() {
         uint64_t index = rand() % ArrayGetSize(array);
         ArrayPushAt(array, value, index);
     }
+    uint64_t mallocCount = test_malloc_count();
+    int64_t sum = 0;
     for (uint64_t i = 0; i < test_size / 2; i++) {
-        CUtilsFree(ArrayPop(array));
+        int64_t value;
+        ArrayPopLastInto(array, &value);
+        sum += value;
     }
     for (uint64_t i = 0; i < test_size / 2; i++) {
         uint64_t index = rand() % ArrayGetSize(array);
-        CUtilsFree(ArrayPopAt(array, index));
+        ArrayDiscardAt(array, index);
     }
+    TEST_CHECK(test_malloc_count() == mallocCount && sum > 0);
     ArrayFree(array);
     TimerLogElapsed(&t);
 }
 
+void test_array_churn_performance() {
+    TEST_START;
+    uint64_t test_size = 1000000;
+    uint64_t base_size = 1024;
+    DEBUG_LOG_INFO("Test size: %lu", (unsigned long)test_size);
+    CUtilsProfilerStats before, after;
+    CUtilsProfilerGetStats(&before);
+    Timer t = TimerCreate("test_array_churn_performance", true);
+    // Push/pop around a power of two, where exact packing reallocs on
+    // every step.
+    int64_t* array = ArrayCreate(int64_t);
+    for (uint64_t i = 0; i < base_size; i++) {
+        ArrayPushRV(array, int64_t, i);
+    }
+    for (uint64_t i = 0; i < test_size; i++) {
+        ArrayPushRV(array, int64_t, i);
+        ArrayRemove(array, ArrayGetSize(array) - 1, 1);
+        ArrayRemove(array, ArrayGetSize(array) - 1, 1);
+        ArrayPushRV(array, int64_t, i);
+    }
+    ArrayFree(array);
+    // Strings appended and erased back.
+    String s = StringCreate(1);
+    for (uint64_t i = 0; i < test_size / 10; i++) {
+        StringAppendCStr(&s, "0123456789abcdef");
+        if (s.length > 64) {
+            StringErase(&s, 0, 48);
+        }
+    }
+    StringFree(&s);
+    TimerLogElapsed(&t);
+    CUtilsProfilerGetStats(&after);
+    DEBUG_LOG_INFO("Reallocs: %lu", (unsigned long)(after.reallocCount - before.reallocCount));
+    TEST_END;
+}
+
+typedef struct {
+    int key;
+    int order;
+    int padding;
+} test_sort_item;
+
+static int test_sort_int_comparator(const void* v1, const void* v2) {
+    int a = *(const int*)v1;
+    int b = *(const int*)v2;
+    return (a > b) - (a < b);
+}
+
+static int test_sort_double_comparator(const void* v1, const void* v2) {
+    double a = *(const double*)v1;
+    double b = *(const double*)v2;
+    return (a > b) - (a < b);
+}
+
+static int test_sort_int64_comparator(const void* v1, const void* v2) {
+    int64_t a = *(const int64_t*)v1;
+    int64_t b = *(const int64_t*)v2;
+    return (a > b) - (a < b);
+}
+
+static bool test_sort_is_sorted(const void* array, ArrayComparator comparator) {
+    uint64_t size = ArrayGetSize(array);
+    for (uint64_t i = 1; i < size; i++) {
+        if (comparator(ArrayGetValue(array, i - 1), ArrayGetValue(array, i)) > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_array_sort() {
+    TEST_START;
+    uint64_t test_size = 10000;
+    // Random with duplicates, sorted, reversed and all equal.
+    int* ints = ArrayCreate(int);
+    for (int pattern = 0; pattern < 4; pattern++) {
+        ArrayClear(ints);
+        for (uint64_t i = 0; i < test_size; i++) {
+            int values[] = {rand() % 1000 - 500, (int)i, (int)(test_size - i), 7};
+            ArrayPush(ints, values[pattern]);
+        }
+        ArraySort(ints, test_sort_int_comparator);
+        TEST_CHECK(ArrayGetSize(ints) == test_size);
+        TEST_CHECK(test_sort_is_sorted(ints, test_sort_int_comparator));
+    }
+    // Stable sort keeps the insertion order of equal keys, the 12 byte
+    // stride takes the generic path.
+    test_sort_item* items = ArrayCreate(test_sort_item);
+    for (uint64_t i = 0; i < test_size; i++) {
+        test_sort_item item = {rand() % 10, (int)i, 0};
+        ArrayPush(items, item);
+    }
+    ArrayStableSort(items, test_sort_int_comparator);
+    for (uint64_t i = 1; i < test_size; i++) {
+        TEST_CHECK(items[i - 1].key < items[i].key ||
+                   (items[i - 1].key == items[i].key && items[i - 1].order < items[i].order));
+    }
+    ArraySort(items, test_sort_int_comparator);
+    TEST_CHECK(test_sort_is_sorted(items, test_sort_int_comparator));
+    ArrayFree(items);
+    // Radix sort matches the comparison sort.
+    int* sorted = ArrayCreate(int);
+    ArrayClear(ints);
+    for (uint64_t i = 0; i < test_size; i++) {
+        int value = rand() - RAND_MAX / 2;
+        ArrayPush(ints, value);
+        ArrayPush(sorted, value);
+    }
+    TEST_CHECK(ArrayRadixSort(ints, ARRAY_ELEMENT_INT32));
+    ArraySort(sorted, test_sort_int_comparator);
+    TEST_CHECK(memcmp(ints, sorted, test_size * sizeof(int)) == 0);
+    TEST_CHECK(!ArrayRadixSort(ints, ARRAY_ELEMENT_INT64));
+    ArrayFree(sorted);
+    ArrayFree(ints);
+    int64_t* int64s = ArrayCreate(int64_t);
+    double* doubles = ArrayCreate(double);
+    for (uint64_t i = 0; i < test_size; i++) {
+        int64_t value = ((int64_t)rand() << 20) - ((int64_t)RAND_MAX << 19);
+        double real = value * 0.001;
+        ArrayPush(int64s, value);
+        ArrayPush(doubles, real);
+    }
+    TEST_CHECK(ArrayRadixSort(int64s, ARRAY_ELEMENT_INT64));
+    TEST_CHECK(test_sort_is_sorted(int64s, test_sort_int64_comparator));
+    TEST_CHECK(ArrayRadixSort(doubles, ARRAY_ELEMENT_DOUBLE));
+    TEST_CHECK(test_sort_is_sorted(doubles, test_sort_double_comparator));
+    ArrayFree(int64s);
+    ArrayFree(doubles);
+    float* floats = ArrayCreate(float);
+    ArrayInsert(floats, test_float_array, 10);
+    TEST_CHECK(ArrayRadixSort(floats, ARRAY_ELEMENT_FLOAT));
+    TEST_CHECK(floats[0] == -789.9f && floats[1] == -123.7f && floats[2] == -98.145f &&
+               floats[3] == 0.5f && floats[9] == 987.0f);
+    ArrayFree(floats);
+    TEST_END;
+}
+
+void test_array_sort_performance() {
+    TEST_START;
+    // 100M elements would need over a gigabyte and a minute of qsort, 10M
+    // shows the same trend.
+    uint64_t max_size = 10000000;
+    int* source = CUtilsMallocUninit(max_size * sizeof(int));
+    for (uint64_t i = 0; i < max_size; i++) {
+        source[i] = rand() - RAND_MAX / 2;
+    }
+    int* plain = CUtilsMallocUninit(max_size * sizeof(int));
+    int* array = ArrayCreate(int);
+    ArrayGrowthPolicy keep = {2.0f, 0, 1};
+    ArraySetGrowthPolicy(array, keep);
+    ArrayReserve(array, max_size);
+    Timer t = TimerCreate("test_array_sort_performance", false);
+    for (uint64_t size = 1000; size <= max_size; size *= 10) {
+        // Small sizes repeat so they sort at least a million ints.
+        uint64_t repeat = size < 1000000 ? 1000000 / size : 1;
+        double elapsed[4] = {0};
+        for (uint64_t r = 0; r < repeat; r++) {
+            memcpy(plain, source, size * sizeof(int));
+            TimerStart(&t);
+            qsort(plain, size, sizeof(int), test_sort_int_comparator);
+            elapsed[0] += TimerGetElapsed(&t);
+            ArrayClear(array);
+            ArrayInsert(array, source, size);
+            TimerStart(&t);
+            ArraySort(array, test_sort_int_comparator);
+            elapsed[1] += TimerGetElapsed(&t);
+            TEST_CHECK(memcmp(array, plain, size * sizeof(int)) == 0);
+            ArrayClear(array);
+            ArrayInsert(array, source, size);
+            TimerStart(&t);
+            ArrayStableSort(array, test_sort_int_comparator);
+            elapsed[2] += TimerGetElapsed(&t);
+            TEST_CHECK(memcmp(array, plain, size * sizeof(int)) == 0);
+            ArrayClear(array);
+            ArrayInsert(array, source, size);
+            TimerStart(&t);
+            ArrayRadixSort(array, ARRAY_ELEMENT_INT32);
+            elapsed[3] += TimerGetElapsed(&t);
+            TEST_CHECK(memcmp(array, plain, size * sizeof(int)) == 0);
+        }
+        DEBUG_LOG_INFO("%8lu ints x %lu (s): qsort %.3f, sort %.3f, stable sort %.3f, radix sort %.3f",
+                       (unsigned long)size, (unsigned long)repeat,
+                       elapsed[0], elapsed[1], elapsed[2], elapsed[3]);
+    }
+    ArrayFree(array);
+    CUtilsFree(plain);
+    CUtilsFree(source);
+    TEST_END;
+}
+
+void test_array_search() {
+    TEST_START;
+    MemoryBackend default_backend = MemoryGetBackend();
+    for (int backend = MEMORY_BACKEND_PORTABLE; backend <= MEMORY_BACKEND_AVX2; backend++) {
+        if (!MemorySetBackend(backend)) {
+            continue;
+        }
+        // Odd sizes leave tails after the vector loops.
+        int* ints = ArrayCreate(int);
+        uint32_t* uints = ArrayCreate(uint32_t);
+        int64_t* int64s = ArrayCreate(int64_t);
+        uint64_t* uint64s = ArrayCreate(uint64_t);
+        double* doubles = ArrayCreate(double);
+        for (int i = 0; i < 1001; i++) {
+            ArrayPushRV(ints, int, i % 100 - 50);
+            ArrayPushRV(uints, uint32_t, (uint32_t)i * 4000000u);
+            ArrayPushRV(int64s, int64_t, ((int64_t)i - 500) * ((int64_t)1 << 33));
+            ArrayPushRV(uint64s, uint64_t, (uint64_t)i << 54);
+            ArrayPushRV(doubles, double, i == 500 ? NAN : (i - 300) * 0.5);
+        }
+        int value = 49;
+        uint64_t index = 0;
+        TEST_CHECK(ArrayFind(ints, ARRAY_ELEMENT_INT32, &value, &index) && index == 99);
+        TEST_CHECK(ArrayCount(ints, ARRAY_ELEMENT_INT32, &value) == 10);
+        uint64_t* found = ArrayFindAll(ints, ARRAY_ELEMENT_INT32, &value);
+        TEST_CHECK(ArrayGetSize(found) == 10 && found[0] == 99 && found[9] == 999);
+        ArrayFree(found);
+        value = 1000;
+        TEST_CHECK(!ArrayFind(ints, ARRAY_ELEMENT_INT32, &value, &index));
+        int64_t isum = 0;
+        TEST_CHECK(ArraySum(ints, ARRAY_ELEMENT_INT32, &isum) && isum == -50 * 10 - 50);
+        int imin = 0, imax = 0;
+        TEST_CHECK(ArrayMinMax(ints, ARRAY_ELEMENT_INT32, &imin, &imax) && imin == -50 && imax == 49);
+        uint64_t usum = 0;
+        uint32_t umax = 0;
+        TEST_CHECK(ArraySum(uints, ARRAY_ELEMENT_UINT32, &usum) && usum == 500500ull * 4000000u);
+        TEST_CHECK(ArrayMax(uints, ARRAY_ELEMENT_UINT32, &umax) && umax == 4000000000u);
+        int64_t lmin = 0, lmax = 0;
+        TEST_CHECK(ArrayMinMax(int64s, ARRAY_ELEMENT_INT64, &lmin, &lmax) &&
+                   lmin == -((int64_t)500 << 33) && lmax == (int64_t)500 << 33);
+        TEST_CHECK(ArraySum(int64s, ARRAY_ELEMENT_INT64, &isum) && isum == 0);
+        uint64_t lumin = 1, lumax = 0;
+        TEST_CHECK(ArrayMinMax(uint64s, ARRAY_ELEMENT_UINT64, &lumin, &lumax) &&
+                   lumin == 0 && lumax == (uint64_t)1000 << 54);
+        double zero = -0.0, nan = NAN, dsum = 0, dmin = 0, dmax = 0;
+        TEST_CHECK(ArrayFind(doubles, ARRAY_ELEMENT_DOUBLE, &zero, &index) && index == 300);
+        TEST_CHECK(ArrayCount(doubles, ARRAY_ELEMENT_DOUBLE, &nan) == 0);
+        TEST_CHECK(ArraySum(doubles, ARRAY_ELEMENT_DOUBLE, &dsum) && isnan(dsum));
+        TEST_CHECK(ArrayMinMax(doubles, ARRAY_ELEMENT_DOUBLE, &dmin, &dmax) && dmin == -150.0 && dmax == 350.0);
+        ArrayFree(ints);
+        ArrayFree(uints);
+        ArrayFree(int64s);
+        ArrayFree(uint64s);
+        ArrayFree(doubles);
+    }
+    MemorySetBackend(default_backend);
+    // Structs are searched by their first member.
+    test_sort_item* items = ArrayCreate(test_sort_item);
+    for (int i = 0; i < 100; i++) {
+        test_sort_item item = {i % 7, i, 0};
+        ArrayPush(items, item);
+    }
+    int key = 6;
+    uint64_t index = 0;
+    int64_t sum = 0;
+    TEST_CHECK(ArrayFind(items, ARRAY_ELEMENT_INT32, &key, &index) && index == 6);
+    TEST_CHECK(ArrayCount(items, ARRAY_ELEMENT_INT32, &key) == 14);
+    TEST_CHECK(ArraySum(items, ARRAY_ELEMENT_INT32, &sum) && sum == 14 * 21 + 1);
+    ArrayFree(items);
+    float* floats = ArrayCreate(float);
+    float fmin = 0;
+    double dsum = 0;
+    TEST_CHECK(!ArrayMin(floats, ARRAY_ELEMENT_FLOAT, &fmin));
+    TEST_CHECK(!ArraySum(floats, ARRAY_ELEMENT_DOUBLE, &dsum));
+    for (int i = 0; i < 20; i++) {
+        ArrayPushRV(floats, float, NAN);
+    }
+    TEST_CHECK(!ArrayMin(floats, ARRAY_ELEMENT_FLOAT, &fmin));
+    ArrayPushRV(floats, float, 2.5f);
+    TEST_CHECK(ArrayMin(floats, ARRAY_ELEMENT_FLOAT, &fmin) && fmin == 2.5f);
+    ArrayFree(floats);
+    TEST_END;
+}
+
+void test_array_search_performance() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SSE2", "AVX2"};
+    MemoryBackend default_backend = MemoryGetBackend();
+    uint64_t test_size = 10000000;
+    int* ints = ArrayCreate(int);
+    double* doubles = ArrayCreate(double);
+    ArrayReserve(ints, test_size);
+    ArrayReserve(doubles, test_size);
+    for (uint64_t i = 0; i < test_size; i++) {
+        ArrayPushRV(ints, int, rand() % 1000);
+        ArrayPushRV(doubles, double, rand() * 0.001);
+    }
+    int missing_int = -1;
+    double missing_double = -1.0;
+    volatile uint64_t sink = 0;
+    Timer t = TimerCreate("test_array_search_performance", false);
+    for (int backend = MEMORY_BACKEND_PORTABLE; backend <= MEMORY_BACKEND_AVX2; backend++) {
+        if (!MemorySetBackend(backend)) {
+            continue;
+        }
+        double elapsed[8];
+        int64_t isum;
+        int imin, imax;
+        double dsum, dmin, dmax;
+        uint64_t index;
+        TimerStart(&t);
+        sink += ArrayFind(ints, ARRAY_ELEMENT_INT32, &missing_int, &index);
+        elapsed[0] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArrayCount(ints, ARRAY_ELEMENT_INT32, &ints[0]);
+        elapsed[1] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArraySum(ints, ARRAY_ELEMENT_INT32, &isum);
+        elapsed[2] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArrayMinMax(ints, ARRAY_ELEMENT_INT32, &imin, &imax);
+        elapsed[3] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArrayFind(doubles, ARRAY_ELEMENT_DOUBLE, &missing_double, &index);
+        elapsed[4] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArrayCount(doubles, ARRAY_ELEMENT_DOUBLE, &doubles[0]);
+        elapsed[5] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArraySum(doubles, ARRAY_ELEMENT_DOUBLE, &dsum);
+        elapsed[6] = TimerGetElapsed(&t);
+        TimerStart(&t);
+        sink += ArrayMinMax(doubles, ARRAY_ELEMENT_DOUBLE, &dmin, &dmax);
+        elapsed[7] = TimerGetElapsed(&t);
+        TEST_CHECK(imin == 0 && imax == 999 && dmin >= 0);
+        DEBUG_LOG_INFO("%s %lu ints (ms): find %.2f, count %.2f, sum %.2f, min max %.2f",
+                       backend_names[backend], (unsigned long)test_size,
+                       elapsed[0] * 1000, elapsed[1] * 1000, elapsed[2] * 1000, elapsed[3] * 1000);
+        DEBUG_LOG_INFO("%s %lu doubles (ms): find %.2f, count %.2f, sum %.2f, min max %.2f",
+                       backend_names[backend], (unsigned long)test_size,
+                       elapsed[4] * 1000, elapsed[5] * 1000, elapsed[6] * 1000, elapsed[7] * 1000);
+    }
+    MemorySetBackend(default_backend);
+    ArrayFree(ints);
+    ArrayFree(doubles);
+    TEST_END;
+}
+
+void test_segmented_array() {
+    TEST_START;
+    SegmentedArray* sarr = SegmentedArrayCreate(sizeof(uint64_t));
+    uint64_t block_capacity = SegmentedArrayGetBlockCapacity(sarr);
+    TEST_CHECK(block_capacity == 8192);
+    TEST_CHECK(SegmentedArrayPop(sarr, NULL) == false);
+    uint64_t test_size = block_capacity * 5 + 3;
+    uint64_t* first = SegmentedArrayPush(sarr, &(uint64_t){0});
+    for (uint64_t i = 1; i < test_size; i++) {
+        SegmentedArrayPushRV(sarr, uint64_t, i);
+    }
+    // Growing never moves an element.
+    TEST_CHECK(SegmentedArrayGetValue(sarr, 0) == first);
+    TEST_CHECK(SegmentedArrayGetSize(sarr) == test_size);
+    TEST_CHECK(sarr->blockCount == 6);
+    bool values_ok = true;
+    for (uint64_t i = 0; i < test_size; i++) {
+        values_ok &= *(uint64_t*)SegmentedArrayGetValue(sarr, i) == i;
+    }
+    TEST_CHECK(values_ok);
+    uint64_t value = 42;
+    SegmentedArraySetValue(sarr, &value, block_capacity);
+    TEST_CHECK(*(uint64_t*)SegmentedArrayGetValue(sarr, block_capacity) == 42);
+    SegmentedArraySetValue(sarr, &(uint64_t){block_capacity}, block_capacity);
+    // Iterator walks every element in order.
+    SegmentedArrayIterator it = SegmentedArrayIterate(sarr);
+    uint64_t visited = 0, blocks = 0;
+    while (SegmentedArrayNextBlock(&it)) {
+        const uint64_t* data = it.data;
+        for (uint64_t i = 0; i < it.count; i++) {
+            values_ok &= data[i] == visited + i;
+        }
+        visited += it.count;
+        blocks++;
+    }
+    TEST_CHECK(values_ok && visited == test_size && blocks == 6);
+    TEST_CHECK(SegmentedArrayNextBlock(&it) == false);
+    // Pop keeps one spare block.
+    TEST_CHECK(SegmentedArrayPop(sarr, &value) && value == test_size - 1);
+    while (SegmentedArrayGetSize(sarr) > block_capacity * 2) {
+        SegmentedArrayPop(sarr, NULL);
+    }
+    TEST_CHECK(sarr->blockCount == 3);
+    TEST_CHECK(SegmentedArrayGetValue(sarr, 0) == first);
+    SegmentedArrayPushRV(sarr, uint64_t, 7);
+    TEST_CHECK(sarr->blockCount == 3);
+    TEST_CHECK(*(uint64_t*)SegmentedArrayGetValue(sarr, block_capacity * 2) == 7);
+    SegmentedArrayClear(sarr);
+    TEST_CHECK(SegmentedArrayGetSize(sarr) == 0 && sarr->blockCount == 1);
+    it = SegmentedArrayIterate(sarr);
+    TEST_CHECK(SegmentedArrayNextBlock(&it) == false);
+    uint64_t mallocCount = test_malloc_count();
+    for (uint64_t i = 0; i < block_capacity; i++) {
+        SegmentedArrayPush(sarr, &i);
+    }
+    TEST_CHECK(test_malloc_count() == mallocCount);
+    SegmentedArrayFree(sarr);
+    // Elements bigger than a block get a block each.
+    typedef struct {
+        uint8_t bytes[100000];
+    } test_big_element;
+    sarr = SegmentedArrayCreate(sizeof(test_big_element));
+    TEST_CHECK(SegmentedArrayGetBlockCapacity(sarr) == 1);
+    test_big_element* big = SegmentedArrayPush(sarr, NULL);
+    big->bytes[99999] = 1;
+    SegmentedArrayPush(sarr, NULL);
+    TEST_CHECK(((test_big_element*)SegmentedArrayGetValue(sarr, 0))->bytes[99999] == 1);
+    SegmentedArrayFree(sarr);
+    TEST_CHECK(SegmentedArrayCreate(0) == NULL);
+    // Arena backed arrays are released with the arena.
+    CUtilsArena* arena = CUtilsArenaCreate(0);
+    sarr = SegmentedArrayCreateWithAllocator(sizeof(int), CUtilsArenaGetAllocator(arena));
+    for (int i = 0; i < 100000; i++) {
+        SegmentedArrayPush(sarr, &i);
+    }
+    TEST_CHECK(*(int*)SegmentedArrayGetValue(sarr, 99999) == 99999);
+    SegmentedArrayFree(sarr);
+    CUtilsArenaFree(arena);
+    TEST_END;
+}
+
+static int64_t test_live_bytes() {
+    CUtilsProfilerStats stats;
+    CUtilsProfilerGetStats(&stats);
+    return stats.liveBytes;
+}
+
+void test_segmented_array_performance() {
+    TEST_START;
+    uint64_t sizes[] = {1000, 100000, 10000000, 40000000};
+    for (int s = 0; s < 4; s++) {
+        uint64_t test_size = sizes[s];
+        uint64_t repeat = test_size < 1000000 ? 1000000 / test_size : 1;
+        Timer t = TimerCreate("test_segmented_array_performance", false);
+        TimerStart(&t);
+        for (uint64_t r = 0; r < repeat; r++) {
+            uint64_t* arr = ArrayCreate(uint64_t);
+            for (uint64_t i = 0; i < test_size; i++) {
+                ArrayPush(arr, i);
+            }
+            ArrayFree(arr);
+        }
+        double array_elapsed = TimerGetElapsed(&t) / repeat;
+        TimerStart(&t);
+        for (uint64_t r = 0; r < repeat; r++) {
+            SegmentedArray* sarr = SegmentedArrayCreate(sizeof(uint64_t));
+            for (uint64_t i = 0; i < test_size; i++) {
+                SegmentedArrayPush(sarr, &i);
+            }
+            SegmentedArrayFree(sarr);
+        }
+        double sarr_elapsed = TimerGetElapsed(&t) / repeat;
+        // Peak is sampled after every growth, outside of the timing.
+        int64_t base = test_live_bytes(), array_peak = 0, sarr_peak = 0;
+        uint64_t* arr = ArrayCreate(uint64_t);
+        for (uint64_t i = 0; i < test_size; i++) {
+            uint64_t capacity = ArrayGetCapacity(arr);
+            ArrayPush(arr, i);
+            if (ArrayGetCapacity(arr) != capacity && test_live_bytes() - base > array_peak) {
+                array_peak = test_live_bytes() - base;
+            }
+        }
+        ArrayFree(arr);
+        base = test_live_bytes();
+        SegmentedArray* sarr = SegmentedArrayCreate(sizeof(uint64_t));
+        for (uint64_t i = 0; i < test_size; i++) {
+            uint64_t blockCount = sarr->blockCount;
+            SegmentedArrayPush(sarr, &i);
+            if (sarr->blockCount != blockCount && test_live_bytes() - base > sarr_peak) {
+                sarr_peak = test_live_bytes() - base;
+            }
+        }
+        SegmentedArrayFree(sarr);
+        DEBUG_LOG_INFO("%lu uint64 appends: Array %.3f ms, %.1f KB peak, "
+                       "SegmentedArray %.3f ms, %.1f KB peak",
+                       (unsigned long)test_size, array_elapsed * 1000, array_peak / 1024.0,
+                       sarr_elapsed * 1000, sarr_peak / 1024.0);
+    }
+    TEST_END;
+}
+
+void test_gap_array() {
+    TEST_START;
+    GapArray* garr = GapArrayCreate(sizeof(char));
+    GapArrayInsert(garr, "hello world", 11);
+    TEST_CHECK(GapArrayGetSize(garr) == 11 && GapArrayGetCursor(garr) == 11);
+    GapArraySetCursor(garr, 5);
+    GapArrayInsert(garr, ",", 1);
+    GapArraySetCursor(garr, 100);
+    GapArrayPushRV(garr, char, '!');
+    GapArraySetCursor(garr, 7);
+    TEST_CHECK(GapArrayDelete(garr, 5) == 5);
+    GapArrayInsert(garr, "gap", 3);
+    TEST_CHECK(*(char*)GapArrayGetValue(garr, 7) == 'g');
+    TEST_CHECK(*(char*)GapArrayGetValue(garr, 10) == '!');
+    GapArraySetValue(garr, &(char){'H'}, 0);
+    TEST_CHECK(GapArrayBackspace(garr, 4) == 4 && GapArrayGetCursor(garr) == 6);
+    TEST_CHECK(GapArrayDelete(garr, 100) == 1);
+    TEST_CHECK(GapArrayBackspace(garr, 100) == 6);
+    TEST_CHECK(GapArrayGetSize(garr) == 0);
+    GapArrayInsert(garr, "Hello, gap!", 11);
+    char* str = GapArrayLinearize(garr);
+    TEST_CHECK(ArrayGetSize(str) == 11 && memcmp(str, "Hello, gap!", 11) == 0);
+    ArrayFree(str);
+    GapArrayClear(garr);
+    str = GapArrayLinearize(garr);
+    TEST_CHECK(ArrayGetSize(str) == 0);
+    ArrayFree(str);
+    GapArrayFree(garr);
+    // Random edits against ArrayPushAt and ArrayRemove.
+    garr = GapArrayCreate(sizeof(int));
+    int* expected = ArrayCreate(int);
+    bool same = true;
+    for (int i = 0; i < 5000; i++) {
+        uint64_t size = ArrayGetSize(expected);
+        uint64_t cursor = size ? rand() % (size + 1) : 0;
+        GapArraySetCursor(garr, cursor);
+        int op = rand() % 4;
+        if (op < 2) {
+            int values[8];
+            uint64_t length = rand() % 8 + 1;
+            for (uint64_t j = 0; j < length; j++) {
+                values[j] = rand();
+            }
+            GapArrayInsert(garr, values, length);
+            ArrayInsertAt(expected, values, length, cursor);
+            same &= GapArrayGetCursor(garr) == cursor + length;
+        } else if (op == 2 && cursor < size) {
+            uint64_t length = GapArrayDelete(garr, rand() % 8 + 1);
+            ArrayRemove(expected, cursor, length);
+        } else if (op == 3 && cursor > 0) {
+            uint64_t length = GapArrayBackspace(garr, rand() % 8 + 1);
+            ArrayRemove(expected, cursor - length, length);
+        }
+        same &= GapArrayGetSize(garr) == ArrayGetSize(expected);
+        if (i % 500 == 0 && ArrayGetSize(expected) > 0) {
+            uint64_t index = rand() % ArrayGetSize(expected);
+            same &= *(int*)GapArrayGetValue(garr, index) == expected[index];
+        }
+    }
+    int* linear = GapArrayLinearize(garr);
+    TEST_CHECK(same && ArrayGetSize(linear) == ArrayGetSize(expected));
+    TEST_CHECK(memcmp(linear, expected, ArrayGetSize(expected) * sizeof(int)) == 0);
+    ArrayFree(linear);
+    ArrayFree(expected);
+    GapArrayFree(garr);
+    TEST_END;
+}
+
+void test_gap_array_performance() {
+    TEST_START;
+    uint64_t base_size = 100000;
+    uint64_t test_size = 100000;
+    DEBUG_LOG_INFO("Base size: %lu, Test size: %lu",
+                   (unsigned long)base_size, (unsigned long)test_size);
+    // Cursor walks a few elements per edit and jumps every 1000 edits.
+    uint64_t* cursors = ArrayCreate(uint64_t);
+    ArrayReserve(cursors, test_size);
+    uint64_t cursor = base_size / 2;
+    for (uint64_t i = 0; i < test_size; i++) {
+        uint64_t size = base_size + i;
+        if (i % 1000 == 0) {
+            cursor = rand() % size;
+        } else {
+            uint64_t step = rand() % 17;
+            cursor = cursor + step >= 8 ? cursor + step - 8 : 0;
+            cursor = cursor > size ? size : cursor;
+        }
+        ArrayPush(cursors, cursor);
+    }
+    int64_t* array = ArrayCreate(int64_t);
+    GapArray* garr = GapArrayCreate(sizeof(int64_t));
+    for (uint64_t i = 0; i < base_size; i++) {
+        int64_t value = i;
+        ArrayPush(array, value);
+        GapArrayPush(garr, value);
+    }
+    Timer t = TimerCreate("test_gap_array_performance", true);
+    for (uint64_t i = 0; i < test_size; i++) {
+        int64_t value = i;
+        ArrayPushAt(array, value, cursors[i]);
+    }
+    double array_elapsed = TimerGetElapsed(&t);
+    TimerStart(&t);
+    for (uint64_t i = 0; i < test_size; i++) {
+        int64_t value = i;
+        GapArraySetCursor(garr, cursors[i]);
+        GapArrayPush(garr, value);
+    }
+    double gap_elapsed = TimerGetElapsed(&t);
+    TimerStart(&t);
+    int64_t* linear = GapArrayLinearize(garr);
+    double linearize_elapsed = TimerGetElapsed(&t);
+    TEST_CHECK(memcmp(linear, array, ArrayGetSize(array) * sizeof(int64_t)) == 0);
+    DEBUG_LOG_INFO("Clustered inserts: ArrayPushAt %.2f ms, GapArray %.2f ms, linearize %.2f ms",
+                   array_elapsed * 1000, gap_elapsed * 1000, linearize_elapsed * 1000);
+    ArrayFree(linear);
+    ArrayFree(array);
+    ArrayFree(cursors);
+    GapArrayFree(garr);
+    TEST_END;
+}
+
 void test_strings() {
     TEST_START;
     // encode & decode
@@ -128,6 +829,33 @@ void test_strings() {
         strcmp(s.c_str,
                "Leo sapien ve pretium elit, a faucibus ve sapien dolor vel pede. Sapien ve Vestibulum.") == 0);
     StringFree(&s);
+    // trim
+    s = StringCreateCStr(" a b\tc \n");
+    StringTrim(&s, " \t\n");
+    TEST_CHECK(strcmp(s.c_str, "abc") == 0 && s.length == 3);
+    StringTrim(&s, "b");
+    TEST_CHECK(strcmp(s.c_str, "ac") == 0 && s.length == 2);
+    StringFree(&s);
+    TEST_END;
+}
+
+void test_string_trim_performance() {
+    TEST_START;
+    uint64_t test_size = 1024 * 1024;
+    DEBUG_LOG_INFO("Test size: %lu", (unsigned long)test_size);
+    String s = StringCreate(test_size);
+    for (uint64_t i = 0; i < test_size / 16; i++) {
+        StringAppendCStr(&s, "lorem ipsum\tdo\n ");
+    }
+    Timer t = TimerCreate("test_string_trim_performance", true);
+    StringTrim(&s, " \t\n");
+    TimerLogElapsed(&t);
+    TEST_CHECK(s.length == test_size / 16 * 12);
+    t = TimerCreate("test_string_trim_performance single char", true);
+    StringTrim(&s, "o");
+    TimerLogElapsed(&t);
+    TEST_CHECK(s.length == test_size / 16 * 10);
+    StringFree(&s);
     TEST_END;
 }
 
@@ -184,6 +912,7 @@ void test_linkedlist_performance() {
     TEST_START;
     uint64_t test_size = 10000;
     DEBUG_LOG_INFO("Test size: %lu", (unsigned long)test_size);
+    uint64_t mallocCount = test_malloc_count();
     Timer t = TimerCreate("test_linkedlist_performance", true);
     LinkedList* list = LinkedListCreate(sizeof(int64_t));
     for (uint64_t i = 0; i < test_size; i++) {
@@ -204,6 +933,7 @@ void test_linkedlist_performance() {
     }
     LinkedListFree(list);
     TimerLogElapsed(&t);
+    DEBUG_LOG_INFO("Mallocs: %lu", (unsigned long)(test_malloc_count() - mallocCount));
 }
 
 void test_dictionary_and_json() {  // Create dictionary.
@@ -299,6 +1029,580 @@ void test_dictionary_and_json() {  // Create dictionary.
     TEST_END;
 }
 
+int test_uint64_comparator(const void* v1, const void* v2) {
+    uint64_t myval1 = *(uint64_t*)v1;
+    uint64_t myval2 = *(uint64_t*)v2;
+    if (myval1 > myval2) {
+        return 1;
+    } else if (myval1 < myval2) {
+        return -1;
+    }
+    return 0;
+}
+
+void test_memory() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SSE2", "AVX2"};
+    MemoryBackend default_backend = MemoryGetBackend();
+    DEBUG_LOG_INFO("Default memory backend: %s", backend_names[default_backend]);
+    uint64_t max_size = 20000;
+    uint8_t* a = CUtilsMalloc(max_size + 8);
+    uint8_t* b = CUtilsMalloc(max_size + 8);
+    uint8_t* c = CUtilsMalloc(max_size + 8);
+    uint64_t sizes[] = {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 255, 1000, max_size};
+    for (int backend = MEMORY_BACKEND_PORTABLE; backend <= MEMORY_BACKEND_AVX2; backend++) {
+        if (!MemorySetBackend(backend)) {
+            DEBUG_LOG_INFO("Memory backend %s is not supported.", backend_names[backend]);
+            continue;
+        }
+        for (uint64_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            // Odd offsets test unaligned loads.
+            for (uint64_t offset = 0; offset < 8; offset += 3) {
+                uint64_t size = sizes[s];
+                uint8_t* x = a + offset;
+                uint8_t* y = b + offset;
+                for (uint64_t i = 0; i < size; i++) {
+                    x[i] = rand() % 4;
+                }
+                memcpy(y, x, size);
+                TEST_CHECK(MemoryEquals(x, y, size));
+                if (size > 0) {
+                    uint64_t pos = rand() % size;
+                    y[pos] ^= 0x80;
+                    TEST_CHECK(!MemoryEquals(x, y, size));
+                    y[pos] ^= 0x80;
+                }
+                // Count and find against byte loops.
+                uint64_t count = 0;
+                uint8_t* first = NULL;
+                for (uint64_t i = 0; i < size; i++) {
+                    if (x[i] == 3) {
+                        count++;
+                        first = first ? first : x + i;
+                    }
+                }
+                TEST_CHECK(MemoryCountByte(x, size, 3) == count);
+                TEST_CHECK(MemoryFindByte(x, size, 3) == first);
+                TEST_CHECK(MemoryFindByte(x, size, 0xff) == NULL);
+                // Swap and reverse.
+                for (uint64_t i = 0; i < size; i++) {
+                    c[i] = ~x[i];
+                }
+                MemorySwap(x, c, size);
+                for (uint64_t i = 0; i < size; i++) {
+                    uint8_t not_y = (uint8_t)~y[i];
+                    TEST_CHECK(x[i] == not_y && c[i] == y[i]);
+                }
+                MemoryReverse(c, size);
+                for (uint64_t i = 0; i < size; i++) {
+                    TEST_CHECK(c[i] == y[size - 1 - i]);
+                }
+                // Null check finds a single bit anywhere.
+                memset(x, 0, size);
+                TEST_CHECK(MemoryIsNull(x, size));
+                if (size > 0) {
+                    x[rand() % size] = 1;
+                    TEST_CHECK(!MemoryIsNull(x, size));
+                    TEST_CHECK(MemoryIsNull(x, 0));
+                }
+            }
+        }
+    }
+    MemorySetBackend(default_backend);
+    CUtilsFree(a);
+    CUtilsFree(b);
+    CUtilsFree(c);
+    TEST_END;
+}
+
+void test_memory_performance() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SSE2", "AVX2"};
+    MemoryBackend default_backend = MemoryGetBackend();
+    uint64_t max_size = 1024 * 1024;
+    uint64_t bytes_per_test = 16 * 1024 * 1024;
+    uint8_t* a = CUtilsMalloc(max_size);
+    uint8_t* b = CUtilsMalloc(max_size);
+    volatile uint64_t sink = 0;
+    Timer t = TimerCreate("test_memory_performance", false);
+    for (int backend = MEMORY_BACKEND_PORTABLE; backend <= MEMORY_BACKEND_AVX2; backend++) {
+        if (!MemorySetBackend(backend)) {
+            continue;
+        }
+        for (uint64_t size = 1; size <= max_size; size *= 16) {
+            uint64_t repeat = bytes_per_test / size;
+            double elapsed[6];
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                sink += MemoryEquals(a, b, size);
+            }
+            elapsed[0] = TimerGetElapsed(&t);
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                sink += MemoryIsNull(a, size);
+            }
+            elapsed[1] = TimerGetElapsed(&t);
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                sink += MemoryFindByte(a, size, 1) != NULL;
+            }
+            elapsed[2] = TimerGetElapsed(&t);
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                sink += MemoryCountByte(a, size, 0);
+            }
+            elapsed[3] = TimerGetElapsed(&t);
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                MemorySwap(a, b, size);
+            }
+            elapsed[4] = TimerGetElapsed(&t);
+            TimerStart(&t);
+            for (uint64_t i = 0; i < repeat; i++) {
+                MemoryReverse(a, size);
+            }
+            elapsed[5] = TimerGetElapsed(&t);
+            double gb = repeat * size / (1024.0 * 1024.0 * 1024.0);
+            DEBUG_LOG_INFO("%s %7lu B (GB/s): equals %.2f, is null %.2f, find %.2f,"
+                           " count %.2f, swap %.2f, reverse %.2f",
+                           backend_names[backend], (unsigned long)size,
+                           gb / elapsed[0], gb / elapsed[1], gb / elapsed[2],
+                           gb / elapsed[3], gb / elapsed[4], gb / elapsed[5]);
+        }
+    }
+    MemorySetBackend(default_backend);
+    CUtilsFree(a);
+    CUtilsFree(b);
+    TEST_END;
+}
+
+typedef struct test_allocator_stats {
+    int64_t live;
+    uint64_t total;
+} test_allocator_stats;
+
+static void* test_counting_alloc(void* userData, size_t size) {
+    test_allocator_stats* stats = userData;
+    stats->live++;
+    stats->total++;
+    return malloc(size);
+}
+
+static void* test_counting_realloc(void* userData, void* buf, size_t newSize) {
+    test_allocator_stats* stats = userData;
+    if (buf == NULL) {
+        stats->live++;
+        stats->total++;
+    }
+    return realloc(buf, newSize);
+}
+
+static void test_counting_free(void* userData, void* buf) {
+    test_allocator_stats* stats = userData;
+    if (buf) {
+        stats->live--;
+    }
+    free(buf);
+}
+
+void test_allocator() {
+    TEST_START;
+    test_allocator_stats stats = {0, 0};
+    CUtilsAllocator allocator = {test_counting_alloc, test_counting_realloc,
+                                 test_counting_free, &stats, NULL};
+    uint64_t heapMallocs = test_malloc_count();
+
+    int* array = ArrayCreateWithAllocator(int, &allocator);
+    TEST_CHECK(ArrayGetAllocator(array) == &allocator);
+    for (int i = 0; i < 100; i++) {
+        ArrayPush(array, i);
+    }
+    ArrayFree(array);
+
+    String str = StringCreateWithAllocator(1, &allocator);
+    StringAppendCStr(&str, "Ismail Bulut");
+    String cpy = StringGetCopy(&str);
+    TEST_CHECK(ArrayGetAllocator(cpy.c_str) == &allocator);
+    StringFree(&cpy);
+    StringFree(&str);
+
+    Dictionary* dict = DictionaryCreateWithAllocator(&allocator);
+    List* list = ListCreateWithAllocator(&allocator);
+    ListPushNumber(list, 42);
+    ListPush(list, DATA_TYPE_STRING, "string");
+    DictionarySet(dict, "list", DATA_TYPE_LIST, list);
+    DictionarySetString(dict, "string", "value");
+    DictionaryRemove(dict, "string");
+    ListFree(list);
+    DictionaryFree(dict);
+
+    HashMap* hmap = HashMapCreateWithAllocator(sizeof(int), &allocator);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        sprintf(key, "key%d", i);
+        HashMapSetRV(hmap, key, int, i);
+    }
+    HashMapRemove(hmap, "key0");
+    HashMapFree(hmap);
+
+    LinkedList* llist = LinkedListCreateWithAllocator(sizeof(int), &allocator);
+    for (int i = 0; i < 100; i++) {
+        LinkedListPushRV(llist, int, i);
+    }
+    CUtilsFreeWith(&allocator, LinkedListPop(llist));
+    LinkedListFree(llist);
+
+    UniqueArray* uarray = UniqueArrayCreateWithAllocator(sizeof(uint64_t), 1,
+                                                         test_uint64_comparator, &allocator);
+    for (uint64_t i = 0; i < 100; i++) {
+        UniqueArrayAdd(uarray, &i, NULL);
+    }
+    UniqueArrayFree(uarray);
+
+    // Allocators without allocZeroed are cleared after alloc.
+    char* zeroed = CUtilsMallocWith(&allocator, 1024);
+    TEST_CHECK(MemoryIsNull(zeroed, 1024));
+    CUtilsFreeWith(&allocator, zeroed);
+
+    TEST_CHECK(stats.total > 0);
+    TEST_CHECK(stats.live == 0);
+
+    // Default allocator is used by containers created without one.
+    CUtilsSetDefaultAllocator(&allocator);
+    uint64_t total = stats.total;
+    List* defaultList = ListCreate();
+    ListPushBool(defaultList, true);
+    ListFree(defaultList);
+    CUtilsSetDefaultAllocator(NULL);
+    TEST_CHECK(CUtilsGetDefaultAllocator() == CUtilsGetHeapAllocator());
+    TEST_CHECK(stats.total > total);
+    TEST_CHECK(stats.live == 0);
+
+    // Nothing comes from the heap.
+    TEST_CHECK(test_malloc_count() == heapMallocs);
+    TEST_END;
+}
+
+#define TEST_PROFILER_THREAD_COUNT 4
+#define TEST_PROFILER_THREAD_ALLOCS 1000
+
+static void* test_profiler_worker(void* arg) {
+    (void)arg;
+    for (int i = 0; i < TEST_PROFILER_THREAD_ALLOCS; i++) {
+        CUtilsFree(CUtilsMalloc(100));
+    }
+    return NULL;
+}
+
+void test_profiler() {
+    TEST_START;
+    TEST_ASSERT(CUtilsProfilerIsEnabled());
+    CUtilsProfilerStats before, after;
+    CUtilsProfilerGetStats(&before);
+    char* small = CUtilsMalloc(10);
+    int site = __LINE__ - 1;
+    char* big = CUtilsMalloc(5000);
+    big = CUtilsRealloc(big, 10000);
+    CUtilsProfilerGetStats(&after);
+    TEST_CHECK(after.mallocCount - before.mallocCount == 2);
+    TEST_CHECK(after.reallocCount - before.reallocCount == 1);
+    TEST_CHECK(after.liveBytes - before.liveBytes >= 10000 + 10);
+    TEST_CHECK(after.peakBytes >= after.liveBytes);
+    TEST_CHECK(after.histogram[4] - before.histogram[4] == 1);   // 9 - 16 bytes
+    TEST_CHECK(after.histogram[13] - before.histogram[13] == 1); // 4097 - 8192 bytes
+    TEST_CHECK(after.histogram[14] - before.histogram[14] == 1); // 8193 - 16384 bytes
+    CUtilsFree(small);
+    CUtilsFree(big);
+    CUtilsProfilerGetStats(&after);
+    TEST_CHECK(after.liveBytes == before.liveBytes);
+    TEST_CHECK(after.freeCount - before.freeCount == 2);
+
+    // Counters are thread safe.
+    pthread_t threads[TEST_PROFILER_THREAD_COUNT];
+    CUtilsProfilerGetStats(&before);
+    for (int i = 0; i < TEST_PROFILER_THREAD_COUNT; i++) {
+        pthread_create(&threads[i], NULL, test_profiler_worker, NULL);
+    }
+    for (int i = 0; i < TEST_PROFILER_THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CUtilsProfilerGetStats(&after);
+    TEST_CHECK(after.mallocCount - before.mallocCount ==
+               TEST_PROFILER_THREAD_COUNT * TEST_PROFILER_THREAD_ALLOCS);
+    TEST_CHECK(after.liveBytes == before.liveBytes);
+
+    // Report has the call sites.
+    Dictionary* report = CUtilsProfilerCreateReport();
+    List* sites = DictionaryGet(report, "sites")->value;
+    bool found = false;
+    for (uint64_t i = 0; i < ListGetSize(sites); i++) {
+        Dictionary* entry = ListGetValue(sites, i)->value;
+        if (strcmp(DictionaryGet(entry, "file")->value, __FILE__) == 0 &&
+            *(int64_t*)DictionaryGet(entry, "line")->value == site) {
+            found = *(int64_t*)DictionaryGet(entry, "count")->value >= 1;
+        }
+    }
+    TEST_CHECK(found);
+    TEST_CHECK(ListGetSize(DictionaryGet(report, "histogram")->value) == CUTILS_PROFILER_HISTOGRAM_SIZE);
+    String json = JsonCreate(report);
+    TEST_CHECK(json.length > 0);
+    StringFree(&json);
+    DictionaryFree(report);
+    TEST_END;
+}
+
+#define TEST_NODE_POOL_REMOTE_COUNT 100
+
+static void* test_node_pool_free_worker(void* arg) {
+    void** blocks = arg;
+    for (int i = 0; i < TEST_NODE_POOL_REMOTE_COUNT; i++) {
+        CUtilsNodeFree(NULL, blocks[i], 48);
+    }
+    return NULL;
+}
+
+void test_node_pool() {
+    TEST_START;
+    void* nodes[64];
+    for (int i = 0; i < 64; i++) {
+        nodes[i] = CUtilsNodeMalloc(NULL, 24);
+        TEST_CHECK(((uintptr_t)nodes[i] & 15) == 0);
+        TEST_CHECK(MemoryIsNull(nodes[i], 24));
+        memset(nodes[i], 0xFF, 24);
+    }
+    // Freed blocks are reused by the same size class and cleared.
+    void* last = nodes[63];
+    CUtilsNodeFree(NULL, last, 24);
+    nodes[63] = CUtilsNodeMalloc(NULL, 32);
+    TEST_CHECK(nodes[63] == last);
+    TEST_CHECK(MemoryIsNull(nodes[63], 32));
+    for (int i = 0; i < 64; i++) {
+        CUtilsNodeFree(NULL, nodes[i], 24);
+    }
+    // Big blocks and other allocators don't use the pool.
+    uint64_t mallocCount = test_malloc_count();
+    void* big = CUtilsNodeMalloc(NULL, CUTILS_NODE_POOL_MAX_SIZE + 1);
+    TEST_CHECK(test_malloc_count() == mallocCount + 1);
+    CUtilsNodeFree(NULL, big, CUTILS_NODE_POOL_MAX_SIZE + 1);
+    CUtilsArena* arena = CUtilsArenaCreate(0);
+    void* node = CUtilsNodeMalloc(CUtilsArenaGetAllocator(arena), 24);
+    TEST_CHECK(node == CUtilsArenaRealloc(arena, node, 24));
+    CUtilsArenaFree(arena);
+    // Blocks freed by another thread go back to the owner, the last
+    // partial batch is sent when the thread exits.
+    void* remote[TEST_NODE_POOL_REMOTE_COUNT];
+    for (int i = 0; i < TEST_NODE_POOL_REMOTE_COUNT; i++) {
+        remote[i] = CUtilsNodeMalloc(NULL, 48);
+    }
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, test_node_pool_free_worker, remote);
+    TEST_ASSERT(rc == 0);
+    (void)rc;
+    pthread_join(thread, NULL);
+    void* reused[TEST_NODE_POOL_REMOTE_COUNT];
+    int returned = 0;
+    for (int i = 0; i < TEST_NODE_POOL_REMOTE_COUNT; i++) {
+        reused[i] = CUtilsNodeMalloc(NULL, 48);
+        TEST_CHECK(MemoryIsNull(reused[i], 48));
+        for (int j = 0; j < TEST_NODE_POOL_REMOTE_COUNT; j++) {
+            if (reused[i] == remote[j]) {
+                returned++;
+                break;
+            }
+        }
+    }
+    TEST_CHECK(returned == TEST_NODE_POOL_REMOTE_COUNT);
+    for (int i = 0; i < TEST_NODE_POOL_REMOTE_COUNT; i++) {
+        CUtilsNodeFree(NULL, reused[i], 48);
+    }
+    TEST_END;
+}
+
+// Minimum thread count, machines with more cores go up to all cores.
+#define TEST_NODE_POOL_THREAD_COUNT 4
+
+static void* test_node_pool_json_worker(void* arg) {
+    String* json = arg;
+    for (int i = 0; i < 10; i++) {
+        Dictionary* dict = JsonParse(*json);
+        DictionaryFree(dict);
+    }
+    return NULL;
+}
+
+void test_node_pool_performance() {
+    TEST_START;
+    uint64_t test_size = 1000;
+    String json = StringCreateCStr("{\"items\": [");
+    for (uint64_t i = 0; i < test_size; i++) {
+        StringAppendFormat(&json, "%s{\"id\": %lu, \"name\": \"item %lu\", \"tags\": [1, 2, 3]}",
+                           i > 0 ? ", " : "", (unsigned long)i, (unsigned long)i);
+    }
+    StringAppendCStr(&json, "]}");
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cores > TEST_NODE_POOL_THREAD_COUNT ? cores : TEST_NODE_POOL_THREAD_COUNT;
+    DEBUG_LOG_INFO("Test size: %lu objects, %ld cores", (unsigned long)test_size, cores);
+    pthread_t* threads = CUtilsMalloc(max_threads * sizeof(pthread_t));
+    double single = 0;
+    for (int thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+        Timer t = TimerCreate("test_node_pool_performance", true);
+        for (int i = 0; i < thread_count; i++) {
+            int rc = pthread_create(threads + i, NULL, test_node_pool_json_worker, &json);
+            TEST_ASSERT(rc == 0);
+            (void)rc;
+        }
+        for (int i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        double elapsed = TimerGetElapsed(&t);
+        single = thread_count == 1 ? elapsed : single;
+        DEBUG_LOG_INFO("%d threads: %f seconds, %.2fx throughput of one thread",
+                       thread_count, elapsed, single * thread_count / elapsed);
+    }
+    CUtilsFree(threads);
+    StringFree(&json);
+    TEST_END;
+}
+
+void test_arena() {
+    TEST_START;
+    CUtilsArena* arena = CUtilsArenaCreate(1024);
+
+    // Allocations are zeroed and aligned.
+    char* a = CUtilsArenaMalloc(arena, 13);
+    TEST_CHECK(((uintptr_t)a & 15) == 0);
+    TEST_CHECK(MemoryIsNull(a, 13));
+    memset(a, 'a', 13);
+    // Last allocation grows in place.
+    char* b = CUtilsArenaRealloc(arena, a, 100);
+    TEST_CHECK(a == b);
+    TEST_CHECK(b[12] == 'a' && b[13] == 0 && b[99] == 0);
+    // Others are copied.
+    CUtilsArenaMalloc(arena, 8);
+    char* c = CUtilsArenaRealloc(arena, b, 200);
+    TEST_CHECK(c != b && c[0] == 'a' && c[12] == 'a' && c[199] == 0);
+    // Bigger than the chunk size.
+    char* big = CUtilsArenaMalloc(arena, 4096);
+    TEST_CHECK(MemoryIsNull(big, 4096));
+
+    // Everything after the mark is released.
+    CUtilsArenaMark mark = CUtilsArenaGetMark(arena);
+    char* d = CUtilsArenaMalloc(arena, 64);
+    bool d_in_mark_chunk = CUtilsArenaGetMark(arena).chunk == mark.chunk;
+    CUtilsArenaMalloc(arena, 2048);
+    CUtilsArenaReset(arena, mark);
+    CUtilsArenaMark reset = CUtilsArenaGetMark(arena);
+    TEST_CHECK(reset.chunk == mark.chunk && reset.used == mark.used);
+    // Freed chunks may not come back at the same address, the marked one stays.
+    if (d_in_mark_chunk) {
+        TEST_CHECK(CUtilsArenaMalloc(arena, 64) == d);
+    }
+    CUtilsArenaFree(arena);
+
+    // Containers.
+    arena = CUtilsArenaCreate(0);
+    CUtilsAllocator* allocator = CUtilsArenaGetAllocator(arena);
+    uint64_t mallocCount = test_malloc_count();
+    int* array = ArrayCreateWithAllocator(int, allocator);
+    TEST_CHECK(ArrayGetAllocator(array) == allocator);
+    for (int i = 0; i < 1000; i++) {
+        ArrayPush(array, i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        TEST_CHECK(array[i] == i);
+    }
+    ArrayFree(array);
+
+    String str = StringCreateWithAllocator(1, allocator);
+    StringAppendCStr(&str, "Ismail Bulut");
+    String sub = StringSubString(&str, 0, 6);
+    TEST_CHECK(ArrayGetAllocator(sub.c_str) == allocator);
+    TEST_CHECK(strcmp(sub.c_str, "Ismail") == 0);
+    StringFree(&sub);
+    StringFree(&str);
+
+    HashMap* hmap = HashMapCreateWithAllocator(sizeof(int), allocator);
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        HashMapSetRV(hmap, key, int, i);
+    }
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        TEST_CHECK(*(int*)HashMapGet(hmap, key) == i);
+    }
+    HashMapFree(hmap);
+
+    Dictionary* dict = DictionaryCreateWithAllocator(allocator);
+    List* list = ListCreateWithAllocator(allocator);
+    ListPushNumber(list, 42);
+    ListPush(list, DATA_TYPE_STRING, "string");
+    DictionarySet(dict, "list", DATA_TYPE_LIST, list);
+    DictionarySetFloat(dict, "float", 3.14);
+    ListNode* node = ListGetValue(DictionaryGet(dict, "list")->value, 1);
+    TEST_CHECK(strcmp(node->value, "string") == 0);
+    DictionaryFree(dict);
+    // Only chunks come from the heap.
+    TEST_CHECK(test_malloc_count() - mallocCount < 16);
+
+    // Parsed json is the same as the heap one.
+    String json = StringCreateCStr(
+        "{\"name\": \"arena\", \"values\": [1, 2.5, true, null, [3, 4], {\"x\": -1}],"
+        " \"inner\": {\"list\": [\"a\", \"b\"], \"deep\": {\"ok\": false}}}");
+    Dictionary* heapDict = JsonParse(json);
+    Dictionary* arenaDict = JsonParseWithAllocator(json, allocator);
+    String heapJson = JsonCreate(heapDict);
+    String arenaJson = JsonCreate(arenaDict);
+    TEST_CHECK(StringEquals(&heapJson, &arenaJson));
+    StringFree(&heapJson);
+    StringFree(&arenaJson);
+    DictionaryFree(heapDict);
+    DictionaryFree(arenaDict);
+    StringFree(&json);
+
+    CUtilsArenaFree(arena);
+    TEST_END;
+}
+
+void test_arena_performance() {
+    TEST_START;
+    uint64_t test_size = 2000;
+    uint64_t repeat = 10;
+    String json = StringCreateCStr("{\"items\": [");
+    for (uint64_t i = 0; i < test_size; i++) {
+        StringAppendFormat(&json, "%s{\"id\": %lu, \"name\": \"item %lu\", \"price\": %lu.5,"
+                                  " \"tags\": [\"a\", \"b\", \"c\"], \"active\": true}",
+                           i > 0 ? ", " : "", (unsigned long)i, (unsigned long)i, (unsigned long)i);
+    }
+    StringAppendCStr(&json, "]}");
+    DEBUG_LOG_INFO("Test size: %lu objects, %lu bytes, %lu times",
+                   (unsigned long)test_size, (unsigned long)json.length, (unsigned long)repeat);
+
+    uint64_t mallocCount = test_malloc_count();
+    Timer t = TimerCreate("test_arena_performance heap", true);
+    for (uint64_t i = 0; i < repeat; i++) {
+        Dictionary* dict = JsonParse(json);
+        TEST_CHECK(ListGetSize(DictionaryGet(dict, "items")->value) == test_size);
+        DictionaryFree(dict);
+    }
+    TimerLogElapsed(&t);
+    DEBUG_LOG_INFO("Heap mallocs: %lu", (unsigned long)(test_malloc_count() - mallocCount));
+
+    mallocCount = test_malloc_count();
+    CUtilsArena* arena = CUtilsArenaCreate(0);
+    t = TimerCreate("test_arena_performance arena", true);
+    for (uint64_t i = 0; i < repeat; i++) {
+        Dictionary* dict = JsonParseWithAllocator(json, CUtilsArenaGetAllocator(arena));
+        TEST_CHECK(ListGetSize(DictionaryGet(dict, "items")->value) == test_size);
+        CUtilsArenaClear(arena);
+    }
+    TimerLogElapsed(&t);
+    DEBUG_LOG_INFO("Arena mallocs: %lu", (unsigned long)(test_malloc_count() - mallocCount));
+    CUtilsArenaFree(arena);
+    StringFree(&json);
+    TEST_END;
+}
+
 // void print_float_unique_array(UniqueArray* array) {
 //     printf("Arr: ");
 //     for (uint64_t i = 0; i < ArrayGetSize(array->data); i++) {
@@ -374,10 +1678,15 @@ void test_unique_array_performance() {
         float value = rand() * 0.1;
         UniqueArrayContains(u_arr, &value, NULL);
     }
+    uint64_t mallocCount = test_malloc_count();
     for (uint64_t i = 0; i < test_size; i++) {
         float value = rand() * 0.1;
         UniqueArrayRemove(u_arr, &value, NULL);
     }
+    while (ArrayGetSize(u_arr->data) > 0) {
+        UniqueArrayRemoveFrom(u_arr, ArrayGetSize(u_arr->data) - 1);
+    }
+    TEST_CHECK(test_malloc_count() == mallocCount);
     UniqueArrayFree(u_arr);
     TimerLogElapsed(&t);
 }
@@ -412,6 +1721,449 @@ void test_hash_algorithms() {
     TEST_END;
 }
 
+bool test_digest_equals(const uint8_t* digest, size_t size, const char* hex) {
+    char str[256];
+    for (size_t i = 0; i < size; i++) {
+        sprintf(str + i * 2, "%02x", digest[i]);
+    }
+    return strcmp(str, hex) == 0;
+}
+
+void test_hash_streaming() {
+    TEST_START;
+    const char* multi_block = "12345678901234567890123456789012345678901234567890123456789012345678901234567890";
+    const char* nist_448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    uint8_t md5[16];
+    uint8_t sha256[32];
+    HashMD5Context md5_context;
+    HashSHA256Context sha256_context;
+    // One-shot wrappers.
+    uint8_t* hash = Hash_MD5_128("", 0);
+    TEST_CHECK(test_digest_equals(hash, 16, "d41d8cd98f00b204e9800998ecf8427e"));
+    CUtilsFree(hash);
+    hash = Hash_MD5_128(multi_block, strlen(multi_block));
+    TEST_CHECK(test_digest_equals(hash, 16, "57edf4a22be3c955ac49da2e2107b67a"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_256("abc", 3);
+    TEST_CHECK(test_digest_equals(hash, 32, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_256(nist_448, strlen(nist_448));
+    TEST_CHECK(test_digest_equals(hash, 32, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+    CUtilsFree(hash);
+    // One million 'a' fed in uneven pieces.
+    char* a = CUtilsMalloc(1000000);
+    memset(a, 'a', 1000000);
+    HashMD5Init(&md5_context);
+    HashSHA256Init(&sha256_context);
+    uint64_t fed = 0;
+    uint64_t piece = 1;
+    while (fed < 1000000) {
+        if (fed + piece > 1000000) {
+            piece = 1000000 - fed;
+        }
+        HashMD5Update(&md5_context, a + fed, piece);
+        HashSHA256Update(&sha256_context, a + fed, piece);
+        fed += piece;
+        piece = piece * 7 % 1013 + 1;
+    }
+    HashMD5Final(&md5_context, md5);
+    HashSHA256Final(&sha256_context, sha256);
+    TEST_CHECK(test_digest_equals(md5, 16, "7707d6ae4e027c70eea2a935c2296f21"));
+    TEST_CHECK(test_digest_equals(sha256, 32, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+    CUtilsFree(a);
+    TEST_END;
+}
+
+void test_hash_sha512() {
+    TEST_START;
+    const char* nist_896 =
+        "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+        "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+    uint8_t* hash = Hash_SHA2_512("", 0);
+    TEST_CHECK(test_digest_equals(hash, 64,
+                                  "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+                                  "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_512("abc", 3);
+    TEST_CHECK(test_digest_equals(hash, 64,
+                                  "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                                  "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_512(nist_896, strlen(nist_896));
+    TEST_CHECK(test_digest_equals(hash, 64,
+                                  "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+                                  "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_384("abc", 3);
+    TEST_CHECK(test_digest_equals(hash, 48,
+                                  "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded163"
+                                  "1a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7"));
+    CUtilsFree(hash);
+    hash = Hash_SHA2_384(nist_896, strlen(nist_896));
+    TEST_CHECK(test_digest_equals(hash, 48,
+                                  "09330c33f71147e83d192fc782cd1b4753111b173b3b05d2"
+                                  "2fa08086e3b0f712fcc7c71a557e2db966c3e9fa91746039"));
+    CUtilsFree(hash);
+    // One million 'a' fed in uneven pieces.
+    char* a = CUtilsMalloc(1000000);
+    memset(a, 'a', 1000000);
+    HashSHA512Context sha512_context;
+    HashSHA384Context sha384_context;
+    HashSHA512Init(&sha512_context);
+    HashSHA384Init(&sha384_context);
+    uint64_t fed = 0;
+    uint64_t piece = 1;
+    while (fed < 1000000) {
+        if (fed + piece > 1000000) {
+            piece = 1000000 - fed;
+        }
+        HashSHA512Update(&sha512_context, a + fed, piece);
+        HashSHA384Update(&sha384_context, a + fed, piece);
+        fed += piece;
+        piece = piece * 7 % 1013 + 1;
+    }
+    uint8_t sha512[64];
+    uint8_t sha384[48];
+    HashSHA512Final(&sha512_context, sha512);
+    HashSHA384Final(&sha384_context, sha384);
+    TEST_CHECK(test_digest_equals(sha512, 64,
+                                  "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+                                  "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"));
+    TEST_CHECK(test_digest_equals(sha384, 48,
+                                  "9d0e1809716474cb086e834e310a4a1ced149e9c00f24852"
+                                  "7972cec5704c2a5b07b8b3dc38ecc4ebae97ddd87f3d8985"));
+    CUtilsFree(a);
+    TEST_END;
+}
+
+void test_hash_sha256_backends() {
+    TEST_START;
+    const char* nist_448 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    const char* backend_names[] = {"portable", "SHA-NI", "ARMv8"};
+    HashSHA256Backend default_backend = HashSHA256GetBackend();
+    DEBUG_LOG_INFO("Default SHA256 backend: %s", backend_names[default_backend]);
+    uint64_t buffer_size = 4096;
+    char* buffer = CUtilsMalloc(buffer_size);
+    for (uint64_t i = 0; i < buffer_size; i++) {
+        buffer[i] = rand();
+    }
+    uint8_t expected[32];
+    uint8_t digest[32];
+    HashSHA256Context context;
+    for (int backend = HASH_SHA256_BACKEND_PORTABLE; backend <= HASH_SHA256_BACKEND_ARMV8; backend++) {
+        if (!HashSHA256SetBackend(backend)) {
+            DEBUG_LOG_INFO("SHA256 backend %s is not supported.", backend_names[backend]);
+            continue;
+        }
+        uint8_t* hash = Hash_SHA2_256("abc", 3);
+        TEST_CHECK(test_digest_equals(hash, 32, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+        CUtilsFree(hash);
+        hash = Hash_SHA2_256(nist_448, strlen(nist_448));
+        TEST_CHECK(test_digest_equals(hash, 32, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+        CUtilsFree(hash);
+        // Cross check with the portable code for every tail length.
+        for (uint64_t len = 0; len < buffer_size; len += 67) {
+            HashSHA256SetBackend(HASH_SHA256_BACKEND_PORTABLE);
+            HashSHA256Init(&context);
+            HashSHA256Update(&context, buffer, len);
+            HashSHA256Final(&context, expected);
+            HashSHA256SetBackend(backend);
+            HashSHA256Init(&context);
+            HashSHA256Update(&context, buffer, len);
+            HashSHA256Final(&context, digest);
+            TEST_CHECK(memcmp(expected, digest, 32) == 0);
+        }
+    }
+    HashSHA256SetBackend(default_backend);
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_hash_sha2_performance() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SHA-NI", "ARMv8"};
+    HashSHA256Backend default_backend = HashSHA256GetBackend();
+    uint64_t buffer_size = 64 * 1024 * 1024;
+    DEBUG_LOG_INFO("Buffer size: %lu", (unsigned long)buffer_size);
+    char* buffer = CUtilsMalloc(buffer_size);
+    memset(buffer, 0x5a, buffer_size);
+    uint8_t digest[32];
+    HashSHA256Context context;
+    for (int backend = HASH_SHA256_BACKEND_PORTABLE; backend <= HASH_SHA256_BACKEND_ARMV8; backend++) {
+        if (!HashSHA256SetBackend(backend)) {
+            continue;
+        }
+        Timer t = TimerCreate(backend_names[backend], true);
+        HashSHA256Init(&context);
+        HashSHA256Update(&context, buffer, buffer_size);
+        HashSHA256Final(&context, digest);
+        double elapsed = TimerGetElapsed(&t);
+        DEBUG_LOG_INFO("SHA256 %s: %f GB/s", backend_names[backend],
+                       buffer_size / elapsed / (1024.0 * 1024.0 * 1024.0));
+    }
+    HashSHA256SetBackend(default_backend);
+    uint8_t digest512[64];
+    HashSHA512Context context512;
+    Timer t = TimerCreate("SHA512", true);
+    HashSHA512Init(&context512);
+    HashSHA512Update(&context512, buffer, buffer_size);
+    HashSHA512Final(&context512, digest512);
+    DEBUG_LOG_INFO("SHA512: %f GB/s", buffer_size / TimerGetElapsed(&t) / (1024.0 * 1024.0 * 1024.0));
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_hash_batch() {
+    TEST_START;
+    uint64_t item_count = 203;
+    char* buffer = CUtilsMalloc(4096);
+    for (uint64_t i = 0; i < 4096; i++) {
+        buffer[i] = rand();
+    }
+    HashBatchItem* items = CUtilsMalloc(item_count * sizeof(HashBatchItem));
+    for (uint64_t i = 0; i < item_count; i++) {
+        // Lengths around the padding boundaries and a few long ones.
+        items[i].buffer = buffer + i;
+        items[i].bufferSize = i < 130 ? i : (uint64_t)(rand() % 3000);
+    }
+    uint8_t* sha256 = CUtilsMalloc(item_count * 32);
+    uint8_t* md5 = CUtilsMalloc(item_count * 16);
+    HashBatchBackend backends[] = {HASH_BATCH_BACKEND_SCALAR, HASH_BATCH_BACKEND_AVX2};
+    for (int b = 0; b < 2; b++) {
+        if (!HashBatchSetBackend(backends[b])) {
+            DEBUG_LOG_INFO("Batch backend %d is not supported.", backends[b]);
+            continue;
+        }
+        HashSHA256Batch(items, item_count, sha256);
+        HashMD5Batch(items, item_count, md5);
+        for (uint64_t i = 0; i < item_count; i++) {
+            uint8_t* hash = Hash_SHA2_256(items[i].buffer, items[i].bufferSize);
+            TEST_CHECK(memcmp(hash, sha256 + i * 32, 32) == 0);
+            CUtilsFree(hash);
+            hash = Hash_MD5_128(items[i].buffer, items[i].bufferSize);
+            TEST_CHECK(memcmp(hash, md5 + i * 16, 16) == 0);
+            CUtilsFree(hash);
+        }
+    }
+    HashBatchSetBackend(HASH_BATCH_BACKEND_AUTO);
+    CUtilsFree(sha256);
+    CUtilsFree(md5);
+    CUtilsFree(items);
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_hash_batch_performance() {
+    TEST_START;
+    uint64_t record_count = 100000;
+    DEBUG_LOG_INFO("Record count: %lu", (unsigned long)record_count);
+    char* buffer = CUtilsMalloc(record_count + 256);
+    for (uint64_t i = 0; i < record_count + 256; i++) {
+        buffer[i] = rand();
+    }
+    HashBatchItem* items = CUtilsMalloc(record_count * sizeof(HashBatchItem));
+    for (uint64_t i = 0; i < record_count; i++) {
+        items[i].buffer = buffer + i;
+        items[i].bufferSize = 64 + rand() % 192;
+    }
+    uint8_t* digests = CUtilsMalloc(record_count * 32);
+    HashSHA256Backend sha256_backend = HashSHA256GetBackend();
+    HashSHA256SetBackend(HASH_SHA256_BACKEND_PORTABLE);
+    Timer t = TimerCreate("one-shot", true);
+    for (uint64_t i = 0; i < record_count; i++) {
+        CUtilsFree(Hash_SHA2_256(items[i].buffer, items[i].bufferSize));
+    }
+    DEBUG_LOG_INFO("SHA256 portable one-shot: %f records/s", record_count / TimerGetElapsed(&t));
+    const char* names[] = {"auto", "scalar", "AVX2"};
+    for (int b = HASH_BATCH_BACKEND_SCALAR; b <= HASH_BATCH_BACKEND_AVX2; b++) {
+        if (!HashBatchSetBackend(b)) {
+            continue;
+        }
+        t = TimerCreate(names[b], true);
+        HashSHA256Batch(items, record_count, digests);
+        DEBUG_LOG_INFO("SHA256 portable batch %s: %f records/s", names[b], record_count / TimerGetElapsed(&t));
+        t = TimerCreate(names[b], true);
+        HashMD5Batch(items, record_count, digests);
+        DEBUG_LOG_INFO("MD5 batch %s: %f records/s", names[b], record_count / TimerGetElapsed(&t));
+    }
+    HashSHA256SetBackend(sha256_backend);
+    HashBatchSetBackend(HASH_BATCH_BACKEND_AUTO);
+    t = TimerCreate("auto", true);
+    HashSHA256Batch(items, record_count, digests);
+    DEBUG_LOG_INFO("SHA256 batch auto: %f records/s", record_count / TimerGetElapsed(&t));
+    CUtilsFree(digests);
+    CUtilsFree(items);
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+double test_wall_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void test_hash_tree() {
+    TEST_START;
+    // Single chunk is a single leaf.
+    const char* key = "The quick brown fox jumps over the lazy dog";
+    uint8_t expected[32];
+    uint8_t digest[32];
+    HashSHA256Context context;
+    HashSHA256Init(&context);
+    HashSHA256Update(&context, "\0", 1);
+    HashSHA256Update(&context, key, strlen(key));
+    HashSHA256Final(&context, expected);
+    HashTreeSHA256(key, strlen(key), 4, digest);
+    TEST_CHECK(memcmp(expected, digest, 32) == 0);
+    // Empty input is one empty leaf, with or without a buffer.
+    HashSHA256Init(&context);
+    HashSHA256Update(&context, "\0", 1);
+    HashSHA256Final(&context, expected);
+    memset(digest, 0xab, 32);
+    HashTreeSHA256(NULL, 0, 2, digest);
+    TEST_CHECK(memcmp(expected, digest, 32) == 0);
+    HashTreeSHA256(key, 0, 2, digest);
+    TEST_CHECK(memcmp(expected, digest, 32) == 0);
+    // Result doesn't depend on the thread count.
+    uint64_t buffer_size = 5 * HASH_TREE_CHUNK_SIZE + 12345;
+    char* buffer = CUtilsMalloc(buffer_size);
+    for (uint64_t i = 0; i < buffer_size; i++) {
+        buffer[i] = rand();
+    }
+    HashTreeSHA256(buffer, buffer_size, 1, expected);
+    uint32_t thread_counts[] = {0, 2, 3, 8};
+    for (int i = 0; i < 4; i++) {
+        HashTreeSHA256(buffer, buffer_size, thread_counts[i], digest);
+        TEST_CHECK(memcmp(expected, digest, 32) == 0);
+    }
+    // Changing one byte changes the root.
+    buffer[3 * HASH_TREE_CHUNK_SIZE] ^= 1;
+    HashTreeSHA256(buffer, buffer_size, 2, digest);
+    TEST_CHECK(memcmp(expected, digest, 32) != 0);
+    buffer[3 * HASH_TREE_CHUNK_SIZE] ^= 1;
+    // File entry point.
+    bool written = FileUtilsWriteBinary("test_hash_tree", buffer, buffer_size);
+    TEST_ASSERT(written);
+    (void)written;
+    TEST_CHECK(HashTreeSHA256File("test_hash_tree", 3, digest));
+    TEST_CHECK(memcmp(expected, digest, 32) == 0);
+    TEST_CHECK(!HashTreeSHA256File("test_hash_tree_missing", 3, digest));
+    remove("test_hash_tree");
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_hash_tree_performance() {
+    TEST_START;
+    uint64_t buffer_size = 256 * 1024 * 1024;
+    DEBUG_LOG_INFO("Buffer size: %lu", (unsigned long)buffer_size);
+    char* buffer = CUtilsMalloc(buffer_size);
+    memset(buffer, 0x5a, buffer_size);
+    uint8_t digest[32];
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long threads = 1; threads <= cpu_count; threads *= 2) {
+        double start = test_wall_time();
+        HashTreeSHA256(buffer, buffer_size, threads, digest);
+        double elapsed = test_wall_time() - start;
+        DEBUG_LOG_INFO("Tree SHA256 %ld threads: %f GB/s", threads,
+                       buffer_size / elapsed / (1024.0 * 1024.0 * 1024.0));
+    }
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_hash_wy() {
+    TEST_START;
+    const char* key = "The quick brown fox jumps over the lazy dog";
+    uint64_t seed = HashGetProcessSeed();
+    TEST_CHECK(seed == HashGetProcessSeed());
+    TEST_CHECK(Hash_WY_64(key, strlen(key), seed) == Hash_WY_64(key, strlen(key), seed));
+    TEST_CHECK(Hash_WY_64(key, strlen(key), 1) != Hash_WY_64(key, strlen(key), 2));
+    uint64_t hash128[2];
+    Hash_WY_128(key, strlen(key), seed, hash128);
+    TEST_CHECK(hash128[0] == Hash_WY_64(key, strlen(key), seed));
+    TEST_CHECK(hash128[0] != hash128[1]);
+    // Collisions: every length path with sequential keys.
+    uint64_t key_count = 200000;
+    uint64_t* hashes = CUtilsMalloc(key_count * sizeof(uint64_t));
+    char buffer[128];
+    memset(buffer, 'x', sizeof(buffer));
+    for (uint64_t i = 0; i < key_count; i++) {
+        int len = sprintf(buffer, "key%lu", (unsigned long)i);
+        buffer[len] = 'x';
+        hashes[i] = Hash_WY_64(buffer, len + i % 100, seed);
+    }
+    qsort(hashes, key_count, sizeof(uint64_t), test_uint64_comparator);
+    uint64_t collisions = 0;
+    for (uint64_t i = 1; i < key_count; i++) {
+        collisions += hashes[i] == hashes[i - 1];
+    }
+    DEBUG_LOG_INFO("Hash_WY_64 collisions: %lu / %lu", (unsigned long)collisions, (unsigned long)key_count);
+    TEST_CHECK(collisions == 0);
+    CUtilsFree(hashes);
+    // Avalanche: flipping any input bit should flip each output bit
+    // with probability close to 1/2.
+    uint64_t flip_counts[64] = {0};
+    uint64_t total_flips = 0;
+    uint64_t samples = 0;
+    for (int n = 0; n < 500; n++) {
+        for (int i = 0; i < 32; i++) {
+            buffer[i] = rand();
+        }
+        uint64_t base = Hash_WY_64(buffer, 32, seed);
+        for (int bit = 0; bit < 32 * 8; bit++) {
+            buffer[bit / 8] ^= 1 << (bit % 8);
+            uint64_t diff = base ^ Hash_WY_64(buffer, 32, seed);
+            buffer[bit / 8] ^= 1 << (bit % 8);
+            for (int o = 0; o < 64; o++) {
+                flip_counts[o] += (diff >> o) & 1;
+            }
+            total_flips += __builtin_popcountll(diff);
+            samples++;
+        }
+    }
+    double average = (double)total_flips / samples;
+    DEBUG_LOG_INFO("Hash_WY_64 avalanche: %f flipped bits of 64", average);
+    TEST_CHECK(average > 31.5 && average < 32.5);
+    for (int o = 0; o < 64; o++) {
+        double probability = (double)flip_counts[o] / samples;
+        TEST_CHECK(probability > 0.48 && probability < 0.52);
+    }
+    TEST_END;
+}
+
+void test_hash_performance() {
+    TEST_START;
+    uint64_t buffer_size = 64 * 1024 * 1024;
+    DEBUG_LOG_INFO("Buffer size: %lu", (unsigned long)buffer_size);
+    char* buffer = CUtilsMalloc(buffer_size);
+    for (uint64_t i = 0; i < buffer_size; i++) {
+        buffer[i] = rand();
+    }
+    volatile uint64_t sink = 0;
+    Timer t = TimerCreate("Hash_64", true);
+    sink ^= Hash_64(buffer, buffer_size);
+    DEBUG_LOG_INFO("Hash_64: %f MB/s", buffer_size / TimerGetElapsed(&t) / (1024 * 1024));
+    t = TimerCreate("Hash_WY_64", true);
+    sink ^= Hash_WY_64(buffer, buffer_size, 0);
+    DEBUG_LOG_INFO("Hash_WY_64: %f MB/s", buffer_size / TimerGetElapsed(&t) / (1024 * 1024));
+    // Short keys like the hashmap uses.
+    uint64_t key_count = 4 * 1024 * 1024;
+    t = TimerCreate("Hash_64 short keys", true);
+    for (uint64_t i = 0; i < key_count; i++) {
+        sink ^= Hash_64(buffer + i, 16);
+    }
+    TimerLogElapsed(&t);
+    t = TimerCreate("Hash_WY_64 short keys", true);
+    for (uint64_t i = 0; i < key_count; i++) {
+        sink ^= Hash_WY_64(buffer + i, 16, 0);
+    }
+    TimerLogElapsed(&t);
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
 // void print_integer_type_hash_map(HashMap* hmap) {
 //     DEBUG_LOG_INFO("HashMap: ");
 //     for (uint64_t i = 0; i < UniqueArrayGetSize(hmap->keys); i++) {
@@ -450,6 +2202,29 @@ void test_hash_map() {
     TEST_CHECK(HashMapRemove(hmap, "ferrari"));
     // print_integer_type_hash_map(hmap);
     TEST_CHECK(HashMapGet(hmap, "ferrari") == NULL);
+    TEST_CHECK(HashMapGetSize(hmap) == 7);
+
+    // Force rehashes and backward shift deletions.
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        HashMapSet(hmap, key, &i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        sprintf(key, "key%d", i);
+        TEST_CHECK(HashMapRemove(hmap, key));
+    }
+    for (int i = 0; i < 1000; i++) {
+        sprintf(key, "key%d", i);
+        int* value = HashMapGet(hmap, key);
+        if (i % 2 == 0) {
+            TEST_CHECK(value == NULL);
+        } else {
+            TEST_CHECK(value && *value == i);
+        }
+    }
+    TEST_CHECK(HashMapGetSize(hmap) == 507);
+    TEST_CHECK(*(int*)HashMapGet(hmap, "bmw") == 105499);
 
     HashMapFree(hmap);
     TEST_END;
@@ -459,16 +2234,27 @@ void test_hash_map_performance() {
     TEST_START;
     uint64_t test_size = 50000;
     DEBUG_LOG_INFO("Test size: %lu", (unsigned long)test_size);
+    uint64_t mallocCount = test_malloc_count();
     Timer t = TimerCreate("test_hash_map_performance", true);
     HashMap* hmap = HashMapCreate(sizeof(int));
     srand(time(0));
+    char** keys = CUtilsMalloc(test_size * sizeof(char*));
+    for (uint64_t i = 0; i < test_size; i++) {
+        keys[i] = rand_string(128, 32, 126);
+        HashMapSetRV(hmap, keys[i], int, rand());
+    }
+    for (uint64_t i = 0; i < test_size; i++) {
+        TEST_CHECK(HashMapContains(hmap, keys[i]));
+    }
     for (uint64_t i = 0; i < test_size; i++) {
-        char* key = rand_string(128, 32, 126);
-        HashMapSetRV(hmap, key, int, rand());
-        CUtilsFree(key);
+        HashMapRemove(hmap, keys[i]);
+        CUtilsFree(keys[i]);
     }
+    TEST_CHECK(HashMapGetSize(hmap) == 0);
+    CUtilsFree(keys);
     HashMapFree(hmap);
     TimerLogElapsed(&t);
+    DEBUG_LOG_INFO("Mallocs: %lu", (unsigned long)(test_malloc_count() - mallocCount));
 }
 
 void test_file_write_read_string() {
@@ -497,3 +2283,208 @@ void test_file_write_read_binary() {
     CUtilsFree(readed);
     TEST_END;
 }
+
+void test_large_allocation_performance() {
+    TEST_START;
+    uint64_t test_size = 256 * 1024 * 1024;
+    uint64_t repeat = 4;
+    DEBUG_LOG_INFO("Test size: %lu bytes, %lu times", (unsigned long)test_size, (unsigned long)repeat);
+
+    // Pages of a reserve are only touched when they are written.
+    Timer t = TimerCreate("test_large_allocation_performance reserve", true);
+    for (uint64_t i = 0; i < repeat; i++) {
+        char* array = ArrayCreate(char);
+        ArrayReserve(array, test_size);
+        TEST_CHECK(ArrayGetCapacity(array) == test_size);
+        ArrayFree(array);
+    }
+    TimerLogElapsed(&t);
+
+    t = TimerCreate("test_large_allocation_performance zeroed", true);
+    for (uint64_t i = 0; i < repeat; i++) {
+        char* buffer = CUtilsMalloc(test_size);
+        TEST_CHECK(buffer[test_size - 1] == 0);
+        CUtilsFree(buffer);
+    }
+    TimerLogElapsed(&t);
+
+    uint64_t file_size = 64 * 1024 * 1024;
+    char* data = CUtilsMallocUninit(file_size);
+    for (uint64_t i = 0; i < file_size; i++) {
+        data[i] = (char)i;
+    }
+    bool ok = FileUtilsWriteBinary("test_large_allocation_performance", data, file_size);
+    TEST_ASSERT(ok);
+    void* readed;
+    size_t readed_size;
+    t = TimerCreate("test_large_allocation_performance read binary", true);
+    for (uint64_t i = 0; i < repeat; i++) {
+        ok = FileUtilsReadBinary("test_large_allocation_performance", &readed, &readed_size);
+        TEST_ASSERT(ok);
+        TEST_CHECK(readed_size == file_size);
+        CUtilsFree(readed);
+    }
+    TimerLogElapsed(&t);
+    ok = FileUtilsReadBinary("test_large_allocation_performance", &readed, &readed_size);
+    TEST_ASSERT(ok);
+    (void)ok;
+    TEST_CHECK(MemoryEquals(readed, data, file_size));
+    CUtilsFree(readed);
+    remove("test_large_allocation_performance");
+    CUtilsFree(data);
+    TEST_END;
+}
+
+void test_large_blocks() {
+    TEST_START;
+    size_t default_threshold = CUtilsGetLargeBlockThreshold();
+    if (!CUtilsSetLargeBlockThreshold(4 * 1024 * 1024)) {
+        DEBUG_LOG_INFO("Large blocks are not supported.");
+        TEST_END;
+        return;
+    }
+    TEST_CHECK(CUtilsGetLargeBlockThreshold() == 4 * 1024 * 1024);
+    // Mapped blocks are zeroed and aligned to huge pages.
+    uint64_t size = 8 * 1024 * 1024;
+    uint8_t* buffer = CUtilsMalloc(size);
+    TEST_CHECK(((uintptr_t)buffer & (2 * 1024 * 1024 - 1)) == 0);
+    TEST_CHECK(MemoryIsNull(buffer, size));
+    CUtilsFree(buffer);
+    // Array grows from malloc to a mapped block, keeps growing with
+    // mremap and shrinks back to malloc.
+    uint32_t* array = ArrayCreate(uint32_t);
+    for (uint32_t i = 0; i < 16 * 1024 * 1024; i++) {
+        ArrayPush(array, i);
+    }
+    bool preserved = true;
+    for (uint32_t i = 0; i < ArrayGetSize(array); i += 4099) {
+        preserved = preserved && array[i] == i;
+    }
+    TEST_CHECK(preserved);
+    ArrayReserve(array, 1024);
+    TEST_CHECK(ArrayGetSize(array) == 1024 && array[1023] == 1023);
+    ArrayFree(array);
+    // Mapped blocks survive a threshold change.
+    buffer = CUtilsMalloc(size);
+    buffer[size - 1] = 42;
+    CUtilsSetLargeBlockThreshold(0);
+    buffer = CUtilsRealloc(buffer, size * 2);
+    TEST_CHECK(buffer[size - 1] == 42);
+    CUtilsFree(buffer);
+    CUtilsSetLargeBlockThreshold(default_threshold);
+    TEST_END;
+}
+
+void test_large_block_performance() {
+    TEST_START;
+    size_t default_threshold = CUtilsGetLargeBlockThreshold();
+    uint64_t test_size = 1024 * 1024 * 1024 / sizeof(uint64_t);
+    uint64_t access_count = 16 * 1024 * 1024;
+    DEBUG_LOG_INFO("Test size: %lu elements, %lu random accesses",
+                   (unsigned long)test_size, (unsigned long)access_count);
+    size_t thresholds[] = {0, CUTILS_LARGE_BLOCK_DEFAULT_THRESHOLD};
+    for (int huge = 0; huge < 2; huge++) {
+        if (!CUtilsSetLargeBlockThreshold(thresholds[huge])) {
+            continue;
+        }
+        uint64_t* array = ArrayCreate(uint64_t);
+        Timer t = TimerCreate(huge ? "test_large_block_performance huge pages fill"
+                                   : "test_large_block_performance fill", true);
+        ArrayReserve(array, test_size);
+        for (uint64_t i = 0; i < test_size; i++) {
+            array[i] = i;
+        }
+        TimerLogElapsed(&t);
+        t = TimerCreate(huge ? "test_large_block_performance huge pages random access"
+                             : "test_large_block_performance random access", true);
+        uint64_t index = 1;
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < access_count; i++) {
+            index = index * 6364136223846793005ull + 1442695040888963407ull;
+            sum += array[(index >> 16) % test_size];
+        }
+        TimerLogElapsed(&t);
+        TEST_CHECK(sum > 0);
+        ArrayFree(array);
+    }
+    CUtilsSetLargeBlockThreshold(default_threshold);
+    TEST_END;
+}
+
+void test_checksum() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SSE4.2", "ARMv8"};
+    ChecksumBackend default_backend = ChecksumGetBackend();
+    DEBUG_LOG_INFO("Default checksum backend: %s", backend_names[default_backend]);
+    uint64_t buffer_size = 64 * 1024 + 77;
+    char* buffer = CUtilsMalloc(buffer_size);
+    for (uint64_t i = 0; i < buffer_size; i++) {
+        buffer[i] = rand();
+    }
+    TEST_CHECK(ChecksumSetBackend(CHECKSUM_BACKEND_PORTABLE));
+    uint32_t expected = ChecksumCRC32C(0, buffer, buffer_size);
+    for (int backend = CHECKSUM_BACKEND_PORTABLE; backend <= CHECKSUM_BACKEND_ARMV8; backend++) {
+        if (!ChecksumSetBackend(backend)) {
+            DEBUG_LOG_INFO("Checksum backend %s is not supported.", backend_names[backend]);
+            continue;
+        }
+        // RFC 3720 check value.
+        TEST_CHECK(ChecksumCRC32C(0, "123456789", 9) == 0xe3069283);
+        TEST_CHECK(ChecksumCRC32C(0, "", 0) == 0);
+        TEST_CHECK(ChecksumCRC32C(0, buffer, buffer_size) == expected);
+        // Streaming with uneven pieces and unaligned starts.
+        uint32_t crc = 0;
+        uint64_t fed = 0;
+        uint64_t piece = 1;
+        while (fed < buffer_size) {
+            if (fed + piece > buffer_size) {
+                piece = buffer_size - fed;
+            }
+            crc = ChecksumCRC32C(crc, buffer + fed, piece);
+            fed += piece;
+            piece = piece * 13 % 20011 + 1;
+        }
+        TEST_CHECK(crc == expected);
+    }
+    ChecksumSetBackend(default_backend);
+    // Checksummed files.
+    void* readed;
+    size_t readed_size;
+    bool written = FileUtilsWriteBinaryChecksummed("test_checksum", buffer, buffer_size);
+    TEST_ASSERT(written);
+    (void)written;
+    TEST_CHECK(FileUtilsReadBinaryChecksummed("test_checksum", &readed, &readed_size));
+    TEST_CHECK(readed_size == buffer_size);
+    TEST_CHECK(memcmp(readed, buffer, buffer_size) == 0);
+    CUtilsFree(readed);
+    buffer[100] ^= 1;
+    written = FileUtilsWriteBinary("test_checksum", buffer, buffer_size);
+    TEST_ASSERT(written);
+    TEST_CHECK(!FileUtilsReadBinaryChecksummed("test_checksum", &readed, &readed_size));
+    remove("test_checksum");
+    CUtilsFree(buffer);
+    TEST_END;
+}
+
+void test_checksum_performance() {
+    TEST_START;
+    const char* backend_names[] = {"portable", "SSE4.2", "ARMv8"};
+    ChecksumBackend default_backend = ChecksumGetBackend();
+    uint64_t buffer_size = 64 * 1024 * 1024;
+    DEBUG_LOG_INFO("Buffer size: %lu", (unsigned long)buffer_size);
+    char* buffer = CUtilsMalloc(buffer_size);
+    memset(buffer, 0x5a, buffer_size);
+    volatile uint32_t sink = 0;
+    for (int backend = CHECKSUM_BACKEND_PORTABLE; backend <= CHECKSUM_BACKEND_ARMV8; backend++) {
+        if (!ChecksumSetBackend(backend)) {
+            continue;
+        }
+        Timer t = TimerCreate(backend_names[backend], true);
+        sink ^= ChecksumCRC32C(0, buffer, buffer_size);
+        DEBUG_LOG_INFO("CRC32C %s: %f GB/s", backend_names[backend],
+                       buffer_size / TimerGetElapsed(&t) / (1024.0 * 1024.0 * 1024.0));
+    }
+    ChecksumSetBackend(default_backend);
+    CUtilsFree(buffer);
+    TEST_END;
+}
@@ -28,14 +28,47 @@
 void sandbox();
 void test_array();
 void test_array_performance();
+void test_array_churn_performance();
+void test_array_sort();
+void test_array_sort_performance();
+void test_array_search();
+void test_array_search_performance();
+void test_segmented_array();
+void test_segmented_array_performance();
+void test_gap_array();
+void test_gap_array_performance();
 void test_strings();
+void test_string_trim_performance();
 void test_linkedlist();
 void test_linkedlist_performance();
 void test_dictionary_and_json();
+void test_memory();
+void test_memory_performance();
+void test_allocator();
+void test_profiler();
+void test_node_pool();
+void test_node_pool_performance();
+void test_arena();
+void test_arena_performance();
 void test_unique_array();
 void test_unique_array_performance();
 void test_hash_algorithms();
+void test_hash_streaming();
+void test_hash_sha512();
+void test_hash_sha256_backends();
+void test_hash_sha2_performance();
+void test_hash_batch();
+void test_hash_batch_performance();
+void test_hash_tree();
+void test_hash_tree_performance();
+void test_hash_wy();
+void test_hash_performance();
 void test_hash_map();
 void test_hash_map_performance();
 void test_file_write_read_string();
 void test_file_write_read_binary();
+void test_large_allocation_performance();
+void test_large_blocks();
+void test_large_block_performance();
+void test_checksum();
+void test_checksum_performance();